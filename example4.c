@@ -39,12 +39,47 @@ void client2(iqueue_t* queue, int nrops)
    }
 }
 
+void server3(iqfc_t* queue, int tid, int nrops)
+{
+   for (int i = 1; i <= nrops; ++i) {
+      void* msg;
+      while (tryrecv_iqfc(queue, (uint32_t)tid, &msg)) ;
+   }
+}
+
+void client3(iqfc_t* queue, int tid, int nrops)
+{
+   for (int i = 1; i <= nrops; ++i) {
+      while (trysend_iqfc(queue, (uint32_t)tid, (void*)(intptr_t)i)) ;
+   }
+}
+
+void server4(iqscq_t* queue, int nrops)
+{
+   for (int i = 1; i <= nrops; ++i) {
+      void* msg;
+      while (tryrecv_iqscq(queue, &msg)) ;
+   }
+}
+
+void client4(iqscq_t* queue, int nrops)
+{
+   for (int i = 1; i <= nrops; ++i) {
+      while (trysend_iqscq(queue, (void*)(intptr_t)i)) ;
+   }
+}
+
 // ===================== 
 
 // customize iperf perfomance test framework
 
+// queue type selected with second argument (0: iqueue1_t for 2 threads else iqueue_t)
+enum { TYPE_DEFAULT, TYPE_IQUEUE, TYPE_IQFC, TYPE_IQSCQ } s_type;
+
 iqueue1_t* s_queue1;
 iqueue_t*  s_queue2;
+iqfc_t*    s_queue3;
+iqscq_t*   s_queue4;
 
 typedef struct iperf_param_t {
    int    tid; // threadid or processid of test instance (0,1,2,...)
@@ -58,8 +93,12 @@ int iperf_prepare(iperf_param_t* param)
    int err = 0;
    param->nrops = 1000000;
 
-   if (!s_queue1 && !s_queue2) {
-      if (param->nrinstance <= 2) {
+   if (!s_queue1 && !s_queue2 && !s_queue3 && !s_queue4) {
+      if (s_type == TYPE_IQFC) {
+         err = new_iqfc(&s_queue3, 1000000, (uint32_t)param->nrinstance);
+      } else if (s_type == TYPE_IQSCQ) {
+         err = new_iqscq(&s_queue4, 1000000);
+      } else if (param->nrinstance <= 2 && s_type == TYPE_DEFAULT) {
          err = new_iqueue1(&s_queue1, 1000000);
       } else {
          err = new_iqueue(&s_queue2, 1000000);
@@ -78,6 +117,18 @@ int iperf_run(iperf_param_t* param)
       } else {
          client1(s_queue1, param->nrops);
       }
+   } else if (s_queue3) {
+      if (0 == (param->tid%2)) {
+         server3(s_queue3, param->tid, param->nrops);
+      } else {
+         client3(s_queue3, param->tid, param->nrops);
+      }
+   } else if (s_queue4) {
+      if (0 == (param->tid%2)) {
+         server4(s_queue4, param->nrops);
+      } else {
+         client4(s_queue4, param->nrops);
+      }
    } else {
       if (0 == (param->tid%2)) {
          server2(s_queue2, param->nrops);
@@ -247,15 +298,28 @@ int main(int argc, const char* argv[])
 {
    int err = EINVAL;
 
-   if (argc == 2) {
+   if (argc == 2 || argc == 3) {
       sscanf(argv[1], "%d", &nrinstance);
       nrinstance = (nrinstance + 1) & ~0x1; // make nrinstance even
       if (2 <= nrinstance && nrinstance <= 256) err = 0;
    }
 
+   if (argc == 3) {
+      if (0 == strcmp(argv[2], "iqueue")) {
+         s_type = TYPE_IQUEUE;
+      } else if (0 == strcmp(argv[2], "iqfc")) {
+         s_type = TYPE_IQFC;
+      } else if (0 == strcmp(argv[2], "iqscq")) {
+         s_type = TYPE_IQSCQ;
+      } else {
+         err = EINVAL;
+      }
+   }
+
    if (err) {
-      printf("Usage: %s [nr-threads]\n", argv[0]);
+      printf("Usage: %s [nr-threads] [iqueue|iqfc|iqscq]\n", argv[0]);
       printf("With: 1 < nr-threads < 257\n");
+      printf("Default queue type: iqueue1_t for 2 threads else iqueue_t\n");
       exit(err);
    }
 
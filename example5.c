@@ -0,0 +1,121 @@
+// Measure latency percentiles (p50, p99, p99.9, max) of iqueue_t and wait-free iqwf_t
+// Every thread sends a message and receives one in a loop (a send/recv pair is one sample).
+#define _GNU_SOURCE
+#include "iqueue.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NROPS 200000
+
+typedef struct param_t {
+   int       tid;
+   uint64_t* latency; // NROPS samples in nanoseconds
+} param_t;
+
+static iqueue_t* s_queue;
+static iqwf_t*   s_queuewf;
+
+static uint64_t now_nsec(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void* run_iqueue(void* _param)
+{
+   param_t* param = _param;
+   void* msg;
+   for (int i = 0; i < NROPS; ++i) {
+      uint64_t start = now_nsec();
+      while (trysend_iqueue(s_queue, (void*)(intptr_t)(i+1))) ;
+      while (tryrecv_iqueue(s_queue, &msg)) ;
+      param->latency[i] = now_nsec() - start;
+   }
+   return 0;
+}
+
+static void* run_iqwf(void* _param)
+{
+   param_t* param = _param;
+   uint32_t tid = (uint32_t) param->tid;
+   void* msg;
+   for (int i = 0; i < NROPS; ++i) {
+      uint64_t start = now_nsec();
+      while (trysend_iqwf(s_queuewf, tid, (void*)(intptr_t)(i+1))) ;
+      while (tryrecv_iqwf(s_queuewf, tid, &msg)) ;
+      param->latency[i] = now_nsec() - start;
+   }
+   return 0;
+}
+
+static int compare_u64(const void* left, const void* right)
+{
+   uint64_t l = *(const uint64_t*)left;
+   uint64_t r = *(const uint64_t*)right;
+   return l < r ? -1 : l > r;
+}
+
+static void measure(const char* name, void* (*run) (void*), int nrthread, param_t* param, uint64_t* latency)
+{
+   pthread_t thr[64];
+
+   for (int tid = 0; tid < nrthread; ++tid) {
+      param[tid].tid = tid;
+      param[tid].latency = latency + (size_t)tid * NROPS;
+      if (pthread_create(&thr[tid], 0, run, &param[tid])) {
+         fprintf(stderr, "ERROR: pthread_create\n");
+         exit(1);
+      }
+   }
+   for (int tid = 0; tid < nrthread; ++tid) {
+      pthread_join(thr[tid], 0);
+   }
+
+   size_t nrsample = (size_t)nrthread * NROPS;
+   qsort(latency, nrsample, sizeof(latency[0]), &compare_u64);
+   printf("%-8s p50: %6llu ns  p99: %7llu ns  p99.9: %8llu ns  max: %9llu ns\n", name,
+          (unsigned long long) latency[nrsample/2],
+          (unsigned long long) latency[nrsample*99/100],
+          (unsigned long long) latency[nrsample*999/1000],
+          (unsigned long long) latency[nrsample-1]);
+}
+
+int main(int argc, const char* argv[])
+{
+   int nrthread = 0;
+
+   if (argc == 2) {
+      sscanf(argv[1], "%d", &nrthread);
+   }
+
+   if (nrthread < 1 || nrthread > 64) {
+      printf("Usage: %s [nr-threads]\n", argv[0]);
+      printf("With: 0 < nr-threads < 65\n");
+      exit(EINVAL);
+   }
+
+   printf("Run %d test threads (%d send/recv pairs per thread)\n", nrthread, NROPS);
+
+   param_t*  param = malloc(sizeof(param_t) * (size_t)nrthread);
+   uint64_t* latency = malloc(sizeof(uint64_t) * (size_t)nrthread * NROPS);
+   if (!param || !latency
+       || new_iqueue(&s_queue, 256)
+       || new_iqwf(&s_queuewf, 64, (uint32_t)nrthread)) {
+      fprintf(stderr, "ERROR: %s\n", strerror(ENOMEM));
+      exit(ENOMEM);
+   }
+
+   measure("iqueue_t", &run_iqueue, nrthread, param, latency);
+   measure("iqwf_t", &run_iqwf, nrthread, param, latency);
+
+   delete_iqueue(&s_queue);
+   delete_iqwf(&s_queuewf);
+   free(latency);
+   free(param);
+
+   return 0;
+}
@@ -0,0 +1,405 @@
+// Record send/recv events of a bursty workload into a trace file and replay it against a queue type
+// The replay reproduces the arrival pattern of the trace: every captured thread becomes a replay thread
+// which starts each send or receive of a batch of messages at its recorded time.
+// Recording needs a library compiled with IQUEUE_CAPTURE (make replay QUEUE=iqscq does both).
+#define _GNU_SOURCE
+#include "iqueue.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NRPRODUCER 2
+#define NRCONSUMER 2
+#define NRMSG      20000
+// a receive which could not get all messages is given up this long after the next event of its thread
+#define SLACK_NSEC 1000000
+
+static uint64_t now_nsec(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// ==== record ====
+
+static iqueue_t* s_record;
+
+static void* run_producer(void* arg)
+{
+   unsigned    seed = (unsigned) (uintptr_t) arg;
+   iqbuffer_t* buffer;
+   int         nrsent = 0;
+
+   if (new_iqbuffer(&buffer, s_record, 32, 1000)) {
+      fprintf(stderr, "ERROR: %s\n", strerror(ENOMEM));
+      exit(ENOMEM);
+   }
+
+   while (nrsent < NRMSG) {
+      // bursts of 1..32 messages with pauses of 0..50 microseconds
+      int burst = 1 + rand_r(&seed) % 32;
+      if (burst > NRMSG - nrsent) burst = NRMSG - nrsent;
+      for (int i = 0; i < burst; ++i) {
+         send_iqbuffer(buffer, (void*)(intptr_t)(++nrsent));
+      }
+      flush_iqbuffer(buffer);
+      uint64_t end = now_nsec() + (uint64_t) (rand_r(&seed) % 50) * 1000;
+      while (now_nsec() < end) sched_yield();
+   }
+
+   delete_iqbuffer(&buffer);
+
+   return 0;
+}
+
+static void* run_consumer(void* arg)
+{
+   void* msg[16];
+   size_t nrrecv;
+   (void) arg;
+
+   while (0 == recvn_iqueue(s_record, msg, 16, 1, 20, &nrrecv)) ;
+
+   return 0;
+}
+
+static int record(const char* filename)
+{
+   pthread_t thr[NRPRODUCER+NRCONSUMER];
+   int err;
+
+   err = new_iqueue(&s_record, 256);
+   if (err) return err;
+
+   err = start_iqcapture(filename, 4 * NRPRODUCER * NRMSG);
+   if (err) {
+      delete_iqueue(&s_record);
+      return err;
+   }
+
+   for (int i = 0; i < NRPRODUCER+NRCONSUMER; ++i) {
+      if (pthread_create(&thr[i], 0, i < NRPRODUCER ? &run_producer : &run_consumer, (void*)(uintptr_t)(i+1))) {
+         fprintf(stderr, "ERROR: pthread_create\n");
+         exit(1);
+      }
+   }
+   for (int i = 0; i < NRPRODUCER; ++i) {
+      pthread_join(thr[i], 0);
+   }
+   while (size_iqueue(s_record)) sched_yield();
+   close_iqueue(s_record);
+   for (int i = NRPRODUCER; i < NRPRODUCER+NRCONSUMER; ++i) {
+      pthread_join(thr[i], 0);
+   }
+
+   err = stop_iqcapture();
+   delete_iqueue(&s_record);
+
+   return err;
+}
+
+// ==== replay ====
+
+// Operations of a replayed queue type. tid is the index of the replay thread.
+typedef struct queueops_t {
+   const char* name;
+   int (*new) (void** queue, uint32_t capacity, uint32_t nrthread);
+   int (*trysend) (void* queue, uint32_t tid, void* msg);
+   int (*tryrecv) (void* queue, uint32_t tid, void** msg);
+   void (*delete) (void** queue);
+} queueops_t;
+
+static int new_queue(void** queue, uint32_t capacity, uint32_t nrthread)
+{
+   (void) nrthread;
+   return new_iqueue((iqueue_t**)queue, capacity);
+}
+
+static int trysend_queue(void* queue, uint32_t tid, void* msg)
+{
+   (void) tid;
+   return trysend_iqueue(queue, msg);
+}
+
+static int tryrecv_queue(void* queue, uint32_t tid, void** msg)
+{
+   (void) tid;
+   return tryrecv_iqueue(queue, msg);
+}
+
+static void delete_queue(void** queue)
+{
+   delete_iqueue((iqueue_t**)queue);
+}
+
+static int new_scq(void** queue, uint32_t capacity, uint32_t nrthread)
+{
+   (void) nrthread;
+   return new_iqscq((iqscq_t**)queue, capacity);
+}
+
+static int trysend_scq(void* queue, uint32_t tid, void* msg)
+{
+   (void) tid;
+   return trysend_iqscq(queue, msg);
+}
+
+static int tryrecv_scq(void* queue, uint32_t tid, void** msg)
+{
+   (void) tid;
+   return tryrecv_iqscq(queue, msg);
+}
+
+static void delete_scq(void** queue)
+{
+   delete_iqscq((iqscq_t**)queue);
+}
+
+static int new_fc(void** queue, uint32_t capacity, uint32_t nrthread)
+{
+   return new_iqfc((iqfc_t**)queue, capacity, nrthread);
+}
+
+static int trysend_fc(void* queue, uint32_t tid, void* msg)
+{
+   return trysend_iqfc(queue, tid, msg);
+}
+
+static int tryrecv_fc(void* queue, uint32_t tid, void** msg)
+{
+   return tryrecv_iqfc(queue, tid, msg);
+}
+
+static void delete_fc(void** queue)
+{
+   delete_iqfc((iqfc_t**)queue);
+}
+
+static const queueops_t s_ops[] = {
+   { "iqueue", &new_queue, &trysend_queue, &tryrecv_queue, &delete_queue },
+   { "iqscq",  &new_scq,   &trysend_scq,   &tryrecv_scq,   &delete_scq },
+   { "iqfc",   &new_fc,    &trysend_fc,    &tryrecv_fc,    &delete_fc },
+};
+
+typedef struct replay_t {
+   uint32_t          tid;
+   uint32_t          nrevent;
+   iqcaptureevent_t* event;    // events of this thread sorted by time
+   uint64_t*         lag_nsec; // end of operation minus its recorded start time
+   uint64_t          nrsent;
+   uint64_t          nrrecv;
+   uint64_t          nrmissed; // messages which could not be sent or received until the deadline
+} replay_t;
+
+static const queueops_t* s_replayops;
+static void*             s_replayqueue[65536];
+static uint64_t          s_starttime;
+static uint64_t          s_endtime; // last recorded time + SLACK_NSEC
+
+static void* run_replay(void* arg)
+{
+   replay_t* replay = arg;
+
+   for (uint32_t e = 0; e < replay->nrevent; ++e) {
+      const iqcaptureevent_t* event = &replay->event[e];
+      void*    queue = s_replayqueue[event->queueid];
+      uint64_t start = s_starttime + event->time_nsec;
+      uint64_t deadline = (e+1 < replay->nrevent ? s_starttime + replay->event[e+1].time_nsec + SLACK_NSEC : s_endtime);
+      uint64_t now;
+
+      while ((now = now_nsec()) < start) sched_yield();
+
+      uint32_t i = 0;
+      while (i < event->nrmsg) {
+         int err;
+         if (IQCAPTURE_SEND == event->type) {
+            err = s_replayops->trysend(queue, replay->tid, (void*)(uintptr_t)(i+1));
+         } else {
+            void* msg;
+            err = s_replayops->tryrecv(queue, replay->tid, &msg);
+         }
+         if (! err) {
+            ++ i;
+            continue;
+         }
+         if ((now = now_nsec()) >= deadline) {
+            replay->nrmissed += event->nrmsg - i;
+            break;
+         }
+         sched_yield();
+      }
+
+      if (IQCAPTURE_SEND == event->type) {
+         replay->nrsent += i;
+      } else {
+         replay->nrrecv += i;
+      }
+      replay->lag_nsec[e] = now_nsec() - start;
+   }
+
+   return 0;
+}
+
+static int compare_u64(const void* left, const void* right)
+{
+   uint64_t l = *(const uint64_t*)left;
+   uint64_t r = *(const uint64_t*)right;
+   return l < r ? -1 : l > r;
+}
+
+static int replay(const char* filename, const queueops_t* ops, uint32_t capacity)
+{
+   iqcaptureheader_t header;
+   FILE* file = fopen(filename, "rb");
+   if (!file) return errno;
+
+   if (1 != fread(&header, sizeof(header), 1, file) || 0 != memcmp(header.magic, "iqcapt1", 8)) {
+      fclose(file);
+      return EINVAL;
+   }
+
+   iqcaptureevent_t* event = malloc(sizeof(iqcaptureevent_t) * (header.nrevent + 1u));
+   uint64_t* lag = malloc(sizeof(uint64_t) * (header.nrevent + 1u));
+   if (!event || !lag) {
+      fprintf(stderr, "ERROR: %s\n", strerror(ENOMEM));
+      exit(ENOMEM);
+   }
+   if (header.nrevent != fread(event, sizeof(iqcaptureevent_t), header.nrevent, file)) {
+      fclose(file);
+      free(event);
+      free(lag);
+      return EINVAL;
+   }
+   fclose(file);
+
+   // group events by thread, the order by time is kept
+   uint32_t nrthread = 0;
+   uint32_t nrqueue = 0;
+   for (uint32_t i = 0; i < header.nrevent; ++i) {
+      if (event[i].threadid > nrthread) nrthread = event[i].threadid;
+   }
+   if (0 == nrthread || nrthread > 1024) {
+      free(event);
+      free(lag);
+      return EINVAL;
+   }
+   for (uint32_t i = 0; i < header.nrevent; ++i) {
+      if (0 == event[i].queueid || s_replayqueue[event[i].queueid]) continue;
+      if (ops->new(&s_replayqueue[event[i].queueid], capacity, nrthread)) {
+         fprintf(stderr, "ERROR: could not create queue\n");
+         exit(1);
+      }
+      ++ nrqueue;
+   }
+
+   replay_t* thread = calloc(nrthread, sizeof(replay_t));
+   iqcaptureevent_t* sorted = malloc(sizeof(iqcaptureevent_t) * (header.nrevent + 1u));
+   pthread_t* thr = malloc(sizeof(pthread_t) * nrthread);
+   if (!thread || !sorted || !thr) {
+      fprintf(stderr, "ERROR: %s\n", strerror(ENOMEM));
+      exit(ENOMEM);
+   }
+   for (uint32_t i = 0; i < header.nrevent; ++i) {
+      if (event[i].threadid && event[i].queueid) ++ thread[event[i].threadid-1].nrevent;
+   }
+   for (uint32_t t = 0, offset = 0; t < nrthread; ++t) {
+      thread[t].tid = t;
+      thread[t].event = &sorted[offset];
+      thread[t].lag_nsec = &lag[offset];
+      offset += thread[t].nrevent;
+      thread[t].nrevent = 0;
+   }
+   for (uint32_t i = 0; i < header.nrevent; ++i) {
+      if (!event[i].threadid || !event[i].queueid) continue;
+      replay_t* r = &thread[event[i].threadid-1];
+      r->event[r->nrevent++] = event[i];
+   }
+
+   uint64_t duration = header.nrevent ? event[header.nrevent-1].time_nsec : 0;
+   printf("Replay %u events of %u threads on %u queues (trace: %.3f ms, %u events lost) with %s\n",
+          header.nrevent, nrthread, nrqueue, (double)duration / 1e6, header.nrlost, ops->name);
+
+   s_replayops = ops;
+   s_starttime = now_nsec() + 10000000;
+   s_endtime = s_starttime + duration + SLACK_NSEC;
+   for (uint32_t t = 0; t < nrthread; ++t) {
+      if (pthread_create(&thr[t], 0, &run_replay, &thread[t])) {
+         fprintf(stderr, "ERROR: pthread_create\n");
+         exit(1);
+      }
+   }
+   uint64_t nrsent = 0, nrrecv = 0, nrmissed = 0, nrlag = 0;
+   for (uint32_t t = 0; t < nrthread; ++t) {
+      pthread_join(thr[t], 0);
+      nrsent += thread[t].nrsent;
+      nrrecv += thread[t].nrrecv;
+      nrmissed += thread[t].nrmissed;
+      nrlag += thread[t].nrevent;
+   }
+   uint64_t elapsed = now_nsec() - s_starttime;
+
+   qsort(lag, nrlag, sizeof(lag[0]), &compare_u64);
+   printf("replay: %.3f ms  sent: %llu  recv: %llu  missed: %llu\n", (double)elapsed / 1e6,
+          (unsigned long long) nrsent, (unsigned long long) nrrecv, (unsigned long long) nrmissed);
+   if (nrlag) {
+      printf("lag p50: %llu ns  p99: %llu ns  max: %llu ns\n",
+             (unsigned long long) lag[nrlag/2],
+             (unsigned long long) lag[nrlag*99/100],
+             (unsigned long long) lag[nrlag-1]);
+   }
+
+   for (size_t i = 0; i < sizeof(s_replayqueue)/sizeof(s_replayqueue[0]); ++i) {
+      if (s_replayqueue[i]) ops->delete(&s_replayqueue[i]);
+   }
+   free(thr);
+   free(sorted);
+   free(thread);
+   free(lag);
+   free(event);
+
+   return 0;
+}
+
+int main(int argc, const char* argv[])
+{
+   int err = EINVAL;
+
+   if (argc == 3 && 0 == strcmp(argv[1], "record")) {
+      err = record(argv[2]);
+      if (ENOSYS == err) {
+         fprintf(stderr, "ERROR: compile library with IQUEUE_CAPTURE to record a trace\n");
+         return err;
+      } else if (! err) {
+         printf("Recorded trace '%s'\n", argv[2]);
+      }
+
+   } else if ((argc >= 3 && argc <= 5) && 0 == strcmp(argv[1], "replay")) {
+      const queueops_t* ops = &s_ops[0];
+      int capacity = 256;
+      if (argc >= 4 && argv[3][0]) {
+         ops = 0;
+         for (size_t i = 0; i < sizeof(s_ops)/sizeof(s_ops[0]); ++i) {
+            if (0 == strcmp(argv[3], s_ops[i].name)) ops = &s_ops[i];
+         }
+      }
+      if (argc == 5) sscanf(argv[4], "%d", &capacity);
+      if (ops && capacity > 0) {
+         err = replay(argv[2], ops, (uint32_t)capacity);
+      }
+
+   } else {
+      printf("Usage: %s record <trace-file>\n", argv[0]);
+      printf("Usage: %s replay <trace-file> [iqueue|iqscq|iqfc] [capacity]\n", argv[0]);
+      exit(EINVAL);
+   }
+
+   if (err) {
+      fprintf(stderr, "ERROR: %s\n", strerror(err));
+   }
+
+   return err;
+}
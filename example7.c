@@ -0,0 +1,119 @@
+// Measure send throughput of trysend_iqueue and trysendn_iqueue for different capacities
+// Writer threads send messages one by one or in batches of NRBATCH, one reader receives all.
+#define _GNU_SOURCE
+#include "iqueue.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NRMSG   1000000
+#define NRBATCH 32
+
+static iqueue_t* s_queue;
+static int       s_nrwriter;
+
+static uint64_t now_nsec(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void* run_reader(void* _unused)
+{
+   (void) _unused;
+   void* msg;
+   for (int i = 0; i < NRMSG; ++i) {
+      while (tryrecv_iqueue(s_queue, &msg)) sched_yield();
+   }
+   return 0;
+}
+
+static void* run_trysend(void* _unused)
+{
+   (void) _unused;
+   for (int i = 0; i < NRMSG / s_nrwriter; ++i) {
+      while (trysend_iqueue(s_queue, (void*)(intptr_t)(i+1))) sched_yield();
+   }
+   return 0;
+}
+
+static void* run_trysendn(void* _unused)
+{
+   (void) _unused;
+   void* msg[NRBATCH];
+   for (int i = 0; i < NRBATCH; ++i) {
+      msg[i] = (void*)(intptr_t)(i+1);
+   }
+   for (int i = 0; i < NRMSG / s_nrwriter; ) {
+      size_t nrmsg = (size_t) (NRMSG / s_nrwriter - i < NRBATCH ? NRMSG / s_nrwriter - i : NRBATCH);
+      size_t nrsent;
+      if (trysendn_iqueue(s_queue, msg, nrmsg, &nrsent)) {
+         sched_yield();
+         continue;
+      }
+      i += (int) nrsent;
+   }
+   return 0;
+}
+
+// Returns nanoseconds per message.
+static double measure(void* (*run) (void*), iqpos_t capacity)
+{
+   pthread_t reader;
+   pthread_t writer[64];
+
+   if (new_iqueue(&s_queue, capacity)) {
+      fprintf(stderr, "ERROR: %s\n", strerror(ENOMEM));
+      exit(ENOMEM);
+   }
+
+   uint64_t start = now_nsec();
+   if (pthread_create(&reader, 0, &run_reader, 0)) {
+      fprintf(stderr, "ERROR: pthread_create\n");
+      exit(1);
+   }
+   for (int t = 0; t < s_nrwriter; ++t) {
+      if (pthread_create(&writer[t], 0, run, 0)) {
+         fprintf(stderr, "ERROR: pthread_create\n");
+         exit(1);
+      }
+   }
+   for (int t = 0; t < s_nrwriter; ++t) {
+      pthread_join(writer[t], 0);
+   }
+   pthread_join(reader, 0);
+   uint64_t nsec = now_nsec() - start;
+
+   delete_iqueue(&s_queue);
+
+   return (double) nsec / NRMSG;
+}
+
+int main(int argc, const char* argv[])
+{
+   if (argc == 2) {
+      sscanf(argv[1], "%d", &s_nrwriter);
+   }
+
+   if (s_nrwriter < 1 || s_nrwriter > 64 || NRMSG % s_nrwriter) {
+      printf("Usage: %s [nr-writer]\n", argv[0]);
+      printf("With: 0 < nr-writer < 65 and nr-writer divides %d\n", NRMSG);
+      exit(EINVAL);
+   }
+
+   printf("Run %d writer threads and 1 reader (%d messages, batches of %d)\n", s_nrwriter, NRMSG, NRBATCH);
+
+   static const iqpos_t capacity[] = { 256, 4096, 65536 };
+   for (size_t i = 0; i < sizeof(capacity)/sizeof(capacity[0]); ++i) {
+      double single = measure(&run_trysend, capacity[i]);
+      double batch  = measure(&run_trysendn, capacity[i]);
+      printf("capacity %6llu: trysend_iqueue %6.1f ns/msg  trysendn_iqueue %6.1f ns/msg\n",
+             (unsigned long long) capacity[i], single, batch);
+   }
+
+   return 0;
+}
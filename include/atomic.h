@@ -41,4 +41,96 @@ static inline uint32_t fetchadd_atomicu32(uint32_t* pval, uint32_t add)
          return __sync_fetch_and_add(pval, add);
 }
 
+// Does the following operations in one atomic step:
+// { uint64_t old = *pval; if (old == oldval) *pval = newval; return old; }
+static inline uint64_t cmpxchg_atomicu64(uint64_t* pval, uint64_t oldval, uint64_t newval)
+{
+         return __sync_val_compare_and_swap(pval, oldval, newval);
+}
+
+// Does the following operations in one atomic step:
+// { uint64_t old = *pval; *pval += add; return old; }
+static inline uint64_t fetchadd_atomicu64(uint64_t* pval, uint64_t add)
+{
+         return __sync_fetch_and_add(pval, add);
+}
+
+// Does the following operations in one atomic step:
+// { uint64_t old = *pval; *pval |= bits; return old; }
+static inline uint64_t fetchor_atomicu64(uint64_t* pval, uint64_t bits)
+{
+         return __sync_fetch_and_or(pval, bits);
+}
+
+// Does the following operations in one atomic step:
+// { uint64_t old = *pval; *pval ^= bits; return old; }
+static inline uint64_t fetchxor_atomicu64(uint64_t* pval, uint64_t bits)
+{
+         return __sync_fetch_and_xor(pval, bits);
+}
+
+// Does the following operations in one atomic step:
+// { uint32_t old = *pval; *pval = newval; return old; }
+// Acts as full memory barrier (see https://gcc.gnu.org/onlinedocs/gcc/_005f_005fatomic-Builtins.html).
+static inline uint32_t xchg_atomicu32(uint32_t* pval, uint32_t newval)
+{
+         return __atomic_exchange_n(pval, newval, __ATOMIC_SEQ_CST);
+}
+
+// Does the following operations in one atomic step:
+// { void* old = *pval; *pval = newval; return old; }
+// Acts as full memory barrier.
+static inline void* xchg_atomicptr(void** pval, void* newval)
+{
+         return __atomic_exchange_n(pval, newval, __ATOMIC_SEQ_CST);
+}
+
+// Returns *pval. Following loads and stores are not reordered before it (acquire semantics).
+static inline uint32_t load_atomicu32(const uint32_t* pval)
+{
+         return __atomic_load_n(pval, __ATOMIC_ACQUIRE);
+}
+
+// Returns *pval. Following loads and stores are not reordered before it (acquire semantics).
+static inline uint64_t load_atomicu64(const uint64_t* pval)
+{
+         return __atomic_load_n(pval, __ATOMIC_ACQUIRE);
+}
+
+// Returns *pval. Following loads and stores are not reordered before it (acquire semantics).
+static inline void* load_atomicptr(void* const* pval)
+{
+         return __atomic_load_n(pval, __ATOMIC_ACQUIRE);
+}
+
+// Does *pval = newval. Preceding loads and stores are not reordered after it (release semantics).
+static inline void store_atomicu32(uint32_t* pval, uint32_t newval)
+{
+         __atomic_store_n(pval, newval, __ATOMIC_RELEASE);
+}
+
+// Does *pval = newval. Preceding loads and stores are not reordered after it (release semantics).
+static inline void store_atomicu64(uint64_t* pval, uint64_t newval)
+{
+         __atomic_store_n(pval, newval, __ATOMIC_RELEASE);
+}
+
+// Does *pval = newval. Preceding loads and stores are not reordered after it (release semantics).
+static inline void store_atomicptr(void** pval, void* newval)
+{
+         __atomic_store_n(pval, newval, __ATOMIC_RELEASE);
+}
+
+// Preceding loads and stores are not reordered after following stores.
+static inline void releasefence_atomic(void)
+{
+         __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// Preceding loads and stores are not reordered after following loads and stores (full memory barrier).
+static inline void fence_atomic(void)
+{
+         __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
 #endif
@@ -16,13 +16,31 @@
 
 // defines the size of the cache line
 // if this value is undefined cache line alignment is turned off !
+// Compile with -DSIZE_CACHELINE=128 to pad to pairs of cache lines (defeats the adjacent line prefetcher).
+#ifndef SIZE_CACHELINE
 #define SIZE_CACHELINE 64
+#endif
 
+#include <errno.h>
 #include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <time.h>
 #include "atomic.h"
 
+// defines the width of positions and capacities of iqueue_t and iqueue1_t
+// if IQUEUE_POS64 is defined (library and application must agree) they are 64 bit wide.
+// This supports rings with more than 2^32 slots and counters which never wrap around.
+#ifdef IQUEUE_POS64
+typedef uint64_t iqpos_t;
+#   define fetchadd_atomicpos  fetchadd_atomicu64
+#   define cmpxchg_atomicpos   cmpxchg_atomicu64
+#else
+typedef uint32_t iqpos_t;
+#   define fetchadd_atomicpos  fetchadd_atomicu32
+#   define cmpxchg_atomicpos   cmpxchg_atomicu32
+#endif
+
 // defines padding function which prevents false sharing of variables
 // http://en.wikipedia.org/wiki/False_sharing
 #ifdef SIZE_CACHELINE
@@ -38,48 +56,370 @@ typedef struct iqsignal_t {
    size_t signalcount;
 } iqsignal_t;
 
+// Allows to wake up a single waiting reader or writer (see waitrecv_iqueue).
+typedef struct iqcancel_t {
+   uint32_t    canceled;
+   iqsignal_t* signal; // signal the waiter sleeps on (0 if not waiting)
+} iqcancel_t;
+
+// Entry of a queue registered by name (see register_iqueue).
+struct iqregentry_t;
+
 // Supports multi reader / multi writer
+// Fields written by readers and fields written by writers live on different cache lines.
+// The exception are the striped counters sizeused / sizefree which both sides write:
+// a send takes from sizefree[ifree] and adds to sizeused[ifree], a receive does the reverse
+// at index iused. Striping spreads these writes over 256 entries instead of one shared line.
+// The blocking state (reader, writer) is only written by waiting threads and is kept apart.
 typedef struct iqueue_t {
    uint32_t closed;
-   uint32_t capacity;
-   PAD(0, 2*sizeof(uint32_t))
-   uint32_t iused; // index into sizeused
-   PAD(1, sizeof(uint32_t))
-   uint32_t readpos;
-   PAD(2, sizeof(uint32_t))
-   uint32_t ifree; // index into sizefree
-   PAD(3, sizeof(uint32_t))
-   uint32_t writepos;
-   PAD(4, sizeof(uint32_t))
-   uint32_t sizeused[256/*must be power of two*/];
-   uint32_t sizefree[256/*same size as sizeused*/];
+   iqpos_t  capacity;
+   struct iqregentry_t* regentry; // 0 if not registered
+   PAD(0, 2*sizeof(iqpos_t) + sizeof(void*))
+   uint32_t iused; // index into sizeused, written by readers
+   iqpos_t  readpos;
+   PAD(1, 2*sizeof(iqpos_t))
+   uint32_t ifree; // index into sizefree, written by writers
+   iqpos_t  writepos;
+   PAD(2, 2*sizeof(iqpos_t))
+   iqpos_t  sizeused[256/*must be power of two*/];
+   iqpos_t  sizefree[256/*same size as sizeused*/];
    iqsignal_t reader;
+   PAD(3, sizeof(iqsignal_t) % (SIZE_CACHELINE))
    iqsignal_t writer;
+   PAD(4, sizeof(iqsignal_t) % (SIZE_CACHELINE))
    void*    msg[/*capacity*/];
 } iqueue_t;
 
 // Supports single reader / single writer
+// readpos is owned by the reader and writepos by the writer. Both live on their own cache line.
 typedef struct iqueue1_t {
+   uint32_t closed;
+   iqpos_t  capacity;
+   struct iqregentry_t* regentry; // 0 if not registered
+   PAD(0, 2*sizeof(iqpos_t) + sizeof(void*))
+   iqpos_t  readpos;
+   PAD(1, sizeof(iqpos_t))
+   iqpos_t  writepos;
+   PAD(2, sizeof(iqpos_t))
+   iqsignal_t reader;
+   PAD(3, sizeof(iqsignal_t) % (SIZE_CACHELINE))
+   iqsignal_t writer;
+   PAD(4, sizeof(iqsignal_t) % (SIZE_CACHELINE))
+   void*   msg[/*capacity*/];
+} iqueue1_t;
+
+// List of cached iqueue1_t of one capacity (see iqpool_t).
+typedef struct iqpoolclass_t {
+   pthread_mutex_t lock;
+   uint32_t   nrfree;
+   iqueue1_t* free; // cached queues linked with msg[0]
+   PAD(0, (sizeof(pthread_mutex_t) + 2*sizeof(void*)) % (SIZE_CACHELINE))
+} iqpoolclass_t;
+
+// Caches closed and reset iqueue1_t for reuse. Capacities are rounded up to the next power of two.
+typedef struct iqpool_t {
+   uint32_t      maxfree; // max nr of cached queues per capacity
+   PAD(0, sizeof(uint32_t))
+   iqpoolclass_t sizeclass[32/*capacity 1,2,4,...,2^31*/];
+} iqpool_t;
+
+// flag in iqtriple_t:state which marks shared buffer as not read
+#define IQTRIPLE_FRESH 4
+
+// Supports single reader / single writer which exchange the latest value only
+typedef struct iqtriple_t {
+   size_t   bufsize;
+   uint8_t* buffer[3];
+   PAD(0, sizeof(size_t) + 3*sizeof(uint8_t*))
+   uint32_t windex; // index into buffer, owned by writer
+   PAD(1, sizeof(uint32_t))
+   uint32_t state;  // index into buffer of shared buffer | IQTRIPLE_FRESH
+   PAD(2, sizeof(uint32_t))
+   uint32_t rindex; // index into buffer, owned by reader
+} iqtriple_t;
+
+// Supports multi reader / multi writer. Unreceived messages with the same key are replaced
+typedef struct iqconflate_t {
+   iqueue_t* keys;   // keys (+1) of messages not received yet in order of arrival
+   uint32_t  nrkeys;
+   PAD(0, sizeof(iqueue_t*) + sizeof(uint32_t))
+   void*     msg[/*nrkeys*/]; // latest not received message of every key
+} iqconflate_t;
+
+// Slot of iqlossy_t. seq is set to position+1 of msg (0 during write).
+typedef struct iqlossyslot_t {
+   uint64_t seq;
+   void*    msg;
+} iqlossyslot_t;
+
+// Supports single reader / single writer. The writer overwrites the oldest unread message if full
+typedef struct iqlossy_t {
    uint32_t closed;
    uint32_t capacity;
    PAD(0, 2*sizeof(uint32_t))
-   uint32_t readpos;
+   uint64_t readpos;
+   uint64_t nrlost; // nr of lost messages not reported to the reader
+   PAD(1, 2*sizeof(uint64_t))
+   uint64_t writepos;
+   PAD(2, sizeof(uint64_t))
+   iqlossyslot_t msg[/*capacity*/];
+} iqlossy_t;
+
+// Caller owned array of nrelem elements of size elemsize.
+// An element is addressed by a 32 bit handle (index+1). Handle 0 is invalid.
+typedef struct iqarena_t {
+   uint8_t* base;
+   size_t   elemsize;
+   uint32_t nrelem;
+} iqarena_t;
+
+// Supports single reader / single writer. Transfers 32 bit handles into an iqarena_t instead of pointers
+typedef struct iqueue1h_t {
+   uint32_t  closed;
+   uint32_t  capacity;
+   iqarena_t arena;
+   PAD(0, 2*sizeof(uint32_t) + sizeof(iqarena_t))
+   uint32_t  readpos;
    PAD(1, sizeof(uint32_t))
+   uint32_t  writepos;
+   PAD(2, sizeof(uint32_t))
+   iqsignal_t reader;
+   PAD(3, sizeof(iqsignal_t) % (SIZE_CACHELINE))
+   iqsignal_t writer;
+   PAD(4, sizeof(iqsignal_t) % (SIZE_CACHELINE))
+   uint32_t  msg[/*capacity*/];
+} iqueue1h_t;
+
+// Supports multi reader / multi writer. Compact version of iqueue_t for many small queues.
+// Not padded, the capacity is not rounded up and all waiting readers and writers share one iqsignal_t.
+typedef struct iqueuec_t {
+   uint32_t closed;
+   uint32_t capacity;
+   uint32_t readpos;
    uint32_t writepos;
+   uint32_t sizeused;
+   uint32_t sizefree;
+   iqsignal_t waiter;
+   void*    msg[/*capacity*/];
+} iqueuec_t;
+
+// Link embedded in a message of iqmpsc_t. Use offsetof to get from the node back to the message.
+typedef struct iqnode_t {
+   struct iqnode_t* next;
+} iqnode_t;
+
+// Supports multi writer / single reader. Unbounded intrusive list of iqnode_t (Vyukov MPSC queue).
+typedef struct iqmpsc_t {
+   iqnode_t* tail; // last sent node, written by writers
+   PAD(0, sizeof(iqnode_t*))
+   iqnode_t* head; // next node to receive, owned by reader
+   iqnode_t  stub; // in list if the queue would be empty otherwise
+} iqmpsc_t;
+
+// Slot of iqturn_t. turn is 2*round if the slot is free for the writer of position round*capacity+index
+// and 2*round+1 if it is filled for the reader of this position. turn is also the futex waiters sleep on.
+typedef struct iqturnslot_t {
+   uint32_t turn;
+   uint32_t waiters; // nr of threads sleeping on turn
+   void*    msg;
+} iqturnslot_t;
+
+// Supports multi reader / multi writer. A blocking reader or writer claims its position first
+// and then sleeps on the turn of exactly this slot.
+typedef struct iqturn_t {
+   uint32_t closed;
+   uint32_t capacity;
+   PAD(0, 2*sizeof(uint32_t))
+   uint64_t readpos;
+   PAD(1, sizeof(uint64_t))
+   uint64_t writepos;
+   PAD(2, sizeof(uint64_t))
+   uint32_t nrwaiting; // nr of threads in send_iqturn / recv_iqturn, close waits until it is 0
+   PAD(3, sizeof(uint32_t))
+   iqturnslot_t slot[/*capacity*/];
+} iqturn_t;
+
+// Supports multi reader / multi writer. Hierarchical queue with one iqueue_t per NUMA node.
+// Threads send into the sub-queue of the node they run on and receive from it first.
+// Only the blocking state is shared between all nodes.
+typedef struct iqnuma_t {
+   uint32_t   closed;
+   uint32_t   nrnode;
+   PAD(0, 2*sizeof(uint32_t))
    iqsignal_t reader;
+   PAD(1, sizeof(iqsignal_t) % (SIZE_CACHELINE))
    iqsignal_t writer;
-   void*   msg[/*capacity*/];
-} iqueue1_t;
+   PAD(2, sizeof(iqsignal_t) % (SIZE_CACHELINE))
+   iqueue_t*  node[/*nrnode*/];
+} iqnuma_t;
+
+// Ring of 2*capacity entries which stores indices of iqscq_t:msg.
+// An entry encodes cycle (31 bit) | safe flag (1 bit) | index (32 bit).
+typedef struct iqscqring_t {
+   uint64_t  head;
+   PAD(0, sizeof(uint64_t))
+   uint64_t  tail;
+   PAD(1, sizeof(uint64_t))
+   int64_t   threshold; // < 0: ring is empty
+   uint64_t* entry;
+   PAD(2, sizeof(int64_t) + sizeof(uint64_t*))
+} iqscqring_t;
+
+// Supports multi reader / multi writer. Scalable circular queue (SCQ, Nikolaev 2019).
+// Senders and receivers claim their entry with a single fetch-and-add instead of a CAS loop.
+// The ring aq holds the indices of filled msg slots and fq the indices of free ones.
+typedef struct iqscq_t {
+   uint32_t    closed;
+   uint32_t    capacity;
+   uint32_t    order; // log2(2*capacity)
+   PAD(0, 3*sizeof(uint32_t))
+   iqscqring_t aq;
+   iqscqring_t fq;
+   iqsignal_t  reader;
+   PAD(1, sizeof(iqsignal_t) % (SIZE_CACHELINE))
+   iqsignal_t  writer;
+   PAD(2, sizeof(iqsignal_t) % (SIZE_CACHELINE))
+   void*       msg[/*capacity*/]; // followed by entries of aq and fq
+} iqscq_t;
+
+// State of iqwf_t. A thread copies the current state into one of its own records,
+// applies all announced operations and installs it with a single CAS.
+typedef struct iqwfstate_t {
+   uint64_t applied; // bit t equals toggle bit of thread t if its last operation is applied
+   uint64_t readpos;
+   uint64_t writepos;
+   void*    ret[/*nrthread*/]; // result of last operation of every thread, followed by capacity msg slots
+} iqwfstate_t;
+
+// Announced operation of a thread of iqwf_t.
+typedef struct iqwfthread_t {
+   void*    msg;          // msg to send or 0 if receive
+   uint32_t toggle;       // current toggle bit of the thread (private)
+   uint32_t record;       // index of next own record (private)
+   uint64_t installed[2]; // state of own installed record or 0 if its results are published (private)
+   uint64_t published;    // state of last own record whose results are copied to iqwf_t.result
+   PAD(0, sizeof(void*) + 2*sizeof(uint32_t) + 3*sizeof(uint64_t))
+} iqwfthread_t;
+
+// Supports up to 64 reader / writer threads. Wait-free: every operation is applied
+// after at most two attempts of the calling thread (P-Sim, Fatourou and Kallimanis 2011).
+// Before a thread reuses an installed record it copies the results of all threads into its row
+// of result. A thread which reads its result from a reused record takes it from there instead.
+typedef struct iqwf_t {
+   uint32_t closed;
+   uint32_t capacity;
+   uint32_t nrthread;
+   uint32_t recordsize;
+   uint8_t* records;  // 2*nrthread own records + 1 initial record
+   void**   result;   // nrthread rows of nrthread results, row t is written by thread t
+   PAD(0, 4*sizeof(uint32_t) + sizeof(uint8_t*) + sizeof(void**))
+   uint64_t state;    // seq << 8 | index of current record
+   PAD(1, sizeof(uint64_t))
+   uint64_t toggles;  // bit t is toggled by thread t to announce a new operation
+   PAD(2, sizeof(uint64_t))
+   iqwfthread_t thread[/*nrthread*/];
+} iqwf_t;
+
+// Request slot of a thread of iqfc_t.
+typedef struct iqfcslot_t {
+   void*    msg;     // msg to send or 0 if receive
+   void*    ret;     // result of request (0: queue full or empty)
+   uint32_t pending; // 1: request published, set to 0 by the combiner after it is applied
+   PAD(0, 2*sizeof(void*) + sizeof(uint32_t))
+} iqfcslot_t;
+
+// Supports multi reader / multi writer with flat combining.
+// Threads publish requests in their slot. The thread which acquires the lock becomes the combiner
+// and applies all published requests to a sequential ring. The other threads wait on their own slot.
+typedef struct iqfc_t {
+   uint32_t closed;
+   uint32_t capacity;
+   uint32_t nrthread;
+   PAD(0, 3*sizeof(uint32_t))
+   uint32_t lock;
+   PAD(1, sizeof(uint32_t))
+   uint32_t readpos;  // only accessed by combiner
+   uint32_t writepos; // only accessed by combiner
+   void**   msg;      // capacity msg slots after slot[nrthread]
+   PAD(2, 2*sizeof(uint32_t) + sizeof(void**))
+   iqfcslot_t slot[/*nrthread*/];
+} iqfc_t;
+
+// Producer-local buffer of an iqueue_t. Must only be used by a single thread.
+typedef struct iqbuffer_t {
+   iqueue_t* queue;
+   uint32_t  size;     // nr of buffered messages
+   uint32_t  capacity; // max nr of buffered messages
+   uint32_t  maxlatency_usec;
+   uint64_t  firsttime_usec; // time the oldest buffered message was appended
+   void*     msg[/*capacity*/];
+} iqbuffer_t;
+
+// Number of msg slots of iqline_t which fill one cache line.
+#define IQLINE_NRSLOT ((uint32_t) ((SIZE_CACHELINE) / sizeof(void*)))
+
+// Supports single reader / single writer. The writer fills a whole cache line of slots
+// and publishes it with a single release store of writepos. So every line of slots
+// is transferred once to the reader instead of once per message.
+typedef struct iqline_t {
+   uint32_t closed;
+   uint32_t capacity;
+   PAD(0, 2*sizeof(uint32_t))
+   uint32_t readpos;   // written by reader
+   uint32_t readlimit; // reader's copy of writepos
+   PAD(1, 2*sizeof(uint32_t))
+   uint32_t writepos;  // published position, written by writer
+   PAD(2, sizeof(uint32_t))
+   uint32_t nextpos;   // writer's position of next msg, msg[writepos..nextpos-1] are unpublished
+   uint32_t writelimit;// writer's copy of readpos
+   PAD(3, 2*sizeof(uint32_t))
+   iqsignal_t reader;
+   PAD(4, sizeof(iqsignal_t) % (SIZE_CACHELINE))
+   iqsignal_t writer;
+   PAD(5, sizeof(iqsignal_t) % (SIZE_CACHELINE))
+   void*    msg[/*capacity*/];
+} iqline_t;
+
+// Types of a captured event.
+enum { IQCAPTURE_SEND = 1, IQCAPTURE_RECV = 2 };
+// Types of a captured queue.
+enum { IQCAPTURE_IQUEUE = 1, IQCAPTURE_IQUEUE1 = 2 };
+
+// Header of a trace file written by stop_iqcapture. It is followed by nrevent iqcaptureevent_t
+// sorted by time. All values are stored in the byte order of the capturing machine.
+typedef struct iqcaptureheader_t {
+   char     magic[8]; // "iqcapt1"
+   uint32_t nrevent;  // nr of stored events
+   uint32_t nrlost;   // nr of events which did not fit into the capture buffer
+} iqcaptureheader_t;
+
+// Event of a trace file. Records a successful send or receive of a batch of nrmsg messages.
+typedef struct iqcaptureevent_t {
+   uint64_t time_nsec; // CLOCK_MONOTONIC relative to start_iqcapture
+   uint16_t queueid;   // 1.. (0: more than 4096 captured queues)
+   uint16_t threadid;  // 1.. in order of the first captured event of a thread
+   uint16_t nrmsg;     // batch size (saturates at 65535)
+   uint8_t  type;      // IQCAPTURE_SEND or IQCAPTURE_RECV
+   uint8_t  queuetype; // IQCAPTURE_IQUEUE or IQCAPTURE_IQUEUE1
+} iqcaptureevent_t;
 
 // === iqueue_t ===
 
 // Initializes queue
 // Possible error codes: EINVAL (capacity too big) or ENOMEM
-int new_iqueue(/*out*/iqueue_t** queue, uint32_t capacity);
+int new_iqueue(/*out*/iqueue_t** queue, iqpos_t capacity);
 
 // Frees all resources of queue. Close is called automatically.
 int delete_iqueue(iqueue_t** queue);
 
+// Initializes queue in memory provided by the caller (sizeof(iqueue_t) + capacity*sizeof(void*) bytes).
+// See iqueue_STATIC. Possible error codes: EINVAL (capacity not a power of two)
+int init_iqueue(/*out*/iqueue_t* queue, iqpos_t capacity);
+
+// Frees resources of queue initialized with init_iqueue. Close is called automatically.
+int free_iqueue(iqueue_t* queue);
+
 // Marks queue as closed and wakes up any waiting reader/writer.
 // Blocks until all read/writer has left queue.
 void close_iqueue(iqueue_t* queue);
@@ -93,6 +433,17 @@ int trysend_iqueue(iqueue_t* queue, void* msg);
 // Waiting readers are woken up.
 int send_iqueue(iqueue_t* queue, void* msg);
 
+// Stores msg in queue. Blocks if queue is full until the absolute deadline of CLOCK_MONOTONIC expires.
+// deadline == 0 waits without time limit. ETIMEDOUT is returned if deadline expired.
+// EINVAL is returned if deadline->tv_nsec is not in range [0, 999999999].
+// EPIPE is returned if queue is closed.
+int timedsend_iqueue(iqueue_t* queue, void* msg, const struct timespec* deadline);
+
+// Stores msg in queue. Blocks if queue is full like timedsend_iqueue.
+// If cancel != 0 the waiting thread returns ECANCELED after cancel_iqcancel(cancel) is called.
+// A canceled cancel makes this function return ECANCELED instead of waiting.
+int waitsend_iqueue(iqueue_t* queue, void* msg, const struct timespec* deadline, iqcancel_t* cancel);
+
 // Receives msg from queue. EAGAIN is returned if queue is empty.
 // EPIPE is returned if queue is closed.
 int tryrecv_iqueue(iqueue_t* queue, /*out*/void** msg);
@@ -102,14 +453,46 @@ int tryrecv_iqueue(iqueue_t* queue, /*out*/void** msg);
 // Waiting writers are woken up.
 int recv_iqueue(iqueue_t* queue, /*out*/void** msg);
 
+// Receives msg from queue. Blocks if queue is empty until the absolute deadline of CLOCK_MONOTONIC expires.
+// deadline == 0 waits without time limit. ETIMEDOUT is returned if deadline expired.
+// EINVAL is returned if deadline->tv_nsec is not in range [0, 999999999].
+// EPIPE is returned if queue is closed.
+int timedrecv_iqueue(iqueue_t* queue, /*out*/void** msg, const struct timespec* deadline);
+
+// Receives msg from queue. Blocks if queue is empty like timedrecv_iqueue.
+// If cancel != 0 the waiting thread returns ECANCELED after cancel_iqcancel(cancel) is called.
+// A canceled cancel makes this function return ECANCELED instead of waiting.
+int waitrecv_iqueue(iqueue_t* queue, /*out*/void** msg, const struct timespec* deadline, iqcancel_t* cancel);
+
+// Stores up to nrmsg messages from msg[] in queue. Free slots are reserved in blocks
+// so that a batch needs only a few atomic operations. Waiting readers are not woken up.
+// A block is reserved from one of the 256 striped counters which holds about capacity/256 free slots,
+// so a batch of nrmsg messages needs about nrmsg/(capacity/256) CAS operations. With a capacity
+// of 256 or less a block holds a single slot and there is no gain over trysend_iqueue (see example7.c).
+// nrsent is set to the number of stored messages (msg[0..nrsent-1]). EAGAIN is returned if queue is full.
+// EINVAL is returned if any msg[i] == 0. EPIPE is returned if queue is closed.
+int trysendn_iqueue(iqueue_t* queue, void* msg[/*nrmsg*/], size_t nrmsg, /*out*/size_t* nrsent);
+
+// Receives up to nrmsg messages from queue into msg[]. Blocks if queue is empty.
+// After the first message is received it waits until at least minmsg messages are received
+// or until maxlatency_usec microseconds have passed. Available messages are received without waiting
+// up to nrmsg. nrrecv is set to the number of received messages (>= 1).
+// EINVAL is returned if nrmsg == 0 or nrmsg < minmsg. EPIPE is returned if queue is closed
+// before the first message is received. Waiting writers are woken up.
+int recvn_iqueue(iqueue_t* queue, /*out*/void* msg[/*nrmsg*/], size_t nrmsg, size_t minmsg, uint32_t maxlatency_usec, /*out*/size_t* nrrecv);
+
+// Reopens a closed queue for reuse in constant time. The queue must not be used by other threads.
+// EINVAL is returned if queue is not closed. EBUSY is returned if queue still contains messages.
+int reset_iqueue(iqueue_t* queue);
+
 // Returns maximum number of storable messages.
-static inline uint32_t capacity_iqueue(const iqueue_t* queue)
+static inline iqpos_t capacity_iqueue(const iqueue_t* queue)
 {
          return queue->capacity;
 }
 
 // Returns number of stored (unread) messages.
-uint32_t size_iqueue(const iqueue_t* queue);
+iqpos_t size_iqueue(const iqueue_t* queue);
 
 // === iqsignal_t ===
 
@@ -123,7 +506,7 @@ int free_iqsignal(iqsignal_t* signal);
 void wait_iqsignal(iqsignal_t* signal);
 
 // Clears signalcount to 0 and returns previous value
-uint32_t clearsignal_iqsignal(iqsignal_t* signal);
+size_t clearsignal_iqsignal(iqsignal_t* signal);
 
 // Increments signalcount by one and wakes up all threads waiting with wait_iqsignal(signal).
 void signal_iqsignal(iqsignal_t* signal);
@@ -131,15 +514,32 @@ void signal_iqsignal(iqsignal_t* signal);
 // Returns the how many times signal_iqsignal(signal) was called (Nr of processed messages).
 size_t signalcount_iqsignal(iqsignal_t* signal);
 
+// === iqcancel_t ===
+
+// Initializes cancel as not canceled. Reinitialize it to reuse it after cancel_iqcancel.
+void init_iqcancel(/*out*/iqcancel_t* cancel);
+
+// Marks cancel as canceled. The thread blocked in a waitsend_ or waitrecv_ function with this cancel
+// is woken up and returns ECANCELED. Other readers and writers of the queue are not affected.
+// The queue the waiter blocks on must not be deleted before this function returns.
+void cancel_iqcancel(iqcancel_t* cancel);
+
 // === iqueue1_t ===
 
 // Initializes queue
 // Possible error codes: EINVAL (capacity == 0) or ENOMEM
-int new_iqueue1(/*out*/iqueue1_t** queue, uint32_t capacity);
+int new_iqueue1(/*out*/iqueue1_t** queue, iqpos_t capacity);
 
 // Frees all resources of queue. Close is called automatically.
 int delete_iqueue1(iqueue1_t** queue);
 
+// Initializes queue in memory provided by the caller (sizeof(iqueue1_t) + capacity*sizeof(void*) bytes).
+// See iqueue1_STATIC. Possible error codes: EINVAL (capacity == 0)
+int init_iqueue1(/*out*/iqueue1_t* queue, iqpos_t capacity);
+
+// Frees resources of queue initialized with init_iqueue1. Close is called automatically.
+int free_iqueue1(iqueue1_t* queue);
+
 // Marks queue as closed and wakes up any waiting reader/writer.
 // Blocks until all read/writer has left queue.
 void close_iqueue1(iqueue1_t* queue);
@@ -153,6 +553,17 @@ int trysend_iqueue1(iqueue1_t* queue, void* msg);
 // A waiting reader are woken up.
 int send_iqueue1(iqueue1_t* queue, void* msg);
 
+// Stores msg in queue. Blocks if queue is full until the absolute deadline of CLOCK_MONOTONIC expires.
+// deadline == 0 waits without time limit. ETIMEDOUT is returned if deadline expired.
+// EINVAL is returned if deadline->tv_nsec is not in range [0, 999999999].
+// EPIPE is returned if queue is closed.
+int timedsend_iqueue1(iqueue1_t* queue, void* msg, const struct timespec* deadline);
+
+// Stores msg in queue. Blocks if queue is full like timedsend_iqueue1.
+// If cancel != 0 the waiting thread returns ECANCELED after cancel_iqcancel(cancel) is called.
+// A canceled cancel makes this function return ECANCELED instead of waiting.
+int waitsend_iqueue1(iqueue1_t* queue, void* msg, const struct timespec* deadline, iqcancel_t* cancel);
+
 // Receives msg from queue. EAGAIN is returned if queue is empty.
 // EPIPE is returned if queue is closed.
 int tryrecv_iqueue1(iqueue1_t* queue, /*out*/void** msg);
@@ -162,13 +573,606 @@ int tryrecv_iqueue1(iqueue1_t* queue, /*out*/void** msg);
 // A waiting writer are woken up.
 int recv_iqueue1(iqueue1_t* queue, /*out*/void** msg);
 
+// Receives msg from queue. Blocks if queue is empty until the absolute deadline of CLOCK_MONOTONIC expires.
+// deadline == 0 waits without time limit. ETIMEDOUT is returned if deadline expired.
+// EINVAL is returned if deadline->tv_nsec is not in range [0, 999999999].
+// EPIPE is returned if queue is closed.
+int timedrecv_iqueue1(iqueue1_t* queue, /*out*/void** msg, const struct timespec* deadline);
+
+// Receives msg from queue. Blocks if queue is empty like timedrecv_iqueue1.
+// If cancel != 0 the waiting thread returns ECANCELED after cancel_iqcancel(cancel) is called.
+// A canceled cancel makes this function return ECANCELED instead of waiting.
+int waitrecv_iqueue1(iqueue1_t* queue, /*out*/void** msg, const struct timespec* deadline, iqcancel_t* cancel);
+
+// Stores up to nrmsg messages from msg[] in queue with plain release stores.
+// nrsent is set to the number of stored messages (msg[0..nrsent-1]). EAGAIN is returned if queue is full.
+// EINVAL is returned if any msg[i] == 0. EPIPE is returned if queue is closed.
+int trysendn_iqueue1(iqueue1_t* queue, void* msg[/*nrmsg*/], size_t nrmsg, /*out*/size_t* nrsent);
+
+// Receives up to nrmsg messages from queue into msg[]. Slots are cleared with plain release stores.
+// nrrecv is set to the number of received messages. EAGAIN is returned if queue is empty.
+// EPIPE is returned if queue is closed.
+int tryrecvn_iqueue1(iqueue1_t* queue, /*out*/void* msg[/*nrmsg*/], size_t nrmsg, /*out*/size_t* nrrecv);
+
+// Moves up to maxn messages from src to dest in their order without an intermediate buffer.
+// The calling thread must be the only reader of src and the only writer of dest.
+// nrmoved is set to the number of moved messages. A waiting reader of dest and a waiting writer of src
+// are woken up. EAGAIN is returned if src is empty or dest is full.
+// EINVAL is returned if dest == src. EPIPE is returned if dest or src is closed.
+int splice_iqueue1(iqueue1_t* dest, iqueue1_t* src, size_t maxn, /*out*/size_t* nrmoved);
+
+// Reopens a closed queue for reuse in constant time. The queue must not be used by other threads.
+// EINVAL is returned if queue is not closed. EBUSY is returned if queue still contains messages.
+int reset_iqueue1(iqueue1_t* queue);
+
+// Returns maximum number of storable messages.
+static inline iqpos_t capacity_iqueue1(const iqueue1_t* queue)
+{
+         return queue->capacity;
+}
+
+iqpos_t size_iqueue1(const iqueue1_t* queue);
+
+// === iqpool_t ===
+
+// Initializes pool which caches up to maxfree queues per capacity.
+// Possible error codes: ENOMEM or error codes of pthread_mutex_init
+int new_iqpool(/*out*/iqpool_t** pool, uint32_t maxfree);
+
+// Deletes all cached queues and frees pool. Queues taken from pool are not affected.
+int delete_iqpool(iqpool_t** pool);
+
+// Returns an open and empty queue with a capacity >= capacity (rounded up to the next power of two).
+// A cached queue is reused if possible else a new one is allocated.
+// Possible error codes: EINVAL (capacity == 0 or too big) or ENOMEM
+int get_iqpool(iqpool_t* pool, /*out*/iqueue1_t** queue, iqpos_t capacity);
+
+// Closes queue and returns it to pool. If it can not be reset (see reset_iqueue1),
+// its capacity is not a power of two or the pool is full it is deleted. queue is set to 0.
+void put_iqpool(iqpool_t* pool, iqueue1_t** queue);
+
+// === iqtriple_t ===
+
+// Initializes triple buffer. All three buffers of size bufsize are set to 0.
+// Possible error codes: EINVAL (bufsize == 0 or too big) or ENOMEM
+int new_iqtriple(/*out*/iqtriple_t** triple, size_t bufsize);
+
+// Frees all resources of triple buffer.
+int delete_iqtriple(iqtriple_t** triple);
+
+// Returns buffer owned by the writer. The writer fills it with the next value
+// and calls publish_iqtriple. The returned buffer changes with every call to publish_iqtriple.
+static inline void* writebuf_iqtriple(iqtriple_t* triple)
+{
+         return triple->buffer[triple->windex];
+}
+
+// Makes the content of writebuf_iqtriple(triple) the latest value.
+// A not yet read value published before is overwritten. Never blocks.
+void publish_iqtriple(iqtriple_t* triple);
+
+// Returns in buf the buffer containing the latest published value.
+// EAGAIN is returned if no value was published since the last call.
+// In this case buf is set to the previously read (or initially zeroed) buffer. Never blocks.
+int read_iqtriple(iqtriple_t* triple, /*out*/const void** buf);
+
+// Returns size of one buffer.
+static inline size_t bufsize_iqtriple(const iqtriple_t* triple)
+{
+         return triple->bufsize;
+}
+
+// === iqconflate_t ===
+
+// Initializes queue which supports keys in range [0, nrkeys-1].
+// Possible error codes: EINVAL (nrkeys == 0 or too big) or ENOMEM
+int new_iqconflate(/*out*/iqconflate_t** queue, uint32_t nrkeys);
+
+// Frees all resources of queue. Close is called automatically.
+// Messages not received are not freed.
+int delete_iqconflate(iqconflate_t** queue);
+
+// Marks queue as closed and wakes up any waiting reader.
+// Blocks until all readers have left queue.
+void close_iqconflate(iqconflate_t* queue);
+
+// Stores msg with key in queue. If a message with the same key is stored
+// but not received yet it is replaced in place and returned in replaced
+// (if replaced != 0) else replaced is set to 0.
+// Never blocks, the queue is never full. Waiting readers are woken up.
+// EINVAL is returned if msg == 0 or key >= nrkeys.
+// EPIPE is returned if queue is closed.
+int send_iqconflate(iqconflate_t* queue, uint32_t key, void* msg, /*out*/void** replaced);
+
+// Receives oldest key and its latest msg from queue. EAGAIN is returned if queue is empty.
+// EPIPE is returned if queue is closed.
+int tryrecv_iqconflate(iqconflate_t* queue, /*out*/uint32_t* key, /*out*/void** msg);
+
+// Receives oldest key and its latest msg from queue. Blocks if queue is empty.
+// EPIPE is returned if queue is closed.
+int recv_iqconflate(iqconflate_t* queue, /*out*/uint32_t* key, /*out*/void** msg);
+
+// Returns number of supported keys which is also the maximum number of storable messages.
+static inline uint32_t capacity_iqconflate(const iqconflate_t* queue)
+{
+         return queue->nrkeys;
+}
+
+// Returns number of stored (unread) messages.
+uint32_t size_iqconflate(const iqconflate_t* queue);
+
+// === iqlossy_t ===
+
+// Initializes queue. The capacity is rounded up to the next power of two.
+// Possible error codes: EINVAL (capacity == 0 or too big) or ENOMEM
+int new_iqlossy(/*out*/iqlossy_t** queue, uint32_t capacity);
+
+// Frees all resources of queue.
+int delete_iqlossy(iqlossy_t** queue);
+
+// Marks queue as closed.
+void close_iqlossy(iqlossy_t* queue);
+
+// Stores msg in queue. Never blocks and never fails if queue is full:
+// the oldest unread message is overwritten and lost for the reader.
+// The writer is not informed about lost messages so use this queue only for
+// messages whose memory is not owned by the reader.
+// EINVAL is returned if msg == 0. EPIPE is returned if queue is closed.
+int send_iqlossy(iqlossy_t* queue, void* msg);
+
+// Receives oldest not overwritten msg from queue. EAGAIN is returned if queue is empty.
+// nrlost is set to the number of messages which were overwritten since the last
+// successful call. Overwritten messages are skipped without waiting for the writer.
+// EPIPE is returned if queue is closed.
+int tryrecv_iqlossy(iqlossy_t* queue, /*out*/void** msg, /*out*/uint64_t* nrlost);
+
 // Returns maximum number of storable messages.
-static inline uint32_t capacity_iqueue1(const iqueue1_t* queue)
+static inline uint32_t capacity_iqlossy(const iqlossy_t* queue)
 {
          return queue->capacity;
 }
 
-uint32_t size_iqueue1(const iqueue1_t* queue);
+// Returns number of stored (unread) messages.
+uint32_t size_iqlossy(const iqlossy_t* queue);
+
+// === iqarena_t ===
+
+// Registers array base of nrelem elements of size elemsize.
+// Possible error codes: EINVAL (base == 0, elemsize == 0, nrelem == 0 or nrelem == UINT32_MAX)
+int init_iqarena(/*out*/iqarena_t* arena, void* base, size_t elemsize, uint32_t nrelem);
+
+// Returns handle of element elem which must be located in arena.
+static inline uint32_t handle_iqarena(const iqarena_t* arena, const void* elem)
+{
+         return (uint32_t) ((size_t)((const uint8_t*)elem - arena->base) / arena->elemsize) + 1;
+}
+
+// Returns pointer to element addressed by handle (handle != 0).
+static inline void* ptr_iqarena(const iqarena_t* arena, uint32_t handle)
+{
+         return arena->base + (size_t)(handle-1) * arena->elemsize;
+}
+
+// === iqueue1h_t ===
+
+// Initializes queue which transfers handles of elements in arena (arena is copied).
+// Every slot needs 4 bytes instead of sizeof(void*).
+// Possible error codes: EINVAL (capacity == 0) or ENOMEM
+int new_iqueue1h(/*out*/iqueue1h_t** queue, uint32_t capacity, const iqarena_t* arena);
+
+// Frees all resources of queue. Close is called automatically.
+int delete_iqueue1h(iqueue1h_t** queue);
+
+// Marks queue as closed and wakes up any waiting reader/writer.
+// Blocks until all read/writer has left queue.
+void close_iqueue1h(iqueue1h_t* queue);
+
+// Stores handle in queue. EAGAIN is returned if queue is full.
+// EINVAL is returned if handle is 0 or not part of arena.
+// EPIPE is returned if queue is closed.
+int trysend_iqueue1h(iqueue1h_t* queue, uint32_t handle);
+
+// Stores handle in queue. Blocks if queue is full.
+// EPIPE is returned if queue is closed.
+// A waiting reader is woken up.
+int send_iqueue1h(iqueue1h_t* queue, uint32_t handle);
+
+// Receives handle from queue. EAGAIN is returned if queue is empty.
+// EPIPE is returned if queue is closed.
+int tryrecv_iqueue1h(iqueue1h_t* queue, /*out*/uint32_t* handle);
+
+// Receives handle from queue. Blocks if queue is empty.
+// EPIPE is returned if queue is closed.
+// A waiting writer is woken up.
+int recv_iqueue1h(iqueue1h_t* queue, /*out*/uint32_t* handle);
+
+// Returns registered arena which translates handles into pointers and vice versa.
+static inline const iqarena_t* arena_iqueue1h(const iqueue1h_t* queue)
+{
+         return &queue->arena;
+}
+
+// Returns maximum number of storable messages.
+static inline uint32_t capacity_iqueue1h(const iqueue1h_t* queue)
+{
+         return queue->capacity;
+}
+
+// Returns number of stored (unread) messages.
+uint32_t size_iqueue1h(const iqueue1h_t* queue);
+
+// === iqueuec_t ===
+
+// Initializes queue. The capacity is not rounded up.
+// Its fixed size is 6*sizeof(uint32_t) + sizeof(iqsignal_t) (2 cache lines on x86_64 Linux).
+// Possible error codes: EINVAL (capacity == 0 or too big) or ENOMEM
+int new_iqueuec(/*out*/iqueuec_t** queue, uint32_t capacity);
+
+// Frees all resources of queue. Close is called automatically.
+int delete_iqueuec(iqueuec_t** queue);
+
+// Marks queue as closed and wakes up any waiting reader/writer.
+// Blocks until all read/writer has left queue.
+void close_iqueuec(iqueuec_t* queue);
+
+// Stores msg in queue. EAGAIN is returned if queue is full.
+// EPIPE is returned if queue is closed.
+int trysend_iqueuec(iqueuec_t* queue, void* msg);
+
+// Stores msg in queue. Blocks if queue is full.
+// EPIPE is returned if queue is closed.
+// Waiting readers are woken up.
+int send_iqueuec(iqueuec_t* queue, void* msg);
+
+// Receives msg from queue. EAGAIN is returned if queue is empty.
+// EPIPE is returned if queue is closed.
+int tryrecv_iqueuec(iqueuec_t* queue, /*out*/void** msg);
+
+// Receives msg from queue. Blocks if queue is empty.
+// EPIPE is returned if queue is closed.
+// Waiting writers are woken up.
+int recv_iqueuec(iqueuec_t* queue, /*out*/void** msg);
+
+// Returns maximum number of storable messages.
+static inline uint32_t capacity_iqueuec(const iqueuec_t* queue)
+{
+         return queue->capacity;
+}
+
+// Returns number of stored (unread) messages.
+uint32_t size_iqueuec(const iqueuec_t* queue);
+
+// === iqmpsc_t ===
+
+// Initializes queue as empty. No resources are allocated so there is no free function.
+void init_iqmpsc(/*out*/iqmpsc_t* queue);
+
+// Appends node to queue. Never fails, never blocks and never allocates memory.
+// A single atomic exchange on tail, the node must not be in use until it is received.
+void send_iqmpsc(iqmpsc_t* queue, iqnode_t* node);
+
+// Removes the oldest node from queue. Must only be called by a single reader thread.
+// EAGAIN is returned if queue is empty or if a writer has not yet linked its node
+// (in this case the node is received with a later call).
+// Uses no atomic read-modify-write except if the last node is removed.
+int tryrecv_iqmpsc(iqmpsc_t* queue, /*out*/iqnode_t** node);
+
+// Returns true if queue contains no node. Must only be called by the reader.
+int isempty_iqmpsc(const iqmpsc_t* queue);
+
+// === iqturn_t ===
+
+// Initializes queue. The capacity is rounded up to the next power of two.
+// Possible error codes: EINVAL (capacity == 0 or too big) or ENOMEM
+int new_iqturn(/*out*/iqturn_t** queue, uint32_t capacity);
+
+// Frees all resources of queue. Close is called automatically.
+int delete_iqturn(iqturn_t** queue);
+
+// Marks queue as closed and wakes up any waiting reader/writer.
+// Blocks until all blocking readers and writers have returned from send_iqturn / recv_iqturn.
+void close_iqturn(iqturn_t* queue);
+
+// Stores msg in queue. EAGAIN is returned if queue is full.
+// EPIPE is returned if queue is closed.
+int trysend_iqturn(iqturn_t* queue, void* msg);
+
+// Claims the next write position and stores msg into its slot.
+// Blocks on the futex of the slot until it is free. Only the threads waiting on this slot are woken up.
+// EPIPE is returned if queue is closed.
+int send_iqturn(iqturn_t* queue, void* msg);
+
+// Receives msg from queue. EAGAIN is returned if queue is empty
+// or if the next message is claimed by a waiting reader.
+// EPIPE is returned if queue is closed.
+int tryrecv_iqturn(iqturn_t* queue, /*out*/void** msg);
+
+// Claims the next read position and receives msg from its slot.
+// Blocks on the futex of the slot until the writer of this position has filled it.
+// EPIPE is returned if queue is closed.
+int recv_iqturn(iqturn_t* queue, /*out*/void** msg);
+
+// Returns maximum number of storable messages.
+static inline uint32_t capacity_iqturn(const iqturn_t* queue)
+{
+         return queue->capacity;
+}
+
+// Returns number of stored messages which are not claimed by a reader.
+uint32_t size_iqturn(const iqturn_t* queue);
+
+// === iqnuma_t ===
+
+// Initializes queue with one iqueue_t of the given capacity per NUMA node.
+// nrnode == 0 reads the number of nodes from /sys/devices/system/node/possible (1 if not available).
+// Possible error codes: EINVAL (capacity too big or nrnode > 1024) or ENOMEM
+int new_iqnuma(/*out*/iqnuma_t** queue, uint32_t nrnode, iqpos_t capacity);
+
+// Frees all resources of queue. Close is called automatically.
+int delete_iqnuma(iqnuma_t** queue);
+
+// Marks queue and all sub-queues as closed and wakes up any waiting reader/writer.
+void close_iqnuma(iqnuma_t* queue);
+
+// Returns the index of the sub-queue of the NUMA node the calling thread runs on.
+uint32_t node_iqnuma(const iqnuma_t* queue);
+
+// Stores msg in the sub-queue of the local node.
+// Only if it is full msg is stored in the sub-queue of another node.
+// EAGAIN is returned if all sub-queues are full. EPIPE is returned if queue is closed.
+int trysend_iqnuma(iqnuma_t* queue, void* msg);
+
+// Same as trysend_iqnuma except that it waits until space is available.
+int send_iqnuma(iqnuma_t* queue, void* msg);
+
+// Receives msg from the sub-queue of the local node.
+// Only if it is empty msg is stolen from the sub-queue of another node.
+// EAGAIN is returned if all sub-queues are empty. EPIPE is returned if queue is closed.
+int tryrecv_iqnuma(iqnuma_t* queue, /*out*/void** msg);
+
+// Same as tryrecv_iqnuma except that it waits until a message is available.
+int recv_iqnuma(iqnuma_t* queue, /*out*/void** msg);
+
+// Returns maximum number of storable messages of all sub-queues.
+static inline iqpos_t capacity_iqnuma(const iqnuma_t* queue)
+{
+         return queue->nrnode * capacity_iqueue(queue->node[0]);
+}
+
+// Returns number of stored messages of all sub-queues.
+iqpos_t size_iqnuma(const iqnuma_t* queue);
+
+// === iqscq_t ===
+
+// Initializes queue. The capacity is rounded up to the next power of two.
+// Possible error codes: EINVAL (capacity == 0 or > 2^30) or ENOMEM
+int new_iqscq(/*out*/iqscq_t** queue, uint32_t capacity);
+
+// Frees all resources of queue. Close is called automatically.
+int delete_iqscq(iqscq_t** queue);
+
+// Marks queue as closed and wakes up any waiting reader/writer.
+void close_iqscq(iqscq_t* queue);
+
+// Stores msg in queue. EAGAIN is returned if queue is full.
+// EPIPE is returned if queue is closed.
+int trysend_iqscq(iqscq_t* queue, void* msg);
+
+// Same as trysend_iqscq except that it waits until space is available.
+int send_iqscq(iqscq_t* queue, void* msg);
+
+// Receives msg from queue. EAGAIN is returned if queue is empty.
+// EPIPE is returned if queue is closed.
+int tryrecv_iqscq(iqscq_t* queue, /*out*/void** msg);
+
+// Same as tryrecv_iqscq except that it waits until a message is available.
+int recv_iqscq(iqscq_t* queue, /*out*/void** msg);
+
+// Returns maximum number of storable messages.
+static inline uint32_t capacity_iqscq(const iqscq_t* queue)
+{
+         return queue->capacity;
+}
+
+// Returns number of stored messages.
+uint32_t size_iqscq(const iqscq_t* queue);
+
+// === iqwf_t ===
+
+// Initializes queue for nrthread threads with ids 0..nrthread-1. The capacity is rounded up to the next power of two.
+// Every operation copies the stored messages, therefore the queue is meant for small capacities.
+// Possible error codes: EINVAL (capacity == 0 or > 65536, nrthread == 0 or > 64) or ENOMEM
+int new_iqwf(/*out*/iqwf_t** queue, uint32_t capacity, uint32_t nrthread);
+
+// Frees all resources of queue. No other thread must use the queue.
+int delete_iqwf(iqwf_t** queue);
+
+// Marks queue as closed.
+void close_iqwf(iqwf_t* queue);
+
+// Stores msg in queue. tid is the id of the calling thread, no two threads must use the same id.
+// Returns in a bounded number of steps. EAGAIN is returned if queue is full.
+// EPIPE is returned if queue is closed. EINVAL is returned if msg == 0 or tid >= nrthread.
+int trysend_iqwf(iqwf_t* queue, uint32_t tid, void* msg);
+
+// Receives msg from queue. tid is the id of the calling thread, no two threads must use the same id.
+// Returns in a bounded number of steps. EAGAIN is returned if queue is empty.
+// EPIPE is returned if queue is closed. EINVAL is returned if tid >= nrthread.
+int tryrecv_iqwf(iqwf_t* queue, uint32_t tid, /*out*/void** msg);
+
+// Returns maximum number of storable messages.
+static inline uint32_t capacity_iqwf(const iqwf_t* queue)
+{
+         return queue->capacity;
+}
+
+// Returns number of stored messages.
+uint32_t size_iqwf(const iqwf_t* queue);
+
+// === iqfc_t ===
+
+// Initializes queue for nrthread threads with ids 0..nrthread-1. The capacity is rounded up to the next power of two.
+// Possible error codes: EINVAL (capacity == 0 or > 2^30, nrthread == 0 or > 1024) or ENOMEM
+int new_iqfc(/*out*/iqfc_t** queue, uint32_t capacity, uint32_t nrthread);
+
+// Frees all resources of queue. No other thread must use the queue.
+int delete_iqfc(iqfc_t** queue);
+
+// Marks queue as closed.
+void close_iqfc(iqfc_t* queue);
+
+// Stores msg in queue. tid is the id of the calling thread, no two threads must use the same id.
+// EAGAIN is returned if queue is full. EPIPE is returned if queue is closed.
+// EINVAL is returned if msg == 0 or tid >= nrthread.
+int trysend_iqfc(iqfc_t* queue, uint32_t tid, void* msg);
+
+// Receives msg from queue. tid is the id of the calling thread, no two threads must use the same id.
+// EAGAIN is returned if queue is empty. EPIPE is returned if queue is closed.
+// EINVAL is returned if tid >= nrthread.
+int tryrecv_iqfc(iqfc_t* queue, uint32_t tid, /*out*/void** msg);
+
+// Returns maximum number of storable messages.
+static inline uint32_t capacity_iqfc(const iqfc_t* queue)
+{
+         return queue->capacity;
+}
+
+// Returns number of stored messages.
+uint32_t size_iqfc(const iqfc_t* queue);
+
+// === iqbuffer_t ===
+
+// Initializes buffer which sends up to capacity messages at once to queue.
+// maxlatency_usec is only checked by send_iqbuffer when the next message is appended, there is no timer.
+// The bound is not met if the producer stops sending unless it calls flush_iqbuffer itself.
+// Possible error codes: EINVAL (capacity == 0) or ENOMEM
+int new_iqbuffer(/*out*/iqbuffer_t** buffer, iqueue_t* queue, uint32_t capacity, uint32_t maxlatency_usec);
+
+// Flushes buffered messages and frees buffer. The queue is not freed.
+// Returns the error of flush_iqbuffer, messages which could not be sent are lost.
+int delete_iqbuffer(iqbuffer_t** buffer);
+
+// Appends msg to buffer. The buffer is flushed if it is full or if the oldest message
+// is buffered longer than maxlatency_usec (including msg). Returns the error of flush_iqbuffer.
+// EINVAL is returned if msg == 0.
+int send_iqbuffer(iqbuffer_t* buffer, void* msg);
+
+// Sends all buffered messages to queue with trysendn_iqueue and wakes up waiting readers.
+// Blocks if queue is full. EPIPE is returned if queue is closed, unsent messages stay buffered.
+// A producer must call it before it becomes idle, otherwise buffered messages wait for the next send.
+int flush_iqbuffer(iqbuffer_t* buffer);
+
+// Returns nr of buffered messages.
+static inline uint32_t size_iqbuffer(const iqbuffer_t* buffer)
+{
+         return buffer->size;
+}
+
+// === iqline_t ===
+
+// Initializes queue. The capacity is rounded up to the next power of two and at least IQLINE_NRSLOT.
+// Possible error codes: EINVAL (capacity == 0 or > 2^30) or ENOMEM
+int new_iqline(/*out*/iqline_t** queue, uint32_t capacity);
+
+// Frees all resources of queue. Close is called automatically.
+int delete_iqline(iqline_t** queue);
+
+// Marks queue as closed and wakes up all waiting threads.
+void close_iqline(iqline_t* queue);
+
+// Stores msg in queue. It is published to the reader if its cache line of slots is full.
+// If the queue is full all stored messages are published and EAGAIN is returned.
+// EINVAL is returned if msg == 0. EPIPE is returned if queue is closed.
+int trysend_iqline(iqline_t* queue, void* msg);
+
+// Stores msg in queue like trysend_iqline and wakes up a waiting reader if a line is published.
+// Blocks if queue is full. EPIPE is returned if queue is closed.
+int send_iqline(iqline_t* queue, void* msg);
+
+// Publishes all stored messages and wakes up a waiting reader.
+// An idle writer must call it to bound the latency of messages of a partially filled line.
+void flush_iqline(iqline_t* queue);
+
+// Receives a published msg from queue. EAGAIN is returned if no msg is published.
+// EPIPE is returned if queue is closed.
+int tryrecv_iqline(iqline_t* queue, /*out*/void** msg);
+
+// Receives a published msg from queue. Blocks until a msg is published.
+// EPIPE is returned if queue is closed.
+int recv_iqline(iqline_t* queue, /*out*/void** msg);
+
+// Receives up to nrmsg published messages from queue into msg[].
+// nrrecv is set to the number of received messages. EAGAIN is returned if no msg is published.
+// EPIPE is returned if queue is closed.
+int tryrecvn_iqline(iqline_t* queue, /*out*/void* msg[/*nrmsg*/], size_t nrmsg, /*out*/size_t* nrrecv);
+
+// Returns maximum number of storable messages.
+static inline uint32_t capacity_iqline(const iqline_t* queue)
+{
+         return queue->capacity;
+}
+
+// Returns number of published messages.
+uint32_t size_iqline(const iqline_t* queue);
+
+// === iqcapture ===
+
+// Starts recording send/recv events of all iqueue_t and iqueue1_t into an in-memory buffer
+// of maxevent events which is written to file filename by stop_iqcapture.
+// Capturing is only supported if the library is compiled with IQUEUE_CAPTURE defined.
+// Possible error codes: ENOSYS (not compiled with IQUEUE_CAPTURE), EALREADY (already started),
+// EINVAL (maxevent == 0 or >= 2^32), ENOMEM or the error of fopen.
+int start_iqcapture(const char* filename, size_t maxevent);
+
+// Stops recording, waits for threads which store an event and writes the trace file.
+// Possible error codes: ENOSYS, EINVAL (not started) or the error of fwrite / fclose.
+int stop_iqcapture(void);
+
+// === iqregistry ===
+
+// Formats of print_iqregistry and write_iqregistry.
+enum { IQREGISTRY_PROMETHEUS = 1, IQREGISTRY_JSON = 2 };
+
+// Nr of buckets of the wait latency histogram of a registered queue.
+// Bucket i counts waits shorter than 2^i microseconds, the last bucket all longer ones.
+#define IQREGISTRY_NRBUCKET 24
+
+// Adds queue under name (1..255 characters) to the process wide registry.
+// Blocking sends and receives of a registered queue record their waiting time, the non blocking ones are unchanged.
+// The queue is removed from the registry when it is freed. Possible error codes:
+// EINVAL (name empty or too long), EEXIST (queue already registered) or ENOMEM
+int register_iqueue(iqueue_t* queue, const char* name);
+
+// Adds queue under name to the registry like register_iqueue.
+int register_iqueue1(iqueue1_t* queue, const char* name);
+
+// Prints depth, capacity, number of sent and received messages (derived from positions and only supported by iqueue_t),
+// number of waiting readers and writers and the wait latency histogram of all registered queues in format
+// IQREGISTRY_PROMETHEUS (text exposition format) or IQREGISTRY_JSON into buf which is always 0 terminated if size > 0.
+// len is set to the length of the whole output without the terminating 0.
+// EINVAL is returned if format is unknown. ENOBUFS is returned if the output is truncated (len >= size).
+int print_iqregistry(char* buf, size_t size, int format, /*out*/size_t* len);
+
+// Writes the output of print_iqregistry to file descriptor fd.
+// Possible error codes: EINVAL (unknown format), ENOMEM or the error of write.
+int write_iqregistry(int fd, int format);
+
+// === iqprofile ===
+
+// Resets the contention profile of iqueue_t. The profile is only recorded if the library is compiled
+// with IQUEUE_PROFILE defined, else ENOSYS is returned by all iqprofile functions.
+int reset_iqprofile(void);
+
+// Prints a report of the contended locations of all iqueue_t ranked by their number of events into buf
+// (always 0 terminated if size > 0). Counted events are failed CAS of ifree / iused, failed reservations
+// of sizefree[i] / sizeused[i], spins on the slots of a cache line of msg and fetch-and-add of writepos / readpos
+// which took more than IQUEUE_PROFILE_SLOWCYCLES cycles (x86_64 only). len is set to the length of the whole report.
+// ENOBUFS is returned if the report is truncated (len >= size).
+int print_iqprofile(char* buf, size_t size, /*out*/size_t* len);
+
+// Writes the report of print_iqprofile to file descriptor fd.
+// Possible error codes: ENOSYS, ENOMEM or the error of write.
+int write_iqprofile(int fd);
 
 // === support for statically typed queues ===
 
@@ -179,7 +1183,7 @@ uint32_t size_iqueue1(const iqueue1_t* queue);
          typedef struct affix ##_t { \
             iqueue_t* queue;          \
          } affix ##_t;               \
-         static inline int init_##affix(affix##_t* queue, uint32_t capacity) \
+         static inline int init_##affix(affix##_t* queue, iqpos_t capacity) \
          { \
             return new_iqueue(&queue->queue, capacity); \
          } \
@@ -214,6 +1218,115 @@ uint32_t size_iqueue1(const iqueue1_t* queue);
             return err; \
          }
 
+/* Declares/implements queue type affix##_t which embeds an iqueue_t together
+ * with storage for capacity messages (capacity must be a power of two).
+ * Instances could be global, static or on the stack, no heap memory is allocated.
+ * The type is aligned to SIZE_CACHELINE so that the padding of iqueue_t lines up with cache lines.
+ * Use a capacity of at least 256 (the nr of sizeused / sizefree counters): a smaller capacity
+ * leaves most counters at 0 and a send or receive scans up to 256 of them before it finds
+ * a slot or returns EAGAIN. new_iqueue rounds up to 256 for the same reason.
+ * Use init_##affix / free_##affix to initialize/free queue. */
+#define iqueue_STATIC(affix, msg_t, capacity) \
+         __extension__ typedef struct __attribute__((aligned(SIZE_CACHELINE))) affix ##_t { \
+            iqueue_t queue;             \
+            void*    storage[capacity]; \
+         } affix ##_t;                 \
+         static inline int init_##affix(affix##_t* queue) \
+         { \
+            return init_iqueue(&queue->queue, (capacity)); \
+         } \
+         static inline int free_##affix(affix##_t* queue) \
+         { \
+            return free_iqueue(&queue->queue); \
+         } \
+         static inline void close_##affix(affix##_t* queue) \
+         { \
+            close_iqueue(&queue->queue); \
+         } \
+         static inline int trysend_##affix(affix##_t* queue, msg_t* msg) \
+         { \
+            return trysend_iqueue(&queue->queue, msg); \
+         } \
+         static inline int send_##affix(affix##_t* queue, msg_t* msg) \
+         { \
+            return send_iqueue(&queue->queue, msg); \
+         } \
+         static inline int tryrecv_##affix(affix##_t* queue, msg_t** msg) \
+         { \
+            void* tmp; \
+            int err = tryrecv_iqueue(&queue->queue, &tmp); \
+            *msg = tmp; \
+            return err; \
+         } \
+         static inline int recv_##affix(affix##_t* queue, msg_t** msg) \
+         { \
+            void* tmp; \
+            int err = recv_iqueue(&queue->queue, &tmp); \
+            *msg = tmp; \
+            return err; \
+         }
+
+/* Declares/implements queue type affix##_t which embeds an iqueue1_t together
+ * with storage for capacity messages. No heap memory is allocated.
+ * trysend_##affix and tryrecv_##affix are inlined with capacity as constant.
+ * They use the same protocol as trysend_iqueue1 / tryrecv_iqueue1 so they could be
+ * mixed with all other iqueue1_t functions called with &queue->queue.
+ * The type is aligned to SIZE_CACHELINE so that the padding of iqueue1_t lines up with cache lines.
+ * Use init_##affix / free_##affix to initialize/free queue. */
+#define iqueue1_STATIC(affix, msg_t, capacity) \
+         __extension__ typedef struct __attribute__((aligned(SIZE_CACHELINE))) affix ##_t { \
+            iqueue1_t queue;            \
+            void*     storage[capacity]; \
+         } affix ##_t;                 \
+         static inline int init_##affix(affix##_t* queue) \
+         { \
+            return init_iqueue1(&queue->queue, (capacity)); \
+         } \
+         static inline int free_##affix(affix##_t* queue) \
+         { \
+            return free_iqueue1(&queue->queue); \
+         } \
+         static inline void close_##affix(affix##_t* queue) \
+         { \
+            close_iqueue1(&queue->queue); \
+         } \
+         static inline int trysend_##affix(affix##_t* queue, msg_t* msg) \
+         { \
+            if (0 == msg) return EINVAL; \
+            if (queue->queue.closed) return EPIPE; \
+            iqpos_t pos = queue->queue.writepos; \
+            queue->queue.writepos = (pos + 1) % (iqpos_t) (capacity); \
+            if (0 != cmpxchg_atomicptr(&queue->queue.msg[pos], 0, msg)) { \
+               queue->queue.writepos = pos; \
+               return EAGAIN; \
+            } \
+            return 0; \
+         } \
+         static inline int send_##affix(affix##_t* queue, msg_t* msg) \
+         { \
+            return send_iqueue1(&queue->queue, msg); \
+         } \
+         static inline int tryrecv_##affix(affix##_t* queue, msg_t** msg) \
+         { \
+            if (queue->queue.closed) return EPIPE; \
+            iqpos_t pos = queue->queue.readpos; \
+            queue->queue.readpos = (pos + 1) % (iqpos_t) (capacity); \
+            void* fetchedmsg = queue->queue.msg[pos]; \
+            if (fetchedmsg != cmpxchg_atomicptr(&queue->queue.msg[pos], fetchedmsg, 0) || 0 == fetchedmsg) { \
+               queue->queue.readpos = pos; \
+               return EAGAIN; \
+            } \
+            *msg = fetchedmsg; \
+            return 0; \
+         } \
+         static inline int recv_##affix(affix##_t* queue, msg_t** msg) \
+         { \
+            void* tmp; \
+            int err = recv_iqueue1(&queue->queue, &tmp); \
+            *msg = tmp; \
+            return err; \
+         }
+
 #undef PAD
 
 #endif
@@ -11,8 +11,23 @@
 #define _GNU_SOURCE
 #include "iqueue.h"
 #include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(IQUEUE_NOSIMD)
+#define IQUEUE_SIMD_X86
+#include <immintrin.h>
+#endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 // === iqsignal_t ===
 
@@ -38,12 +53,42 @@ static int init_mutex(/*out*/pthread_mutex_t* mutex)
 static int init_cond(/*out*/pthread_cond_t* cond)
 {
    int err;
+   pthread_condattr_t attr;
 
-   err = pthread_cond_init(cond, 0);
+   err = pthread_condattr_init(&attr);
+   if (err) return err;
+
+   // timed waits use deadlines of CLOCK_MONOTONIC which is not changed by setting the system time
+   err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+   if (! err) {
+      err = pthread_cond_init(cond, &attr);
+   }
 
+   (void) pthread_condattr_destroy(&attr);
    return err;
 }
 
+// Sets deadline to the time of CLOCK_MONOTONIC plus usec microseconds.
+static void deadline_usec(/*out*/struct timespec* deadline, uint32_t usec)
+{
+   clock_gettime(CLOCK_MONOTONIC, deadline);
+   deadline->tv_sec  += (time_t) (usec / 1000000);
+   deadline->tv_nsec += (long) (usec % 1000000) * 1000;
+   if (deadline->tv_nsec >= 1000000000) {
+      deadline->tv_nsec -= 1000000000;
+      ++ deadline->tv_sec;
+   }
+}
+
+// Returns time of CLOCK_MONOTONIC in microseconds.
+static uint64_t now_usec(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+}
+
 int init_iqsignal(/*out*/iqsignal_t* signal)
 {
    int err;
@@ -96,9 +141,9 @@ void signal_iqsignal(iqsignal_t* signal)
    pthread_mutex_unlock(&signal->lock);
 }
 
-uint32_t clearsignal_iqsignal(iqsignal_t* signal)
+size_t clearsignal_iqsignal(iqsignal_t* signal)
 {
-   uint32_t oldval;
+   size_t oldval;
 
    pthread_mutex_lock(&signal->lock);
    oldval = signal->signalcount;
@@ -119,17 +164,753 @@ size_t signalcount_iqsignal(iqsignal_t* signal)
    return signalcount;
 }
 
+// === iqcancel_t ===
+
+void init_iqcancel(/*out*/iqcancel_t* cancel)
+{
+   cancel->canceled = 0;
+   cancel->signal = 0;
+}
+
+void cancel_iqcancel(iqcancel_t* cancel)
+{
+   // full barrier: either the waiter sees canceled or cancel sees the signal the waiter sleeps on
+   xchg_atomicu32(&cancel->canceled, 1);
+
+   iqsignal_t* signal = (iqsignal_t*) load_atomicptr((void**)&cancel->signal);
+   if (signal) {
+      pthread_mutex_lock(&signal->lock);
+      pthread_cond_broadcast(&signal->cond);
+      pthread_mutex_unlock(&signal->lock);
+   }
+}
+
+// Sets closed to 1 and wakes up any reader/writer waiting on reader or writer.
+// Blocks until all waiting reader/writer have left.
+static void close_waiting(uint32_t* closed, iqsignal_t* reader, iqsignal_t* writer)
+{
+   pthread_mutex_lock(&reader->lock);
+   pthread_mutex_lock(&writer->lock);
+   *closed = 1;
+   pthread_mutex_unlock(&writer->lock);
+   pthread_mutex_unlock(&reader->lock);
+
+   // Wait until reader/writer woken up
+   for (;;) {
+      pthread_mutex_lock(&reader->lock);
+      pthread_cond_broadcast(&reader->cond);
+      size_t isreader = reader->waitcount;
+      pthread_mutex_unlock(&reader->lock);
+
+      pthread_mutex_lock(&writer->lock);
+      pthread_cond_broadcast(&writer->cond);
+      size_t iswriter = writer->waitcount;
+      pthread_mutex_unlock(&writer->lock);
+
+      if (!isreader && !iswriter) break;
+
+      sched_yield();
+   }
+}
+
+// Returns true if headsize + nrelem * elemsize bytes do not fit into size_t.
+// nrelem is 64 bit so that uint32_t capacities are checked without a type-limits warning.
+static inline int istoolarge(size_t headsize, uint64_t nrelem, size_t elemsize)
+{
+   return nrelem >= ((size_t)-1 - headsize) / elemsize;
+}
+
+// Allocates size bytes starting at a cache line boundary (released with free).
+// Only then the padding of the queue types separates their fields into different cache lines.
+static void* malloc_aligned(size_t size)
+{
+#ifdef SIZE_CACHELINE
+   void* addr;
+   if (posix_memalign(&addr, SIZE_CACHELINE, size)) {
+      return 0;
+   }
+   return addr;
+#else
+   return malloc(size);
+#endif
+}
+
+// === iqcapture ===
+
+#ifdef IQUEUE_CAPTURE
+
+// max nr of queues with an id, further queues get id 0
+#define CAPTURE_NRQUEUE 4096
+
+static struct {
+   uint32_t isactive;
+   uint32_t nrwriter;   // nr of threads which are storing an event
+   uint32_t generation; // incremented by every start, invalidates thread ids of the last capture
+   uint32_t nrthread;
+   uint64_t nrevent;    // could exceed maxevent, the surplus is lost
+   uint64_t maxevent;
+   uint64_t starttime_nsec;
+   FILE*    file;
+   iqcaptureevent_t* event;
+   void*    queue[CAPTURE_NRQUEUE]; // id of queue[i] is i+1
+} s_capture;
+
+static __thread struct {
+   uint32_t generation;
+   uint16_t id;
+} s_capturethread;
+
+static uint64_t now_capture(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Returns id of queue. The first call for a queue inserts it into a hash table with linear probing.
+static uint16_t queueid_capture(const void* queue)
+{
+   uint32_t h = (uint32_t) (((uintptr_t)queue >> 6) * 2654435761u) % CAPTURE_NRQUEUE;
+
+   for (uint32_t i = 0; i < CAPTURE_NRQUEUE; ++i, h = (h+1) % CAPTURE_NRQUEUE) {
+      void* entry = load_atomicptr(&s_capture.queue[h]);
+      if (0 == entry) {
+         entry = cmpxchg_atomicptr(&s_capture.queue[h], 0, (void*)(uintptr_t)queue);
+         if (0 == entry) return (uint16_t) (h+1);
+      }
+      if (entry == queue) return (uint16_t) (h+1);
+   }
+
+   return 0;
+}
+
+static void event_capture(const void* queue, uint8_t queuetype, uint8_t type, size_t nrmsg)
+{
+   if (! load_atomicu32(&s_capture.isactive)) return;
+
+   fetchadd_atomicu32(&s_capture.nrwriter, 1);
+   // stop_iqcapture clears isactive before it waits for nrwriter == 0
+   if (load_atomicu32(&s_capture.isactive)) {
+      uint64_t i = fetchadd_atomicu64(&s_capture.nrevent, 1);
+      if (i < s_capture.maxevent) {
+         if (s_capturethread.generation != s_capture.generation) {
+            s_capturethread.generation = s_capture.generation;
+            s_capturethread.id = (uint16_t) (fetchadd_atomicu32(&s_capture.nrthread, 1) + 1);
+         }
+         iqcaptureevent_t* event = &s_capture.event[i];
+         event->time_nsec = now_capture() - s_capture.starttime_nsec;
+         event->queueid   = queueid_capture(queue);
+         event->threadid  = s_capturethread.id;
+         event->nrmsg     = (uint16_t) (nrmsg < 65535 ? nrmsg : 65535);
+         event->type      = type;
+         event->queuetype = queuetype;
+      }
+   }
+   fetchadd_atomicu32(&s_capture.nrwriter, (uint32_t)-1);
+}
+
+#define CAPTURE(queuetype, type, nrmsg) \
+   event_capture(queue, IQCAPTURE_##queuetype, IQCAPTURE_##type, (nrmsg))
+
+static int compare_capture(const void* left, const void* right)
+{
+   const iqcaptureevent_t* l = left;
+   const iqcaptureevent_t* r = right;
+   if (l->time_nsec != r->time_nsec) return l->time_nsec < r->time_nsec ? -1 : 1;
+   return (int)l->threadid - (int)r->threadid;
+}
+
+int start_iqcapture(const char* filename, size_t maxevent)
+{
+   if (s_capture.file) {
+      return EALREADY;
+   }
+
+   if (maxevent == 0 || maxevent > UINT32_MAX - 1) {
+      return EINVAL;
+   }
+
+   iqcaptureevent_t* event = malloc(maxevent * sizeof(iqcaptureevent_t));
+   if (!event) {
+      return ENOMEM;
+   }
+
+   FILE* file = fopen(filename, "wb");
+   if (!file) {
+      int err = errno;
+      free(event);
+      return err;
+   }
+
+   s_capture.file = file;
+   s_capture.event = event;
+   s_capture.maxevent = maxevent;
+   s_capture.nrevent = 0;
+   s_capture.nrthread = 0;
+   ++ s_capture.generation;
+   memset(s_capture.queue, 0, sizeof(s_capture.queue));
+   s_capture.starttime_nsec = now_capture();
+   // all stores are visible before the first event is captured
+   store_atomicu32(&s_capture.isactive, 1);
+
+   return 0;
+}
+
+int stop_iqcapture(void)
+{
+   if (! s_capture.file) {
+      return EINVAL;
+   }
+
+   // full barrier: either a writer sees isactive == 0 or stop sees its increment of nrwriter
+   xchg_atomicu32(&s_capture.isactive, 0);
+   while (load_atomicu32(&s_capture.nrwriter)) sched_yield();
+
+   iqcaptureheader_t header = { "iqcapt1", 0, 0 };
+   if (s_capture.nrevent > s_capture.maxevent) {
+      header.nrevent = (uint32_t) s_capture.maxevent;
+      header.nrlost = (uint32_t) (s_capture.nrevent - s_capture.maxevent < UINT32_MAX ? s_capture.nrevent - s_capture.maxevent : UINT32_MAX);
+   } else {
+      header.nrevent = (uint32_t) s_capture.nrevent;
+   }
+
+   // events of different threads are stored in the order of their reservation
+   qsort(s_capture.event, header.nrevent, sizeof(iqcaptureevent_t), &compare_capture);
+
+   int err = 0;
+   if (1 != fwrite(&header, sizeof(header), 1, s_capture.file)
+       || header.nrevent != fwrite(s_capture.event, sizeof(iqcaptureevent_t), header.nrevent, s_capture.file)) {
+      err = errno ? errno : EIO;
+   }
+   if (fclose(s_capture.file) && !err) {
+      err = errno;
+   }
+
+   free(s_capture.event);
+   s_capture.event = 0;
+   s_capture.file = 0;
+
+   return err;
+}
+
+#else
+
+#define CAPTURE(queuetype, type, nrmsg)
+
+int start_iqcapture(const char* filename, size_t maxevent)
+{
+   (void) filename;
+   (void) maxevent;
+   return ENOSYS;
+}
+
+int stop_iqcapture(void)
+{
+   return ENOSYS;
+}
+
+#endif
+
+// === iqregistry ===
+
+struct iqregentry_t {
+   struct iqregentry_t* next;
+   void*    queue;
+   int      isqueue1;
+   uint64_t waitsum_usec;
+   uint64_t waitcount[IQREGISTRY_NRBUCKET];
+   char     name[/*strlen(name)+1*/];
+};
+
+// list of registered queues in order of registration
+static pthread_mutex_t       s_registrylock = PTHREAD_MUTEX_INITIALIZER;
+static struct iqregentry_t*  s_registry;
+static struct iqregentry_t** s_registrylast = &s_registry;
+
+static int register_iqregistry(struct iqregentry_t** regentry, void* queue, int isqueue1, const char* name)
+{
+   size_t namelen = strlen(name);
+
+   if (namelen == 0 || namelen > 255) {
+      return EINVAL;
+   }
+
+   struct iqregentry_t* entry = malloc(sizeof(struct iqregentry_t) + namelen + 1);
+   if (!entry) {
+      return ENOMEM;
+   }
+
+   memset(entry, 0, sizeof(struct iqregentry_t));
+   entry->queue = queue;
+   entry->isqueue1 = isqueue1;
+   memcpy(entry->name, name, namelen + 1);
+
+   pthread_mutex_lock(&s_registrylock);
+   int isregistered = (0 != *regentry);
+   if (! isregistered) {
+      *s_registrylast = entry;
+      s_registrylast = &entry->next;
+      *regentry = entry;
+   }
+   pthread_mutex_unlock(&s_registrylock);
+
+   if (isregistered) {
+      free(entry);
+      return EEXIST;
+   }
+
+   return 0;
+}
+
+// Removes entry from the registry and frees it. Called after all waiting threads left the queue.
+static void unregister_iqregistry(struct iqregentry_t** regentry)
+{
+   struct iqregentry_t* entry = *regentry;
+
+   if (!entry) return;
+
+   pthread_mutex_lock(&s_registrylock);
+   struct iqregentry_t** prev = &s_registry;
+   while (*prev != entry) prev = &(*prev)->next;
+   *prev = entry->next;
+   if (s_registrylast == &entry->next) s_registrylast = prev;
+   *regentry = 0;
+   pthread_mutex_unlock(&s_registrylock);
+
+   free(entry);
+}
+
+// Adds a wait of usec microseconds to the histogram of entry. Only called on blocking paths.
+static void waited_iqregistry(struct iqregentry_t* entry, uint64_t usec)
+{
+   unsigned i = 0;
+   while (i < IQREGISTRY_NRBUCKET-1 && usec >= ((uint64_t)1 << i)) ++i;
+   fetchadd_atomicu64(&entry->waitcount[i], 1);
+   fetchadd_atomicu64(&entry->waitsum_usec, usec);
+}
+
+// Values of a registered queue which are exported.
+typedef struct iqregstats_t {
+   uint64_t depth;
+   uint64_t capacity;
+   uint64_t sent;     // only valid if !isqueue1
+   uint64_t received; // only valid if !isqueue1
+   uint64_t nrreader;
+   uint64_t nrwriter;
+} iqregstats_t;
+
+static void stats_iqregistry(const struct iqregentry_t* entry, /*out*/iqregstats_t* stats)
+{
+   iqsignal_t* reader;
+   iqsignal_t* writer;
+
+   if (entry->isqueue1) {
+      iqueue1_t* queue = entry->queue;
+      stats->depth = size_iqueue1(queue);
+      stats->capacity = queue->capacity;
+      stats->sent = 0;
+      stats->received = 0;
+      reader = &queue->reader;
+      writer = &queue->writer;
+   } else {
+      iqueue_t* queue = entry->queue;
+      stats->depth = size_iqueue(queue);
+      stats->capacity = queue->capacity;
+      // positions are free running counters
+      stats->sent = cmpxchg_atomicpos(&queue->writepos, 0, 0);
+      stats->received = cmpxchg_atomicpos(&queue->readpos, 0, 0);
+      reader = &queue->reader;
+      writer = &queue->writer;
+   }
+
+   stats->nrreader = cmpxchg_atomicsize(&reader->waitcount, 0, 0);
+   stats->nrwriter = cmpxchg_atomicsize(&writer->waitcount, 0, 0);
+}
+
+// Output buffer of print_iqregistry. len counts also the truncated part.
+typedef struct iqregprinter_t {
+   char*  buf;
+   size_t size;
+   size_t len;
+} iqregprinter_t;
+
+__attribute__((format(printf, 2, 3)))
+static void printf_iqregistry(iqregprinter_t* printer, const char* format, ...)
+{
+   va_list args;
+   va_start(args, format);
+   size_t avail = printer->len < printer->size ? printer->size - printer->len : 0;
+   int len = vsnprintf(avail ? printer->buf + printer->len : 0, avail, format, args);
+   va_end(args);
+   if (len > 0) printer->len += (size_t) len;
+}
+
+// Prints name quoted and escaped (valid as JSON string and as Prometheus label value).
+static void printname_iqregistry(iqregprinter_t* printer, const char* name, int isjson)
+{
+   printf_iqregistry(printer, "\"");
+   for (const char* c = name; *c; ++c) {
+      if (*c == '"' || *c == '\\') {
+         printf_iqregistry(printer, "\\%c", *c);
+      } else if (*c == '\n') {
+         printf_iqregistry(printer, "\\n");
+      } else if (isjson && (unsigned char)*c < 0x20) {
+         printf_iqregistry(printer, "\\u%04x", (unsigned)*c);
+      } else {
+         printf_iqregistry(printer, "%c", *c);
+      }
+   }
+   printf_iqregistry(printer, "\"");
+}
+
+static void printlabels_iqregistry(iqregprinter_t* printer, const struct iqregentry_t* entry)
+{
+   printf_iqregistry(printer, "{queue=");
+   printname_iqregistry(printer, entry->name, 0);
+   printf_iqregistry(printer, ",type=\"%s\"", entry->isqueue1 ? "iqueue1" : "iqueue");
+}
+
+// Prints one metric family of all registered queues. field is the offset of the value in iqregstats_t.
+static void printmetric_iqregistry(iqregprinter_t* printer, const char* name, const char* type, const char* help, size_t field, int isqueue1)
+{
+   printf_iqregistry(printer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+   for (struct iqregentry_t* entry = s_registry; entry; entry = entry->next) {
+      if (!isqueue1 && entry->isqueue1) continue;
+      iqregstats_t stats;
+      stats_iqregistry(entry, &stats);
+      printf_iqregistry(printer, "%s", name);
+      printlabels_iqregistry(printer, entry);
+      printf_iqregistry(printer, "} %llu\n", (unsigned long long) *(uint64_t*)((char*)&stats + field));
+   }
+}
+
+static void printprometheus_iqregistry(iqregprinter_t* printer)
+{
+   printmetric_iqregistry(printer, "iqueue_depth", "gauge", "Number of stored messages.", offsetof(iqregstats_t, depth), 1);
+   printmetric_iqregistry(printer, "iqueue_capacity", "gauge", "Maximum number of storable messages.", offsetof(iqregstats_t, capacity), 1);
+   printmetric_iqregistry(printer, "iqueue_sent_total", "counter", "Number of sent messages.", offsetof(iqregstats_t, sent), 0);
+   printmetric_iqregistry(printer, "iqueue_received_total", "counter", "Number of received messages.", offsetof(iqregstats_t, received), 0);
+   printmetric_iqregistry(printer, "iqueue_waiting_readers", "gauge", "Number of blocked readers.", offsetof(iqregstats_t, nrreader), 1);
+   printmetric_iqregistry(printer, "iqueue_waiting_writers", "gauge", "Number of blocked writers.", offsetof(iqregstats_t, nrwriter), 1);
+
+   printf_iqregistry(printer, "# HELP iqueue_wait_seconds Waiting time of blocking sends and receives.\n# TYPE iqueue_wait_seconds histogram\n");
+   for (struct iqregentry_t* entry = s_registry; entry; entry = entry->next) {
+      uint64_t count = 0;
+      for (unsigned i = 0; i < IQREGISTRY_NRBUCKET; ++i) {
+         count += load_atomicu64(&entry->waitcount[i]);
+         printf_iqregistry(printer, "iqueue_wait_seconds_bucket");
+         printlabels_iqregistry(printer, entry);
+         if (i < IQREGISTRY_NRBUCKET-1) {
+            printf_iqregistry(printer, ",le=\"%g\"} %llu\n", (double) ((uint64_t)1 << i) / 1e6, (unsigned long long) count);
+         } else {
+            printf_iqregistry(printer, ",le=\"+Inf\"} %llu\n", (unsigned long long) count);
+         }
+      }
+      printf_iqregistry(printer, "iqueue_wait_seconds_sum");
+      printlabels_iqregistry(printer, entry);
+      printf_iqregistry(printer, "} %g\n", (double) load_atomicu64(&entry->waitsum_usec) / 1e6);
+      printf_iqregistry(printer, "iqueue_wait_seconds_count");
+      printlabels_iqregistry(printer, entry);
+      printf_iqregistry(printer, "} %llu\n", (unsigned long long) count);
+   }
+}
+
+static void printjson_iqregistry(iqregprinter_t* printer)
+{
+   printf_iqregistry(printer, "{\"queues\":[");
+   for (struct iqregentry_t* entry = s_registry; entry; entry = entry->next) {
+      iqregstats_t stats;
+      stats_iqregistry(entry, &stats);
+      printf_iqregistry(printer, "%s\n{\"name\":", entry == s_registry ? "" : ",");
+      printname_iqregistry(printer, entry->name, 1);
+      printf_iqregistry(printer, ",\"type\":\"%s\",\"depth\":%llu,\"capacity\":%llu", entry->isqueue1 ? "iqueue1" : "iqueue",
+                        (unsigned long long) stats.depth, (unsigned long long) stats.capacity);
+      if (!entry->isqueue1) {
+         printf_iqregistry(printer, ",\"sent\":%llu,\"received\":%llu", (unsigned long long) stats.sent, (unsigned long long) stats.received);
+      }
+      printf_iqregistry(printer, ",\"waiting_readers\":%llu,\"waiting_writers\":%llu,\"wait_sum_usec\":%llu,\"wait_buckets\":[",
+                        (unsigned long long) stats.nrreader, (unsigned long long) stats.nrwriter,
+                        (unsigned long long) load_atomicu64(&entry->waitsum_usec));
+      for (unsigned i = 0; i < IQREGISTRY_NRBUCKET; ++i) {
+         printf_iqregistry(printer, "%s%llu", i ? "," : "", (unsigned long long) load_atomicu64(&entry->waitcount[i]));
+      }
+      printf_iqregistry(printer, "]}");
+   }
+   printf_iqregistry(printer, "\n]}\n");
+}
+
+int print_iqregistry(char* buf, size_t size, int format, /*out*/size_t* len)
+{
+   if (format != IQREGISTRY_PROMETHEUS && format != IQREGISTRY_JSON) {
+      return EINVAL;
+   }
+
+   iqregprinter_t printer = { buf, size, 0 };
+
+   if (size) buf[0] = 0;
+
+   pthread_mutex_lock(&s_registrylock);
+   if (format == IQREGISTRY_PROMETHEUS) {
+      printprometheus_iqregistry(&printer);
+   } else {
+      printjson_iqregistry(&printer);
+   }
+   pthread_mutex_unlock(&s_registrylock);
+
+   *len = printer.len;
+
+   return printer.len < size ? 0 : ENOBUFS;
+}
+
+// Writes the output of print(buf, size, arg, &len) to file descriptor fd.
+static int writeprinted_iqregistry(int fd, int (*print) (char* buf, size_t size, int arg, /*out*/size_t* len), int arg)
+{
+   int    err;
+   size_t len;
+   size_t size = 4096;
+   char*  buf;
+
+   for (;;) {
+      buf = malloc(size);
+      if (!buf) return ENOMEM;
+      err = print(buf, size, arg, &len);
+      if (ENOBUFS != err) break;
+      free(buf);
+      size = len + 1024;
+   }
+
+   for (size_t off = 0; !err && off < len; ) {
+      ssize_t bytes = write(fd, buf + off, len - off);
+      if (bytes < 0) {
+         if (errno != EINTR) err = errno;
+         continue;
+      }
+      off += (size_t) bytes;
+   }
+
+   free(buf);
+
+   return err;
+}
+
+int write_iqregistry(int fd, int format)
+{
+   return writeprinted_iqregistry(fd, &print_iqregistry, format);
+}
+
+// === iqprofile ===
+
+#ifdef IQUEUE_PROFILE
+
+// nr of counters of iqueue_t:sizeused / iqueue_t:sizefree
+#define PROFILE_NRSIZE ((int)(sizeof(((iqueue_t*)0)->sizeused)/sizeof(((iqueue_t*)0)->sizeused[0])))
+// nr of counted cache lines of msg slots, slot lines of larger queues share counters
+#define PROFILE_NRLINE 1024
+#define PROFILE_SLOTSPERLINE ((SIZE_CACHELINE) / sizeof(void*))
+#ifndef IQUEUE_PROFILE_SLOWCYCLES
+#define IQUEUE_PROFILE_SLOWCYCLES 150
+#endif
+
+// Contention counters of all iqueue_t.
+static struct {
+   uint64_t readpos;  // slow fetch-and-add
+   uint64_t writepos; // slow fetch-and-add
+   uint64_t iused;    // failed CAS
+   uint64_t ifree;    // failed CAS
+   uint64_t sizeused[PROFILE_NRSIZE]; // failed reservations
+   uint64_t sizefree[PROFILE_NRSIZE]; // failed reservations
+   uint64_t msgline[PROFILE_NRLINE];  // spins on a slot of a cache line of msg
+} s_profile;
+
+#define PROFILE(counter) \
+   __atomic_fetch_add(&s_profile.counter, 1, __ATOMIC_RELAXED)
+
+#define PROFILE_IF(counter, cond) \
+   if (cond) PROFILE(counter)
+
+#define PROFILE_SLOT(pos) \
+   PROFILE(msgline[((pos) / PROFILE_SLOTSPERLINE) % PROFILE_NRLINE])
+
+#if defined(__GNUC__) && defined(__x86_64__)
+// Executes expr and counts it if it takes more than IQUEUE_PROFILE_SLOWCYCLES cycles.
+// Fetch-and-add never fails, a slow one waited for the cache line owned by another core.
+#define PROFILE_SLOW(counter, expr) \
+   {                                                     \
+      uint64_t _start = __builtin_ia32_rdtsc();          \
+      expr;                                              \
+      if (__builtin_ia32_rdtsc() - _start > IQUEUE_PROFILE_SLOWCYCLES) { \
+         PROFILE(counter);                               \
+      }                                                  \
+   }
+#else
+#define PROFILE_SLOW(counter, expr) \
+   expr;
+#endif
+
+int reset_iqprofile(void)
+{
+   memset(&s_profile, 0, sizeof(s_profile));
+   return 0;
+}
+
+// Location of a contention counter.
+typedef struct iqprofileloc_t {
+   uint64_t count;
+   uint32_t line;  // cache line number relative to start of iqueue_t or msg
+   uint32_t index; // index of sizeused, sizefree or msgline
+   uint32_t order; // tie breaker of ranking
+   const char* name;
+   const char* kind;
+} iqprofileloc_t;
+
+static int compare_iqprofile(const void* left, const void* right)
+{
+   const iqprofileloc_t* l = left;
+   const iqprofileloc_t* r = right;
+   if (l->count != r->count) return l->count > r->count ? -1 : 1;
+   return l->order < r->order ? -1 : 1;
+}
+
+static int print_profile(char* buf, size_t size, int arg, /*out*/size_t* len)
+{
+   (void) arg;
+   return print_iqprofile(buf, size, len);
+}
+
+int print_iqprofile(char* buf, size_t size, /*out*/size_t* len)
+{
+   static iqprofileloc_t loc[4 + 2*PROFILE_NRSIZE + PROFILE_NRLINE];
+   static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+   const  char* slow = "slow fetch-and-add";
+   const  char* cas  = "failed CAS";
+   const  char* reserve = "failed reservation";
+   uint32_t nrloc = 0;
+   uint64_t total = 0;
+
+   pthread_mutex_lock(&lock);
+
+#define ADDLOC(counter, _name, _index, _line, _kind) \
+   loc[nrloc] = (iqprofileloc_t) { __atomic_load_n(&s_profile.counter, __ATOMIC_RELAXED), (uint32_t) (_line), (uint32_t) (_index), nrloc, _name, _kind }; \
+   ++ nrloc
+
+   ADDLOC(readpos, "readpos", 0, offsetof(iqueue_t, readpos) / SIZE_CACHELINE, slow);
+   ADDLOC(writepos, "writepos", 0, offsetof(iqueue_t, writepos) / SIZE_CACHELINE, slow);
+   ADDLOC(iused, "iused", 0, offsetof(iqueue_t, iused) / SIZE_CACHELINE, cas);
+   ADDLOC(ifree, "ifree", 0, offsetof(iqueue_t, ifree) / SIZE_CACHELINE, cas);
+   for (int i = 0; i < PROFILE_NRSIZE; ++i) {
+      ADDLOC(sizeused[i], "sizeused", i, (offsetof(iqueue_t, sizeused) + (size_t)i * sizeof(iqpos_t)) / SIZE_CACHELINE, reserve);
+      ADDLOC(sizefree[i], "sizefree", i, (offsetof(iqueue_t, sizefree) + (size_t)i * sizeof(iqpos_t)) / SIZE_CACHELINE, reserve);
+   }
+   for (int i = 0; i < PROFILE_NRLINE; ++i) {
+      ADDLOC(msgline[i], "msg", i, i, "slot spin");
+   }
+
+#undef ADDLOC
+
+   for (uint32_t i = 0; i < nrloc; ++i) {
+      total += loc[i].count;
+   }
+
+   qsort(loc, nrloc, sizeof(loc[0]), &compare_iqprofile);
+
+   iqregprinter_t printer = { buf, size, 0 };
+   if (size) buf[0] = 0;
+
+   printf_iqregistry(&printer, "iqueue_t contention profile: %llu events\n", (unsigned long long) total);
+   printf_iqregistry(&printer, "%4s %12s %7s  %-14s %-18s %s\n", "rank", "events", "share", "location", "kind", "cache line");
+   for (uint32_t i = 0; i < nrloc && loc[i].count; ++i) {
+      char name[32];
+      if (loc[i].name[0] == 'm') {
+         snprintf(name, sizeof(name), "msg[%u..%u]", loc[i].index * (uint32_t)PROFILE_SLOTSPERLINE, (loc[i].index+1) * (uint32_t)PROFILE_SLOTSPERLINE - 1);
+      } else if (loc[i].name[0] == 's') {
+         snprintf(name, sizeof(name), "%s[%u]", loc[i].name, loc[i].index);
+      } else {
+         snprintf(name, sizeof(name), "%s", loc[i].name);
+      }
+      printf_iqregistry(&printer, "%4u %12llu %6.1f%%  %-14s %-18s %s+%u\n", i+1, (unsigned long long) loc[i].count,
+                        100.0 * (double) loc[i].count / (double) total, name, loc[i].kind,
+                        loc[i].name[0] == 'm' ? "msg" : "iqueue_t", loc[i].line);
+   }
+
+   // sum up events of locations sharing a cache line
+   uint32_t nrline = 0;
+   for (uint32_t i = 0; i < nrloc && loc[i].count; ++i) {
+      uint64_t count = loc[i].count;
+      uint32_t l = 0;
+      loc[i].count = 0;
+      while (l < nrline && (loc[l].line != loc[i].line || (loc[l].name[0] == 'm') != (loc[i].name[0] == 'm'))) ++l;
+      if (l == nrline) {
+         loc[nrline].count = 0;
+         loc[nrline].line = loc[i].line;
+         loc[nrline].order = nrline;
+         loc[nrline].name = loc[i].name[0] == 'm' ? "msg" : "iqueue_t";
+         ++ nrline;
+      }
+      // loc[l] with l <= i is already printed
+      loc[l].count += count;
+   }
+
+   qsort(loc, nrline, sizeof(loc[0]), &compare_iqprofile);
+
+   printf_iqregistry(&printer, "%4s %12s %7s  %s\n", "rank", "events", "share", "cache line");
+   for (uint32_t i = 0; i < nrline; ++i) {
+      printf_iqregistry(&printer, "%4u %12llu %6.1f%%  %s+%u\n", i+1, (unsigned long long) loc[i].count,
+                        100.0 * (double) loc[i].count / (double) total, loc[i].name, loc[i].line);
+   }
+
+   pthread_mutex_unlock(&lock);
+
+   *len = printer.len;
+
+   return printer.len < size ? 0 : ENOBUFS;
+}
+
+int write_iqprofile(int fd)
+{
+   return writeprinted_iqregistry(fd, &print_profile, 0);
+}
+
+#else
+
+#define PROFILE(counter)
+#define PROFILE_IF(counter, cond)   (void) (cond)
+#define PROFILE_SLOT(pos)
+#define PROFILE_SLOW(counter, expr) expr;
+
+int reset_iqprofile(void)
+{
+   return ENOSYS;
+}
+
+int print_iqprofile(char* buf, size_t size, /*out*/size_t* len)
+{
+   if (size) buf[0] = 0;
+   *len = 0;
+   return ENOSYS;
+}
+
+int write_iqprofile(int fd)
+{
+   (void) fd;
+   return ENOSYS;
+}
+
+#endif
+
 // === iqueue_t ===
 
 // length of iqueue_t:sizeused / iqueue_t:sizefree
 #define NROFSIZE ((int)(sizeof(((iqueue_t*)0)->sizeused)/sizeof(((iqueue_t*)0)->sizeused[0])))
 
-int new_iqueue(/*out*/iqueue_t** queue, uint32_t capacity)
+int new_iqueue(/*out*/iqueue_t** queue, iqpos_t capacity)
 {
-   uint32_t isNOTpowerof2 = (capacity & (capacity-1));
-   uint32_t aligned_capacity = capacity < NROFSIZE || isNOTpowerof2 ? NROFSIZE : capacity/2;
+   iqpos_t isNOTpowerof2 = (capacity & (capacity-1));
+   iqpos_t aligned_capacity = capacity < NROFSIZE || isNOTpowerof2 ? NROFSIZE : capacity/2;
 
    while (aligned_capacity < capacity) {
+      if (aligned_capacity > ((iqpos_t)-1) / 2) {
+         return EINVAL;
+      }
       aligned_capacity <<= 1;
       if (aligned_capacity >= ((size_t)-1 - sizeof(iqueue_t)) / sizeof(void*)) {
          return EINVAL;
@@ -137,26 +918,2417 @@ int new_iqueue(/*out*/iqueue_t** queue, uint32_t capacity)
    }
 
    size_t queuesize = sizeof(iqueue_t) + aligned_capacity * sizeof(void*);
-   iqueue_t* allocated_queue = (iqueue_t*) malloc(queuesize);
+   iqueue_t* allocated_queue = (iqueue_t*) malloc_aligned(queuesize);
 
    if (!allocated_queue) {
       return ENOMEM;
    }
 
-   memset(allocated_queue, 0, queuesize);
-   allocated_queue->capacity = aligned_capacity;
-   for (int i = 0; i < NROFSIZE; ++i) {
-      allocated_queue->sizefree[i] = aligned_capacity / NROFSIZE;
+   int err = init_iqueue(allocated_queue, aligned_capacity);
+   if (err) {
+      free(allocated_queue);
+      return err;
    }
 
-   int err;
-   int initcount = 0;
+   *queue = allocated_queue;
 
-   err = init_iqsignal(&allocated_queue->reader);
-   if (err) goto ONERR;
-   initcount = 1;
+   return 0; /*OK*/
+}
 
-   err = init_iqsignal(&allocated_queue->writer);
+int delete_iqueue(iqueue_t** queue)
+{
+   int err = 0;
+
+   if (*queue) {
+
+      err = free_iqueue(*queue);
+
+      free(*queue);
+
+      *queue = 0;
+   }
+
+   return err;
+}
+
+int init_iqueue(/*out*/iqueue_t* queue, iqpos_t capacity)
+{
+   if (capacity == 0 || (capacity & (capacity-1))) {
+      return EINVAL;
+   }
+
+   memset(queue, 0, sizeof(iqueue_t) + capacity * sizeof(void*));
+   queue->capacity = capacity;
+   for (int i = 0; i < NROFSIZE; ++i) {
+      // a capacity less than NROFSIZE leaves some counters at 0
+      queue->sizefree[i] = capacity >= NROFSIZE ? capacity / NROFSIZE : (iqpos_t) (i < (int)capacity);
+   }
+
+   int err;
+   int initcount = 0;
+
+   err = init_iqsignal(&queue->reader);
+   if (err) goto ONERR;
+   initcount = 1;
+
+   err = init_iqsignal(&queue->writer);
+   if (err) goto ONERR;
+   // initcount = 2;
+
+   return 0; /*OK*/
+ONERR:
+   switch (initcount) {
+   case 1: free_iqsignal(&queue->reader);
+   case 0: break;
+   }
+   return err;
+}
+
+int free_iqueue(iqueue_t* queue)
+{
+   int err;
+   int err2;
+
+   close_iqueue(queue);
+
+   unregister_iqregistry(&queue->regentry);
+
+   err = free_iqsignal(&queue->writer);
+   err2 = free_iqsignal(&queue->reader);
+   if (err2) err = err2;
+
+   return err;
+}
+
+int register_iqueue(iqueue_t* queue, const char* name)
+{
+   return register_iqregistry(&queue->regentry, queue, 0, name);
+}
+
+void close_iqueue(iqueue_t* queue)
+{
+   close_waiting(&queue->closed, &queue->reader, &queue->writer);
+}
+
+int trysend_iqueue(iqueue_t* queue, void* msg)
+{
+   uint32_t ifree;
+
+   if (0 == msg) {
+      return EINVAL;
+   }
+
+   for (int i = 0;; ++i) {
+      ifree = queue->ifree;
+      if (queue->closed) return EPIPE;
+      iqpos_t sizefree = fetchadd_atomicpos(&queue->sizefree[ifree], (iqpos_t)-1) - 1;
+      if (sizefree < queue->capacity) break;
+      PROFILE(sizefree[ifree]);
+      fetchadd_atomicpos(&queue->sizefree[ifree], 1);
+      PROFILE_IF(ifree, ifree != cmpxchg_atomicu32(&queue->ifree, ifree, (ifree+1) & (NROFSIZE-1)));
+      if (i == NROFSIZE-1) return EAGAIN;
+   }
+
+   iqpos_t pos;
+   PROFILE_SLOW(writepos, pos = fetchadd_atomicpos(&queue->writepos, 1))
+   pos &= (queue->capacity-1);
+
+   while (0 != cmpxchg_atomicptr(&queue->msg[pos], 0, msg)) {
+      PROFILE_SLOT(pos);
+   }
+
+   fetchadd_atomicpos(&queue->sizeused[ifree], 1);
+
+   CAPTURE(IQUEUE, SEND, 1);
+
+   return 0;
+}
+
+int tryrecv_iqueue(iqueue_t* queue, /*out*/void** msg)
+{
+   uint32_t iused;
+
+   for (int i = 0;; ++i) {
+      iused = queue->iused;
+      if (queue->closed) return EPIPE;
+      iqpos_t sizeused = fetchadd_atomicpos(&queue->sizeused[iused], (iqpos_t)-1) - 1;
+      if (sizeused < queue->capacity) break;
+      PROFILE(sizeused[iused]);
+      fetchadd_atomicpos(&queue->sizeused[iused], 1);
+      PROFILE_IF(iused, iused != cmpxchg_atomicu32(&queue->iused, iused, (iused+1) & (NROFSIZE-1)));
+      if (i == NROFSIZE-1) return EAGAIN;
+   }
+
+   iqpos_t pos;
+   PROFILE_SLOW(readpos, pos = fetchadd_atomicpos(&queue->readpos, 1))
+   pos &= (queue->capacity-1);
+
+   void* fetchedmsg = queue->msg[pos];
+   while (fetchedmsg != cmpxchg_atomicptr(&queue->msg[pos], fetchedmsg, 0) || 0 == fetchedmsg) {
+      PROFILE_SLOT(pos);
+      fetchedmsg = queue->msg[pos];
+   }
+
+   *msg = fetchedmsg;
+
+   fetchadd_atomicpos(&queue->sizefree[iused], 1);
+
+   CAPTURE(IQUEUE, RECV, 1);
+
+   return 0;
+}
+
+int trysendn_iqueue(iqueue_t* queue, void* msg[/*nrmsg*/], size_t nrmsg, /*out*/size_t* nrsent)
+{
+   for (size_t i = 0; i < nrmsg; ++i) {
+      if (0 == msg[i]) return EINVAL;
+   }
+
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   size_t n = 0;
+
+   for (int i = 0; n < nrmsg && i < NROFSIZE; ++i) {
+      uint32_t ifree = queue->ifree;
+      // reserve as many free slots of counter ifree as possible
+      iqpos_t sizefree = queue->sizefree[ifree];
+      iqpos_t nrslot = 0;
+      while (0 < sizefree && sizefree <= queue->capacity) {
+         nrslot = nrmsg - n < sizefree ? (iqpos_t) (nrmsg - n) : sizefree;
+         iqpos_t oldsize = sizefree;
+         sizefree = cmpxchg_atomicpos(&queue->sizefree[ifree], oldsize, oldsize - nrslot);
+         if (sizefree == oldsize) break;
+         PROFILE(sizefree[ifree]);
+         nrslot = 0;
+      }
+
+      if (nrslot) {
+         iqpos_t pos;
+         PROFILE_SLOW(writepos, pos = fetchadd_atomicpos(&queue->writepos, nrslot))
+         for (iqpos_t s = 0; s < nrslot; ++s, ++pos) {
+            while (0 != cmpxchg_atomicptr(&queue->msg[pos & (queue->capacity-1)], 0, msg[n+s])) {
+               PROFILE_SLOT(pos & (queue->capacity-1));
+            }
+         }
+         fetchadd_atomicpos(&queue->sizeused[ifree], nrslot);
+         n += nrslot;
+         if (n == nrmsg) break;
+      }
+
+      PROFILE_IF(ifree, ifree != cmpxchg_atomicu32(&queue->ifree, ifree, (ifree+1) & (NROFSIZE-1)));
+   }
+
+   *nrsent = n;
+
+   if (! n) return EAGAIN;
+
+   CAPTURE(IQUEUE, SEND, n);
+
+   return 0;
+}
+
+// Wakes up one thread waiting on signal if signalcount != 0.
+static void wakeup_waiting(iqsignal_t* signal)
+{
+   pthread_mutex_lock(&signal->lock);
+   if (signal->signalcount) {
+      -- signal->signalcount;
+      pthread_cond_signal(&signal->cond);
+   }
+   pthread_mutex_unlock(&signal->lock);
+}
+
+// Waits on signal until woken up or until deadline (CLOCK_MONOTONIC) expires.
+// deadline == 0 waits without time limit. The lock of signal must be held.
+// Returns ETIMEDOUT if deadline expired.
+static int wait_signal(iqsignal_t* signal, const struct timespec* deadline)
+{
+   if (deadline) {
+      return pthread_cond_timedwait(&signal->cond, &signal->lock, deadline);
+   }
+   return pthread_cond_wait(&signal->cond, &signal->lock);
+}
+
+// Returns true if deadline != 0 has a tv_nsec which pthread_cond_timedwait rejects with EINVAL.
+static inline int isinvalid_deadline(const struct timespec* deadline)
+{
+   return deadline && (deadline->tv_nsec < 0 || deadline->tv_nsec >= 1000000000);
+}
+
+// A waiting thread increments signalcount before it retries a last time.
+// So a thread which changed the queue afterwards sees signalcount != 0.
+#define WAKEUP_READER() \
+   if (!err && queue->reader.signalcount) {      \
+      wakeup_waiting(&queue->reader);            \
+   }
+
+#define WAKEUP_WRITER() \
+   if (!err && queue->writer.signalcount) {      \
+      wakeup_waiting(&queue->writer);            \
+   }
+
+int waitsend_iqueue(iqueue_t* queue, void* msg, const struct timespec* deadline, iqcancel_t* cancel)
+{
+   if (isinvalid_deadline(deadline)) {
+      return EINVAL;
+   }
+
+   int err = trysend_iqueue(queue, msg);
+
+   WAKEUP_READER();
+
+   if (EAGAIN == err) {
+      struct iqregentry_t* regentry = queue->regentry;
+      uint64_t waitstart = regentry ? now_usec() : 0;
+      pthread_mutex_lock(&queue->writer.lock);
+      ++ queue->writer.waitcount;
+      if (cancel) store_atomicptr((void**)&cancel->signal, &queue->writer);
+
+      for (int istimeout = 0;;) {
+         ++ queue->writer.signalcount;
+         fence_atomic();
+         err = trysend_iqueue(queue, msg);
+         if (EAGAIN != err) break;
+         if (istimeout) {
+            err = ETIMEDOUT;
+            break;
+         }
+         if (cancel && load_atomicu32(&cancel->canceled)) {
+            err = ECANCELED;
+            break;
+         }
+         err = wait_signal(&queue->writer, deadline);
+         if (err && ETIMEDOUT != err) break;
+         istimeout = (ETIMEDOUT == err);
+      }
+
+      if (cancel) store_atomicptr((void**)&cancel->signal, 0);
+      // before waitcount is released free_iqueue could unregister and free the queue
+      if (regentry) waited_iqregistry(regentry, now_usec() - waitstart);
+      -- queue->writer.waitcount;
+      pthread_mutex_unlock(&queue->writer.lock);
+
+      WAKEUP_READER();
+   }
+
+   return err;
+}
+
+int timedsend_iqueue(iqueue_t* queue, void* msg, const struct timespec* deadline)
+{
+   return waitsend_iqueue(queue, msg, deadline, 0);
+}
+
+int send_iqueue(iqueue_t* queue, void* msg)
+{
+   return waitsend_iqueue(queue, msg, 0, 0);
+}
+
+int waitrecv_iqueue(iqueue_t* queue, /*out*/void** msg, const struct timespec* deadline, iqcancel_t* cancel)
+{
+   if (isinvalid_deadline(deadline)) {
+      return EINVAL;
+   }
+
+   int err = tryrecv_iqueue(queue, msg);
+
+   WAKEUP_WRITER();
+
+   if (EAGAIN == err) {
+      struct iqregentry_t* regentry = queue->regentry;
+      uint64_t waitstart = regentry ? now_usec() : 0;
+      pthread_mutex_lock(&queue->reader.lock);
+      ++ queue->reader.waitcount;
+      if (cancel) store_atomicptr((void**)&cancel->signal, &queue->reader);
+
+      for (int istimeout = 0;;) {
+         ++ queue->reader.signalcount;
+         fence_atomic();
+         err = tryrecv_iqueue(queue, msg);
+         if (EAGAIN != err) break;
+         if (istimeout) {
+            err = ETIMEDOUT;
+            break;
+         }
+         if (cancel && load_atomicu32(&cancel->canceled)) {
+            err = ECANCELED;
+            break;
+         }
+         err = wait_signal(&queue->reader, deadline);
+         if (err && ETIMEDOUT != err) break;
+         istimeout = (ETIMEDOUT == err);
+      }
+
+      if (cancel) store_atomicptr((void**)&cancel->signal, 0);
+      // before waitcount is released free_iqueue could unregister and free the queue
+      if (regentry) waited_iqregistry(regentry, now_usec() - waitstart);
+      -- queue->reader.waitcount;
+      pthread_mutex_unlock(&queue->reader.lock);
+
+      WAKEUP_WRITER();
+   }
+
+   return err;
+}
+
+int timedrecv_iqueue(iqueue_t* queue, /*out*/void** msg, const struct timespec* deadline)
+{
+   return waitrecv_iqueue(queue, msg, deadline, 0);
+}
+
+int recv_iqueue(iqueue_t* queue, /*out*/void** msg)
+{
+   return waitrecv_iqueue(queue, msg, 0, 0);
+}
+
+int recvn_iqueue(iqueue_t* queue, /*out*/void* msg[/*nrmsg*/], size_t nrmsg, size_t minmsg, uint32_t maxlatency_usec, /*out*/size_t* nrrecv)
+{
+   if (0 == nrmsg || nrmsg < minmsg) {
+      return EINVAL;
+   }
+
+   int err = recv_iqueue(queue, &msg[0]);
+   if (err) return err;
+
+   struct timespec deadline;
+   deadline_usec(&deadline, maxlatency_usec);
+
+   size_t n = 1;
+   while (n < nrmsg) {
+      err = tryrecv_iqueue(queue, &msg[n]);
+      WAKEUP_WRITER();
+      if (! err) {
+         ++ n;
+         continue;
+      }
+      if (EAGAIN != err || n >= minmsg) break;
+      // wait for missing messages until deadline
+      err = timedrecv_iqueue(queue, &msg[n], &deadline);
+      if (err) break;
+      ++ n;
+   }
+
+   *nrrecv = n;
+
+   return 0;
+}
+
+int reset_iqueue(iqueue_t* queue)
+{
+   if (! queue->closed) {
+      return EINVAL;
+   }
+
+   iqpos_t sizeused = 0;
+   for (int i = 0; i < NROFSIZE; ++i) {
+      sizeused += queue->sizeused[i];
+   }
+   if (sizeused || queue->readpos != queue->writepos) {
+      return EBUSY;
+   }
+
+   queue->reader.signalcount = 0;
+   queue->writer.signalcount = 0;
+   // all stores are visible before the queue is seen as open
+   releasefence_atomic();
+   queue->closed = 0;
+
+   return 0;
+}
+
+iqpos_t size_iqueue(const iqueue_t* queue)
+{
+   iqpos_t size = 0;
+   for (int i = 0; i < NROFSIZE; ++i) {
+      iqpos_t sizeused = cmpxchg_atomicpos((iqpos_t*)(uintptr_t)&queue->sizeused[i], 0, 0);
+      size += (sizeused < queue->capacity ? sizeused : 0);
+   }
+   return size <= queue->capacity ? size : queue->capacity;
+}
+
+// === iqueue1_t ===
+
+int new_iqueue1(/*out*/iqueue1_t** queue, iqpos_t capacity)
+{
+   if (capacity == 0 || ((size_t)-1 - sizeof(iqueue1_t))/sizeof(void*) <= capacity) {
+      return EINVAL;
+   }
+
+   size_t queuesize = sizeof(iqueue1_t) + capacity * sizeof(void*);
+   iqueue1_t* allocated_queue = (iqueue1_t*) malloc_aligned(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   int err = init_iqueue1(allocated_queue, capacity);
+   if (err) {
+      free(allocated_queue);
+      return err;
+   }
+
+   *queue = allocated_queue;
+
+   return 0; /*OK*/
+}
+
+int delete_iqueue1(iqueue1_t** queue)
+{
+   int err = 0;
+
+   if (*queue) {
+
+      err = free_iqueue1(*queue);
+
+      free(*queue);
+
+      *queue = 0;
+   }
+
+   return err;
+}
+
+int init_iqueue1(/*out*/iqueue1_t* queue, iqpos_t capacity)
+{
+   if (capacity == 0) {
+      return EINVAL;
+   }
+
+   memset(queue, 0, sizeof(iqueue1_t) + capacity * sizeof(void*));
+   queue->capacity = capacity;
+
+   int err;
+   int initcount = 0;
+
+   err = init_iqsignal(&queue->reader);
+   if (err) goto ONERR;
+   initcount = 1;
+
+   err = init_iqsignal(&queue->writer);
+   if (err) goto ONERR;
+   // initcount = 2;
+
+   return 0; /*OK*/
+ONERR:
+   switch (initcount) {
+   case 1: free_iqsignal(&queue->reader);
+   case 0: break;
+   }
+   return err;
+}
+
+int free_iqueue1(iqueue1_t* queue)
+{
+   int err;
+   int err2;
+
+   close_iqueue1(queue);
+
+   unregister_iqregistry(&queue->regentry);
+
+   err = free_iqsignal(&queue->writer);
+   err2 = free_iqsignal(&queue->reader);
+   if (err2) err = err2;
+
+   return err;
+}
+
+int register_iqueue1(iqueue1_t* queue, const char* name)
+{
+   return register_iqregistry(&queue->regentry, queue, 1, name);
+}
+
+void close_iqueue1(iqueue1_t* queue)
+{
+   close_waiting(&queue->closed, &queue->reader, &queue->writer);
+}
+
+int trysend_iqueue1(iqueue1_t* queue, void* msg)
+{
+   if (0 == msg) {
+      return EINVAL;
+   }
+
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   iqpos_t pos = queue->writepos;
+   iqpos_t oldpos = pos;
+   ++pos;
+   if (pos >= queue->capacity) {
+      pos = 0;
+   }
+   queue->writepos = pos;
+
+   if (0 != cmpxchg_atomicptr(&queue->msg[oldpos], 0, msg)) {
+      queue->writepos = oldpos;
+      return EAGAIN;
+   }
+
+   CAPTURE(IQUEUE1, SEND, 1);
+
+   return 0;
+}
+
+int tryrecv_iqueue1(iqueue1_t* queue, /*out*/void** msg)
+{
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   iqpos_t pos = queue->readpos;
+   iqpos_t oldpos = pos;
+   ++pos;
+   if (pos >= queue->capacity) {
+      pos = 0;
+   }
+   queue->readpos = pos;
+
+   void* fetchedmsg = queue->msg[oldpos];
+
+   if (fetchedmsg != cmpxchg_atomicptr(&queue->msg[oldpos], fetchedmsg, 0) || 0 == fetchedmsg) {
+      queue->readpos = oldpos;
+      return EAGAIN;
+   }
+
+   *msg = fetchedmsg;
+
+   CAPTURE(IQUEUE1, RECV, 1);
+
+   return 0;
+}
+
+int waitsend_iqueue1(iqueue1_t* queue, void* msg, const struct timespec* deadline, iqcancel_t* cancel)
+{
+   if (isinvalid_deadline(deadline)) {
+      return EINVAL;
+   }
+
+   int err = trysend_iqueue1(queue, msg);
+
+   WAKEUP_READER();
+
+   if (EAGAIN == err) {
+      struct iqregentry_t* regentry = queue->regentry;
+      uint64_t waitstart = regentry ? now_usec() : 0;
+      pthread_mutex_lock(&queue->writer.lock);
+      ++ queue->writer.waitcount;
+      if (cancel) store_atomicptr((void**)&cancel->signal, &queue->writer);
+
+      for (int istimeout = 0;;) {
+         ++ queue->writer.signalcount;
+         fence_atomic();
+         err = trysend_iqueue1(queue, msg);
+         if (EAGAIN != err) break;
+         if (istimeout) {
+            err = ETIMEDOUT;
+            break;
+         }
+         if (cancel && load_atomicu32(&cancel->canceled)) {
+            err = ECANCELED;
+            break;
+         }
+         err = wait_signal(&queue->writer, deadline);
+         if (err && ETIMEDOUT != err) break;
+         istimeout = (ETIMEDOUT == err);
+      }
+
+      if (cancel) store_atomicptr((void**)&cancel->signal, 0);
+      // before waitcount is released free_iqueue1 could unregister and free the queue
+      if (regentry) waited_iqregistry(regentry, now_usec() - waitstart);
+      -- queue->writer.waitcount;
+      pthread_mutex_unlock(&queue->writer.lock);
+
+      WAKEUP_READER();
+   }
+
+   return err;
+}
+
+int timedsend_iqueue1(iqueue1_t* queue, void* msg, const struct timespec* deadline)
+{
+   return waitsend_iqueue1(queue, msg, deadline, 0);
+}
+
+int send_iqueue1(iqueue1_t* queue, void* msg)
+{
+   return waitsend_iqueue1(queue, msg, 0, 0);
+}
+
+int waitrecv_iqueue1(iqueue1_t* queue, /*out*/void** msg, const struct timespec* deadline, iqcancel_t* cancel)
+{
+   if (isinvalid_deadline(deadline)) {
+      return EINVAL;
+   }
+
+   int err = tryrecv_iqueue1(queue, msg);
+
+   WAKEUP_WRITER();
+
+   if (EAGAIN == err) {
+      struct iqregentry_t* regentry = queue->regentry;
+      uint64_t waitstart = regentry ? now_usec() : 0;
+      pthread_mutex_lock(&queue->reader.lock);
+      ++ queue->reader.waitcount;
+      if (cancel) store_atomicptr((void**)&cancel->signal, &queue->reader);
+
+      for (int istimeout = 0;;) {
+         ++ queue->reader.signalcount;
+         fence_atomic();
+         err = tryrecv_iqueue1(queue, msg);
+         if (EAGAIN != err) break;
+         if (istimeout) {
+            err = ETIMEDOUT;
+            break;
+         }
+         if (cancel && load_atomicu32(&cancel->canceled)) {
+            err = ECANCELED;
+            break;
+         }
+         err = wait_signal(&queue->reader, deadline);
+         if (err && ETIMEDOUT != err) break;
+         istimeout = (ETIMEDOUT == err);
+      }
+
+      if (cancel) store_atomicptr((void**)&cancel->signal, 0);
+      // before waitcount is released free_iqueue1 could unregister and free the queue
+      if (regentry) waited_iqregistry(regentry, now_usec() - waitstart);
+      -- queue->reader.waitcount;
+      pthread_mutex_unlock(&queue->reader.lock);
+
+      WAKEUP_WRITER();
+   }
+
+   return err;
+}
+
+int timedrecv_iqueue1(iqueue1_t* queue, /*out*/void** msg, const struct timespec* deadline)
+{
+   return waitrecv_iqueue1(queue, msg, deadline, 0);
+}
+
+int recv_iqueue1(iqueue1_t* queue, /*out*/void** msg)
+{
+   return waitrecv_iqueue1(queue, msg, 0, 0);
+}
+
+int trysendn_iqueue1(iqueue1_t* queue, void* msg[/*nrmsg*/], size_t nrmsg, /*out*/size_t* nrsent)
+{
+   for (size_t i = 0; i < nrmsg; ++i) {
+      if (0 == msg[i]) return EINVAL;
+   }
+
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   // single writer: a free slot stays free until it is filled by this thread
+   iqpos_t pos = queue->writepos;
+   size_t  n = 0;
+   for (; n < nrmsg; ++n) {
+      if (0 != load_atomicptr(&queue->msg[pos])) break;
+      store_atomicptr(&queue->msg[pos], msg[n]);
+      if (++pos >= queue->capacity) pos = 0;
+   }
+   queue->writepos = pos;
+
+   *nrsent = n;
+
+   if (! n) return EAGAIN;
+
+   CAPTURE(IQUEUE1, SEND, n);
+
+   return 0;
+}
+
+// Moves the run of filled slots at the start of slot[0..nrslot) into msg[] and clears them.
+// Returns the length of the run.
+static size_t moveready_scalar(void** slot, /*out*/void** msg, size_t nrslot)
+{
+   size_t i = 0;
+   for (; i < nrslot; ++i) {
+      void* fetchedmsg = load_atomicptr(&slot[i]);
+      if (0 == fetchedmsg) break;
+      msg[i] = fetchedmsg;
+      store_atomicptr(&slot[i], 0);
+   }
+   return i;
+}
+
+#ifdef IQUEUE_SIMD_X86
+
+// x86 does not reorder loads with other loads nor stores with older loads (acquire / release for free).
+// The 8 byte aligned pointers are not torn by a vector load, only the vector as a whole is not atomic.
+// Checks 2 slots per instruction.
+static size_t moveready_sse2(void** slot, /*out*/void** msg, size_t nrslot)
+{
+   const __m128i zero = _mm_setzero_si128();
+   size_t i = 0;
+   for (; i + 2 <= nrslot; i += 2) {
+      __m128i v = _mm_loadu_si128((const __m128i*) &slot[i]);
+      int iszero = _mm_movemask_epi8(_mm_cmpeq_epi32(v, zero));
+      if ((iszero & 0xff) == 0xff || (iszero & 0xff00) == 0xff00) break;
+      _mm_storeu_si128((__m128i*) &msg[i], v);
+      _mm_storeu_si128((__m128i*) &slot[i], zero);
+   }
+   return i + moveready_scalar(slot + i, msg + i, nrslot - i);
+}
+
+// Checks 4 slots per instruction.
+__attribute__((target("avx2")))
+static size_t moveready_avx2(void** slot, /*out*/void** msg, size_t nrslot)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   size_t i = 0;
+   for (; i + 4 <= nrslot; i += 4) {
+      __m256i v = _mm256_loadu_si256((const __m256i*) &slot[i]);
+      if (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, zero)))) break;
+      _mm256_storeu_si256((__m256i*) &msg[i], v);
+      _mm256_storeu_si256((__m256i*) &slot[i], zero);
+   }
+   return i + moveready_sse2(slot + i, msg + i, nrslot - i);
+}
+
+#endif
+
+// Selects SIMD version supported by the CPU at runtime (compile with IQUEUE_NOSIMD to use the scalar version).
+static inline size_t moveready_iqueue1(void** slot, /*out*/void** msg, size_t nrslot)
+{
+#ifdef IQUEUE_SIMD_X86
+   if (__builtin_cpu_supports("avx2")) {
+      return moveready_avx2(slot, msg, nrslot);
+   }
+   return moveready_sse2(slot, msg, nrslot);
+#else
+   return moveready_scalar(slot, msg, nrslot);
+#endif
+}
+
+int tryrecvn_iqueue1(iqueue1_t* queue, /*out*/void* msg[/*nrmsg*/], size_t nrmsg, /*out*/size_t* nrrecv)
+{
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   // single reader: a filled slot stays filled until it is cleared by this thread
+   iqpos_t pos = queue->readpos;
+   size_t  n = 0;
+   while (n < nrmsg) {
+      size_t nrslot = queue->capacity - pos;
+      if (nrslot > nrmsg - n) nrslot = nrmsg - n;
+      size_t nrready = moveready_iqueue1(&queue->msg[pos], &msg[n], nrslot);
+      n += nrready;
+      pos += (iqpos_t) nrready;
+      if (pos >= queue->capacity) pos = 0;
+      if (nrready < nrslot) break;
+   }
+   queue->readpos = pos;
+
+   *nrrecv = n;
+
+   if (! n) return EAGAIN;
+
+   CAPTURE(IQUEUE1, RECV, n);
+
+   return 0;
+}
+
+int splice_iqueue1(iqueue1_t* dest, iqueue1_t* src, size_t maxn, /*out*/size_t* nrmoved)
+{
+   if (dest == src) {
+      return EINVAL;
+   }
+
+   if (dest->closed || src->closed) {
+      return EPIPE;
+   }
+
+   iqpos_t rpos = src->readpos;
+   iqpos_t wpos = dest->writepos;
+   size_t  n = 0;
+   for (; n < maxn; ++n) {
+      void* msg = load_atomicptr(&src->msg[rpos]);
+      if (0 == msg || 0 != load_atomicptr(&dest->msg[wpos])) break;
+      store_atomicptr(&dest->msg[wpos], msg);
+      store_atomicptr(&src->msg[rpos], 0);
+      if (++rpos >= src->capacity) rpos = 0;
+      if (++wpos >= dest->capacity) wpos = 0;
+   }
+   src->readpos = rpos;
+   dest->writepos = wpos;
+
+   *nrmoved = n;
+
+   if (! n) {
+      return EAGAIN;
+   }
+
+   // stores of slots are not reordered after the loads of signalcount (see WAKEUP_READER)
+   fence_atomic();
+   if (dest->reader.signalcount) {
+      wakeup_waiting(&dest->reader);
+   }
+   if (src->writer.signalcount) {
+      wakeup_waiting(&src->writer);
+   }
+
+   return 0;
+}
+
+int reset_iqueue1(iqueue1_t* queue)
+{
+   if (! queue->closed) {
+      return EINVAL;
+   }
+
+   // messages are stored contiguously from readpos to writepos
+   if (queue->readpos != queue->writepos || 0 != queue->msg[queue->readpos]) {
+      return EBUSY;
+   }
+
+   queue->readpos  = 0;
+   queue->writepos = 0;
+   queue->reader.signalcount = 0;
+   queue->writer.signalcount = 0;
+   // all stores are visible before the queue is seen as open
+   releasefence_atomic();
+   queue->closed = 0;
+
+   return 0;
+}
+
+iqpos_t size_iqueue1(const iqueue1_t* queue)
+{
+   iqpos_t rpos = cmpxchg_atomicpos((iqpos_t*)(uintptr_t)&queue->readpos, 0, 0);
+   iqpos_t wpos = cmpxchg_atomicpos((iqpos_t*)(uintptr_t)&queue->writepos, 0, 0);
+
+   if (rpos < wpos) {
+      return (wpos - rpos);
+
+   } else {
+      iqpos_t free = (rpos - wpos);
+      return (free == 0 && 0 == queue->msg[wpos == 0?queue->capacity-1:wpos-1])
+             ? 0
+             : (queue->capacity - free);
+   }
+}
+
+// === iqpool_t ===
+
+// length of iqpool_t:sizeclass
+#define NROFCLASS ((int)(sizeof(((iqpool_t*)0)->sizeclass)/sizeof(((iqpool_t*)0)->sizeclass[0])))
+
+int new_iqpool(/*out*/iqpool_t** pool, uint32_t maxfree)
+{
+   iqpool_t* allocated_pool = (iqpool_t*) malloc_aligned(sizeof(iqpool_t));
+
+   if (!allocated_pool) {
+      return ENOMEM;
+   }
+
+   memset(allocated_pool, 0, sizeof(iqpool_t));
+   allocated_pool->maxfree = maxfree;
+
+   int err;
+   int i;
+   for (i = 0; i < NROFCLASS; ++i) {
+      err = init_mutex(&allocated_pool->sizeclass[i].lock);
+      if (err) goto ONERR;
+   }
+
+   *pool = allocated_pool;
+
+   return 0;
+ONERR:
+   while (i > 0) {
+      (void) pthread_mutex_destroy(&allocated_pool->sizeclass[--i].lock);
+   }
+   free(allocated_pool);
+   return err;
+}
+
+int delete_iqpool(iqpool_t** pool)
+{
+   int err = 0;
+   int err2;
+
+   if (*pool) {
+      for (int i = 0; i < NROFCLASS; ++i) {
+         iqpoolclass_t* sizeclass = &(*pool)->sizeclass[i];
+         while (sizeclass->free) {
+            iqueue1_t* queue = sizeclass->free;
+            sizeclass->free = (iqueue1_t*) queue->msg[0];
+            queue->msg[0] = 0;
+            err2 = delete_iqueue1(&queue);
+            if (err2) err = err2;
+         }
+         err2 = pthread_mutex_destroy(&sizeclass->lock);
+         if (err2) err = err2;
+      }
+
+      free(*pool);
+
+      *pool = 0;
+   }
+
+   return err;
+}
+
+int get_iqpool(iqpool_t* pool, /*out*/iqueue1_t** queue, iqpos_t capacity)
+{
+   if (capacity == 0) {
+      return EINVAL;
+   }
+
+   int ci = 0;
+   while (((iqpos_t)1 << ci) < capacity) {
+      if (++ci == NROFCLASS) {
+         return EINVAL;
+      }
+   }
+
+   iqpoolclass_t* sizeclass = &pool->sizeclass[ci];
+   iqueue1_t* cached;
+
+   pthread_mutex_lock(&sizeclass->lock);
+   cached = sizeclass->free;
+   if (cached) {
+      sizeclass->free = (iqueue1_t*) cached->msg[0];
+      -- sizeclass->nrfree;
+   }
+   pthread_mutex_unlock(&sizeclass->lock);
+
+   if (cached) {
+      cached->msg[0] = 0;
+      *queue = cached;
+      return 0;
+   }
+
+   return new_iqueue1(queue, (iqpos_t)1 << ci);
+}
+
+void put_iqpool(iqpool_t* pool, iqueue1_t** queue)
+{
+   iqueue1_t* cached = *queue;
+
+   if (!cached) return;
+
+   *queue = 0;
+
+   close_iqueue1(cached);
+
+   iqpos_t capacity = cached->capacity;
+   int ci = 0;
+   while (ci < NROFCLASS && ((iqpos_t)1 << ci) < capacity) {
+      ++ ci;
+   }
+
+   if (  ci < NROFCLASS && ((iqpos_t)1 << ci) == capacity
+         && 0 == reset_iqueue1(cached)) {
+      iqpoolclass_t* sizeclass = &pool->sizeclass[ci];
+
+      pthread_mutex_lock(&sizeclass->lock);
+      if (sizeclass->nrfree < pool->maxfree) {
+         cached->msg[0] = sizeclass->free;
+         sizeclass->free = cached;
+         ++ sizeclass->nrfree;
+         cached = 0;
+      }
+      pthread_mutex_unlock(&sizeclass->lock);
+   }
+
+   if (cached) {
+      (void) delete_iqueue1(&cached);
+   }
+}
+
+// === iqtriple_t ===
+
+// every buffer starts at a cache line boundary
+#ifdef SIZE_CACHELINE
+#define IQTRIPLE_ALIGN ((size_t)SIZE_CACHELINE)
+#else
+#define IQTRIPLE_ALIGN sizeof(void*)
+#endif
+
+int new_iqtriple(/*out*/iqtriple_t** triple, size_t bufsize)
+{
+   if (bufsize == 0 || bufsize > ((size_t)-1 - sizeof(iqtriple_t)) / 4) {
+      return EINVAL;
+   }
+
+   size_t alignedsize = (bufsize + IQTRIPLE_ALIGN-1) & ~(IQTRIPLE_ALIGN-1);
+   size_t triplesize  = sizeof(iqtriple_t) + IQTRIPLE_ALIGN + 3 * alignedsize;
+   iqtriple_t* allocated_triple = (iqtriple_t*) malloc(triplesize);
+
+   if (!allocated_triple) {
+      return ENOMEM;
+   }
+
+   memset(allocated_triple, 0, triplesize);
+   uintptr_t start = ((uintptr_t)(allocated_triple+1) + IQTRIPLE_ALIGN-1) & ~(uintptr_t)(IQTRIPLE_ALIGN-1);
+   allocated_triple->bufsize = bufsize;
+   for (int i = 0; i < 3; ++i) {
+      allocated_triple->buffer[i] = (uint8_t*) start + (size_t)i * alignedsize;
+   }
+   allocated_triple->windex = 0;
+   allocated_triple->state  = 1;
+   allocated_triple->rindex = 2;
+
+   *triple = allocated_triple;
+
+   return 0;
+}
+
+int delete_iqtriple(iqtriple_t** triple)
+{
+   if (*triple) {
+      free(*triple);
+      *triple = 0;
+   }
+
+   return 0;
+}
+
+void publish_iqtriple(iqtriple_t* triple)
+{
+   // full barrier makes content of written buffer visible before it is shared
+   uint32_t oldstate = xchg_atomicu32(&triple->state, triple->windex | IQTRIPLE_FRESH);
+   triple->windex = oldstate & (IQTRIPLE_FRESH-1);
+}
+
+int read_iqtriple(iqtriple_t* triple, /*out*/const void** buf)
+{
+   int err = EAGAIN;
+
+   if (cmpxchg_atomicu32(&triple->state, 0, 0) & IQTRIPLE_FRESH) {
+      uint32_t oldstate = xchg_atomicu32(&triple->state, triple->rindex);
+      triple->rindex = oldstate & (IQTRIPLE_FRESH-1);
+      err = 0;
+   }
+
+   *buf = triple->buffer[triple->rindex];
+
+   return err;
+}
+
+// === iqconflate_t ===
+
+int new_iqconflate(/*out*/iqconflate_t** queue, uint32_t nrkeys)
+{
+   if (  nrkeys == 0 || nrkeys > ((uint32_t)-1)/2
+         || istoolarge(sizeof(iqconflate_t), nrkeys, sizeof(void*))) {
+      return EINVAL;
+   }
+
+   size_t queuesize = sizeof(iqconflate_t) + nrkeys * sizeof(void*);
+   iqconflate_t* allocated_queue = (iqconflate_t*) malloc(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   memset(allocated_queue, 0, queuesize);
+   allocated_queue->nrkeys = nrkeys;
+
+   // every key is stored at most once in keys
+   int err = new_iqueue(&allocated_queue->keys, nrkeys);
+   if (err) {
+      free(allocated_queue);
+      return err;
+   }
+
+   *queue = allocated_queue;
+
+   return 0;
+}
+
+int delete_iqconflate(iqconflate_t** queue)
+{
+   int err = 0;
+
+   if (*queue) {
+      err = delete_iqueue(&(*queue)->keys);
+      free(*queue);
+      *queue = 0;
+   }
+
+   return err;
+}
+
+void close_iqconflate(iqconflate_t* queue)
+{
+   close_iqueue(queue->keys);
+}
+
+int send_iqconflate(iqconflate_t* queue, uint32_t key, void* msg, /*out*/void** replaced)
+{
+   if (0 == msg || key >= queue->nrkeys) {
+      return EINVAL;
+   }
+
+   if (queue->keys->closed) {
+      return EPIPE;
+   }
+
+   void* oldmsg = xchg_atomicptr(&queue->msg[key], msg);
+
+   if (! oldmsg) {
+      // key was not pending ==> append it
+      // keys is never full cause every key is stored at most once
+      int err = send_iqueue(queue->keys, (void*)((uintptr_t)key + 1));
+      if (err) {
+         // closed ==> try to return ownership of msg to caller
+         if (msg == cmpxchg_atomicptr(&queue->msg[key], msg, 0)) {
+            return err;
+         }
+      }
+   }
+
+   if (replaced) *replaced = oldmsg;
+
+   return 0;
+}
+
+int tryrecv_iqconflate(iqconflate_t* queue, /*out*/uint32_t* key, /*out*/void** msg)
+{
+   void* keyplus1;
+
+   int err = tryrecv_iqueue(queue->keys, &keyplus1);
+   if (err) return err;
+
+   // a key is removed from keys before its message is cleared
+   // ==> a concurrent sender either replaces msg or appends key again
+   void* fetchedmsg = xchg_atomicptr(&queue->msg[(uintptr_t)keyplus1 - 1], 0);
+
+   *key = (uint32_t) ((uintptr_t)keyplus1 - 1);
+   *msg = fetchedmsg;
+
+   return 0;
+}
+
+int recv_iqconflate(iqconflate_t* queue, /*out*/uint32_t* key, /*out*/void** msg)
+{
+   void* keyplus1;
+
+   int err = recv_iqueue(queue->keys, &keyplus1);
+   if (err) return err;
+
+   // a key is removed from keys before its message is cleared
+   // ==> a concurrent sender either replaces msg or appends key again
+   void* fetchedmsg = xchg_atomicptr(&queue->msg[(uintptr_t)keyplus1 - 1], 0);
+
+   *key = (uint32_t) ((uintptr_t)keyplus1 - 1);
+   *msg = fetchedmsg;
+
+   return 0;
+}
+
+uint32_t size_iqconflate(const iqconflate_t* queue)
+{
+   return (uint32_t) size_iqueue(queue->keys);
+}
+
+// === iqlossy_t ===
+
+int new_iqlossy(/*out*/iqlossy_t** queue, uint32_t capacity)
+{
+   if (capacity == 0 || capacity > ((uint32_t)-1)/2 + 1) {
+      return EINVAL;
+   }
+
+   uint32_t aligned_capacity = 1;
+   while (aligned_capacity < capacity) {
+      aligned_capacity <<= 1;
+   }
+
+   if (istoolarge(sizeof(iqlossy_t), aligned_capacity, sizeof(iqlossyslot_t))) {
+      return EINVAL;
+   }
+
+   size_t queuesize = sizeof(iqlossy_t) + aligned_capacity * sizeof(iqlossyslot_t);
+   iqlossy_t* allocated_queue = (iqlossy_t*) malloc(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   memset(allocated_queue, 0, queuesize);
+   allocated_queue->capacity = aligned_capacity;
+
+   *queue = allocated_queue;
+
+   return 0;
+}
+
+int delete_iqlossy(iqlossy_t** queue)
+{
+   if (*queue) {
+      close_iqlossy(*queue);
+      free(*queue);
+      *queue = 0;
+   }
+
+   return 0;
+}
+
+void close_iqlossy(iqlossy_t* queue)
+{
+   cmpxchg_atomicu32(&queue->closed, 0, 1);
+}
+
+int send_iqlossy(iqlossy_t* queue, void* msg)
+{
+   if (0 == msg) {
+      return EINVAL;
+   }
+
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   uint64_t pos = queue->writepos;
+   iqlossyslot_t* slot = &queue->msg[pos & (queue->capacity-1)];
+
+   // seqlock: reader detects a concurrently overwritten slot
+   store_atomicu64(&slot->seq, 0);
+   releasefence_atomic();
+   store_atomicptr(&slot->msg, msg);
+   store_atomicu64(&slot->seq, pos+1);
+   store_atomicu64(&queue->writepos, pos+1);
+
+   return 0;
+}
+
+int tryrecv_iqlossy(iqlossy_t* queue, /*out*/void** msg, /*out*/uint64_t* nrlost)
+{
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   uint64_t rpos = queue->readpos;
+
+   for (;;) {
+      uint64_t wpos = load_atomicu64(&queue->writepos);
+
+      if (rpos == wpos) {
+         queue->readpos = rpos;
+         return EAGAIN;
+      }
+
+      if (wpos - rpos > queue->capacity) {
+         // resynchronize with oldest not overwritten message
+         queue->nrlost += wpos - queue->capacity - rpos;
+         rpos = wpos - queue->capacity;
+      }
+
+      iqlossyslot_t* slot = &queue->msg[rpos & (queue->capacity-1)];
+      uint64_t seq = load_atomicu64(&slot->seq);
+      void* fetchedmsg = load_atomicptr(&slot->msg);
+
+      if (seq == rpos+1 && seq == load_atomicu64(&slot->seq)) {
+         queue->readpos = rpos+1;
+         *msg    = fetchedmsg;
+         *nrlost = queue->nrlost;
+         queue->nrlost = 0;
+         return 0;
+      }
+
+      // message at rpos is (being) overwritten by a newer one
+      ++ queue->nrlost;
+      ++ rpos;
+   }
+}
+
+uint32_t size_iqlossy(const iqlossy_t* queue)
+{
+   uint64_t rpos = queue->readpos;
+   uint64_t wpos = load_atomicu64(&queue->writepos);
+
+   return wpos - rpos < queue->capacity ? (uint32_t) (wpos - rpos) : queue->capacity;
+}
+
+// === iqarena_t ===
+
+int init_iqarena(/*out*/iqarena_t* arena, void* base, size_t elemsize, uint32_t nrelem)
+{
+   if (base == 0 || elemsize == 0 || nrelem == 0 || nrelem == (uint32_t)-1) {
+      return EINVAL;
+   }
+
+   arena->base     = base;
+   arena->elemsize = elemsize;
+   arena->nrelem   = nrelem;
+
+   return 0;
+}
+
+// === iqueue1h_t ===
+
+int new_iqueue1h(/*out*/iqueue1h_t** queue, uint32_t capacity, const iqarena_t* arena)
+{
+   if (capacity == 0 || istoolarge(sizeof(iqueue1h_t), capacity, sizeof(uint32_t))) {
+      return EINVAL;
+   }
+
+   size_t queuesize = sizeof(iqueue1h_t) + capacity * sizeof(uint32_t);
+   iqueue1h_t* allocated_queue = (iqueue1h_t*) malloc_aligned(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   memset(allocated_queue, 0, queuesize);
+   allocated_queue->capacity = capacity;
+   allocated_queue->arena    = *arena;
+
+   int err;
+   int initcount = 0;
+
+   err = init_iqsignal(&allocated_queue->reader);
+   if (err) goto ONERR;
+   initcount = 1;
+
+   err = init_iqsignal(&allocated_queue->writer);
+   if (err) goto ONERR;
+   // initcount = 2;
+
+   *queue = allocated_queue;
+
+   return 0; /*OK*/
+ONERR:
+   switch (initcount) {
+   case 1: free_iqsignal(&allocated_queue->reader);
+   case 0: break;
+   }
+   free(allocated_queue);
+   return err;
+}
+
+int delete_iqueue1h(iqueue1h_t** queue)
+{
+   int err = 0;
+   int err2;
+
+   if (*queue) {
+
+      close_iqueue1h(*queue);
+
+      err = free_iqsignal(&(*queue)->writer);
+      err2 = free_iqsignal(&(*queue)->reader);
+      if (err2) err = err2;
+
+      free(*queue);
+
+      *queue = 0;
+   }
+
+   return err;
+}
+
+void close_iqueue1h(iqueue1h_t* queue)
+{
+   close_waiting(&queue->closed, &queue->reader, &queue->writer);
+}
+
+int trysend_iqueue1h(iqueue1h_t* queue, uint32_t handle)
+{
+   if (0 == handle || handle > queue->arena.nrelem) {
+      return EINVAL;
+   }
+
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   uint32_t pos = queue->writepos;
+   uint32_t oldpos = pos;
+   ++pos;
+   if (pos >= queue->capacity) {
+      pos = 0;
+   }
+   queue->writepos = pos;
+
+   if (0 != cmpxchg_atomicu32(&queue->msg[oldpos], 0, handle)) {
+      queue->writepos = oldpos;
+      return EAGAIN;
+   }
+
+   return 0;
+}
+
+int tryrecv_iqueue1h(iqueue1h_t* queue, /*out*/uint32_t* handle)
+{
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   uint32_t pos = queue->readpos;
+   uint32_t oldpos = pos;
+   ++pos;
+   if (pos >= queue->capacity) {
+      pos = 0;
+   }
+   queue->readpos = pos;
+
+   uint32_t fetchedhandle = queue->msg[oldpos];
+
+   if (fetchedhandle != cmpxchg_atomicu32(&queue->msg[oldpos], fetchedhandle, 0) || 0 == fetchedhandle) {
+      queue->readpos = oldpos;
+      return EAGAIN;
+   }
+
+   *handle = fetchedhandle;
+
+   return 0;
+}
+
+int send_iqueue1h(iqueue1h_t* queue, uint32_t handle)
+{
+   int err = trysend_iqueue1h(queue, handle);
+
+   WAKEUP_READER();
+
+   if (EAGAIN == err) {
+      pthread_mutex_lock(&queue->writer.lock);
+      ++ queue->writer.waitcount;
+
+      for (;;) {
+         ++ queue->writer.signalcount;
+         fence_atomic();
+         err = trysend_iqueue1h(queue, handle);
+         if (EAGAIN != err) break;
+         pthread_cond_wait(&queue->writer.cond, &queue->writer.lock);
+      }
+
+      -- queue->writer.waitcount;
+      pthread_mutex_unlock(&queue->writer.lock);
+
+      WAKEUP_READER();
+   }
+
+   return err;
+}
+
+int recv_iqueue1h(iqueue1h_t* queue, /*out*/uint32_t* handle)
+{
+   int err = tryrecv_iqueue1h(queue, handle);
+
+   WAKEUP_WRITER();
+
+   if (EAGAIN == err) {
+      pthread_mutex_lock(&queue->reader.lock);
+      ++ queue->reader.waitcount;
+
+      for (;;) {
+         ++ queue->reader.signalcount;
+         fence_atomic();
+         err = tryrecv_iqueue1h(queue, handle);
+         if (EAGAIN != err) break;
+         pthread_cond_wait(&queue->reader.cond, &queue->reader.lock);
+      }
+
+      -- queue->reader.waitcount;
+      pthread_mutex_unlock(&queue->reader.lock);
+
+      WAKEUP_WRITER();
+   }
+
+   return err;
+}
+
+uint32_t size_iqueue1h(const iqueue1h_t* queue)
+{
+   uint32_t rpos = cmpxchg_atomicu32((uint32_t*)(uintptr_t)&queue->readpos, 0, 0);
+   uint32_t wpos = cmpxchg_atomicu32((uint32_t*)(uintptr_t)&queue->writepos, 0, 0);
+
+   if (rpos < wpos) {
+      return (wpos - rpos);
+
+   } else {
+      uint32_t free = (rpos - wpos);
+      return (free == 0 && 0 == queue->msg[wpos == 0?queue->capacity-1:wpos-1])
+             ? 0
+             : (queue->capacity - free);
+   }
+}
+
+// === iqueuec_t ===
+
+int new_iqueuec(/*out*/iqueuec_t** queue, uint32_t capacity)
+{
+   if (capacity == 0 || istoolarge(sizeof(iqueuec_t), capacity, sizeof(void*))) {
+      return EINVAL;
+   }
+
+   size_t queuesize = sizeof(iqueuec_t) + capacity * sizeof(void*);
+   iqueuec_t* allocated_queue = (iqueuec_t*) malloc(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   memset(allocated_queue, 0, queuesize);
+   allocated_queue->capacity = capacity;
+   allocated_queue->sizefree = capacity;
+
+   int err = init_iqsignal(&allocated_queue->waiter);
+   if (err) {
+      free(allocated_queue);
+      return err;
+   }
+
+   *queue = allocated_queue;
+
+   return 0;
+}
+
+int delete_iqueuec(iqueuec_t** queue)
+{
+   int err = 0;
+
+   if (*queue) {
+
+      close_iqueuec(*queue);
+
+      err = free_iqsignal(&(*queue)->waiter);
+
+      free(*queue);
+
+      *queue = 0;
+   }
+
+   return err;
+}
+
+void close_iqueuec(iqueuec_t* queue)
+{
+   pthread_mutex_lock(&queue->waiter.lock);
+   queue->closed = 1;
+   pthread_mutex_unlock(&queue->waiter.lock);
+
+   // Wait until reader/writer woken up
+   for (;;) {
+      pthread_mutex_lock(&queue->waiter.lock);
+      pthread_cond_broadcast(&queue->waiter.cond);
+      size_t iswaiter = queue->waiter.waitcount;
+      pthread_mutex_unlock(&queue->waiter.lock);
+
+      if (!iswaiter) break;
+
+      sched_yield();
+   }
+}
+
+// Decrements *size if it is not 0. Returns 0 in case of success else EAGAIN.
+static inline int trydecrement(uint32_t* size)
+{
+   for (;;) {
+      uint32_t oldsize = *size;
+      if (0 == oldsize) return EAGAIN;
+      if (oldsize == cmpxchg_atomicu32(size, oldsize, oldsize-1)) return 0;
+   }
+}
+
+// Returns *pos and increments *pos modulo capacity.
+static inline uint32_t nextpos(uint32_t* pos, uint32_t capacity)
+{
+   for (;;) {
+      uint32_t oldpos = *pos;
+      uint32_t newpos = oldpos+1 < capacity ? oldpos+1 : 0;
+      if (oldpos == cmpxchg_atomicu32(pos, oldpos, newpos)) return oldpos;
+   }
+}
+
+int trysend_iqueuec(iqueuec_t* queue, void* msg)
+{
+   if (0 == msg) {
+      return EINVAL;
+   }
+
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   if (trydecrement(&queue->sizefree)) {
+      return EAGAIN;
+   }
+
+   uint32_t pos = nextpos(&queue->writepos, queue->capacity);
+
+   // wait for reader which has not cleared slot yet
+   while (0 != cmpxchg_atomicptr(&queue->msg[pos], 0, msg)) ;
+
+   fetchadd_atomicu32(&queue->sizeused, 1);
+
+   return 0;
+}
+
+int tryrecv_iqueuec(iqueuec_t* queue, /*out*/void** msg)
+{
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   if (trydecrement(&queue->sizeused)) {
+      return EAGAIN;
+   }
+
+   uint32_t pos = nextpos(&queue->readpos, queue->capacity);
+
+   // wait for writer which has not set slot yet
+   void* fetchedmsg;
+   do {
+      fetchedmsg = queue->msg[pos];
+   } while (fetchedmsg != cmpxchg_atomicptr(&queue->msg[pos], fetchedmsg, 0) || 0 == fetchedmsg);
+
+   *msg = fetchedmsg;
+
+   fetchadd_atomicu32(&queue->sizefree, 1);
+
+   return 0;
+}
+
+// Readers and writers wait on the same iqsignal_t (see also WAKEUP_READER).
+#define WAKEUP_WAITER() \
+   if (!err && queue->waiter.signalcount) {      \
+      pthread_mutex_lock(&queue->waiter.lock);   \
+      if (queue->waiter.signalcount) {           \
+         queue->waiter.signalcount = 0;          \
+         pthread_cond_broadcast(&queue->waiter.cond); \
+      }                                          \
+      pthread_mutex_unlock(&queue->waiter.lock); \
+   }
+
+int send_iqueuec(iqueuec_t* queue, void* msg)
+{
+   int err = trysend_iqueuec(queue, msg);
+
+   if (EAGAIN == err) {
+      pthread_mutex_lock(&queue->waiter.lock);
+      ++ queue->waiter.waitcount;
+
+      for (;;) {
+         ++ queue->waiter.signalcount;
+         fence_atomic();
+         err = trysend_iqueuec(queue, msg);
+         if (EAGAIN != err) break;
+         pthread_cond_wait(&queue->waiter.cond, &queue->waiter.lock);
+      }
+
+      -- queue->waiter.waitcount;
+      pthread_mutex_unlock(&queue->waiter.lock);
+   }
+
+   WAKEUP_WAITER();
+
+   return err;
+}
+
+int recv_iqueuec(iqueuec_t* queue, /*out*/void** msg)
+{
+   int err = tryrecv_iqueuec(queue, msg);
+
+   if (EAGAIN == err) {
+      pthread_mutex_lock(&queue->waiter.lock);
+      ++ queue->waiter.waitcount;
+
+      for (;;) {
+         ++ queue->waiter.signalcount;
+         fence_atomic();
+         err = tryrecv_iqueuec(queue, msg);
+         if (EAGAIN != err) break;
+         pthread_cond_wait(&queue->waiter.cond, &queue->waiter.lock);
+      }
+
+      -- queue->waiter.waitcount;
+      pthread_mutex_unlock(&queue->waiter.lock);
+   }
+
+   WAKEUP_WAITER();
+
+   return err;
+}
+
+uint32_t size_iqueuec(const iqueuec_t* queue)
+{
+   uint32_t sizeused = cmpxchg_atomicu32((uint32_t*)(uintptr_t)&queue->sizeused, 0, 0);
+   return sizeused <= queue->capacity ? sizeused : queue->capacity;
+}
+
+// === iqmpsc_t ===
+
+void init_iqmpsc(/*out*/iqmpsc_t* queue)
+{
+   queue->stub.next = 0;
+   queue->head = &queue->stub;
+   store_atomicptr((void**)&queue->tail, &queue->stub);
+}
+
+void send_iqmpsc(iqmpsc_t* queue, iqnode_t* node)
+{
+   node->next = 0;
+   // full barrier makes node->next = 0 visible before node is reachable
+   iqnode_t* prev = (iqnode_t*) xchg_atomicptr((void**)&queue->tail, node);
+   // between exchange and store the list is broken and the reader sees an empty queue
+   store_atomicptr((void**)&prev->next, node);
+}
+
+int tryrecv_iqmpsc(iqmpsc_t* queue, /*out*/iqnode_t** node)
+{
+   iqnode_t* head = queue->head;
+   iqnode_t* next = (iqnode_t*) load_atomicptr((void**)&head->next);
+
+   if (head == &queue->stub) {
+      if (0 == next) return EAGAIN;
+      // skip stub
+      queue->head = next;
+      head = next;
+      next = (iqnode_t*) load_atomicptr((void**)&head->next);
+   }
+
+   if (0 == next) {
+      if (head != load_atomicptr((void**)&queue->tail)) {
+         return EAGAIN; // writer has not linked its node yet
+      }
+      // head is last node ==> re-insert stub to keep list non empty
+      send_iqmpsc(queue, &queue->stub);
+      next = (iqnode_t*) load_atomicptr((void**)&head->next);
+      if (0 == next) {
+         return EAGAIN; // another writer exchanged tail before stub
+      }
+   }
+
+   queue->head = next;
+   *node = head;
+
+   return 0;
+}
+
+int isempty_iqmpsc(const iqmpsc_t* queue)
+{
+   const iqnode_t* head = queue->head;
+   return head == &queue->stub
+          && 0 == load_atomicptr((void* const*)&head->next);
+}
+
+// === iqturn_t ===
+
+// Sleeps until *addr is changed from value and the sleeping thread is woken up.
+// Returns at once if *addr != value. Without futex support the thread only yields the processor.
+static void wait_futex(uint32_t* addr, uint32_t value)
+{
+#ifdef __linux__
+   syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, 0, 0, 0);
+#else
+   (void) addr;
+   (void) value;
+   sched_yield();
+#endif
+}
+
+// Wakes up all threads sleeping on addr.
+static void wake_futex(uint32_t* addr)
+{
+#ifdef __linux__
+   syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+#else
+   (void) addr;
+#endif
+}
+
+// turn of the slot of pos which allows the writer of pos to fill it
+static inline uint32_t writeturn_iqturn(const iqturn_t* queue, uint64_t pos)
+{
+   return 2 * (uint32_t) (pos / queue->capacity);
+}
+
+// Sets turn of slot and wakes up threads sleeping on it.
+// The full barrier between store and load of waiters pairs with the one in waitturn.
+static inline void nextturn_iqturn(iqturnslot_t* slot, uint32_t turn)
+{
+   store_atomicu32(&slot->turn, turn);
+   fence_atomic();
+   if (slot->waiters) {
+      wake_futex(&slot->turn);
+   }
+}
+
+// Sleeps on the futex of slot until its turn equals turn.
+// EPIPE is returned if queue is closed.
+// The caller must be counted in queue->nrwaiting, else close_iqturn could free the queue.
+static int waitturn_iqturn(iqturn_t* queue, iqturnslot_t* slot, uint32_t turn)
+{
+   for (;;) {
+      uint32_t current = load_atomicu32(&slot->turn);
+      if (current == turn) return 0;
+      if (queue->closed) return EPIPE;
+      fetchadd_atomicu32(&slot->waiters, 1);
+      current = load_atomicu32(&slot->turn);
+      if (current != turn && ! queue->closed) {
+         wait_futex(&slot->turn, current);
+      }
+      fetchadd_atomicu32(&slot->waiters, (uint32_t)-1);
+   }
+}
+
+// Counts the calling thread in nrwaiting and returns EPIPE if queue is closed.
+// The full barrier of the increment pairs with the one in close_iqturn:
+// either close sees the thread or the thread sees closed.
+static inline int enterwait_iqturn(iqturn_t* queue)
+{
+   fetchadd_atomicu32(&queue->nrwaiting, 1);
+   return queue->closed ? EPIPE : 0;
+}
+
+// Removes the calling thread from nrwaiting. Afterwards queue may be freed.
+static inline void leavewait_iqturn(iqturn_t* queue)
+{
+   fetchadd_atomicu32(&queue->nrwaiting, (uint32_t)-1);
+}
+
+int new_iqturn(/*out*/iqturn_t** queue, uint32_t capacity)
+{
+   if (capacity == 0 || capacity > ((uint32_t)-1)/2 + 1) {
+      return EINVAL;
+   }
+
+   uint32_t aligned_capacity = 1;
+   while (aligned_capacity < capacity) {
+      aligned_capacity <<= 1;
+   }
+
+   if (istoolarge(sizeof(iqturn_t), aligned_capacity, sizeof(iqturnslot_t))) {
+      return EINVAL;
+   }
+
+   size_t queuesize = sizeof(iqturn_t) + aligned_capacity * sizeof(iqturnslot_t);
+   iqturn_t* allocated_queue = (iqturn_t*) malloc_aligned(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   memset(allocated_queue, 0, queuesize);
+   allocated_queue->capacity = aligned_capacity;
+
+   *queue = allocated_queue;
+
+   return 0;
+}
+
+int delete_iqturn(iqturn_t** queue)
+{
+   if (*queue) {
+      close_iqturn(*queue);
+      free(*queue);
+      *queue = 0;
+   }
+
+   return 0;
+}
+
+void close_iqturn(iqturn_t* queue)
+{
+   // full barrier pairs with the ones in enterwait_iqturn and waitturn_iqturn
+   xchg_atomicu32(&queue->closed, 1);
+
+   // Wait until reader/writer woken up and returned
+   while (load_atomicu32(&queue->nrwaiting)) {
+      for (uint32_t i = 0; i < queue->capacity; ++i) {
+         if (load_atomicu32(&queue->slot[i].waiters)) {
+            wake_futex(&queue->slot[i].turn);
+         }
+      }
+
+      sched_yield();
+   }
+}
+
+int trysend_iqturn(iqturn_t* queue, void* msg)
+{
+   if (0 == msg) {
+      return EINVAL;
+   }
+
+   uint64_t pos = load_atomicu64(&queue->writepos);
+
+   for (;;) {
+      if (queue->closed) return EPIPE;
+      iqturnslot_t* slot = &queue->slot[pos & (queue->capacity-1)];
+      uint32_t turn = writeturn_iqturn(queue, pos);
+      if (turn == load_atomicu32(&slot->turn)) {
+         uint64_t oldpos = cmpxchg_atomicu64(&queue->writepos, pos, pos+1);
+         if (oldpos == pos) {
+            slot->msg = msg;
+            nextturn_iqturn(slot, turn+1);
+            return 0;
+         }
+         pos = oldpos;
+      } else {
+         uint64_t oldpos = pos;
+         pos = load_atomicu64(&queue->writepos);
+         if (oldpos == pos) return EAGAIN;
+      }
+   }
+}
+
+int send_iqturn(iqturn_t* queue, void* msg)
+{
+   if (0 == msg) {
+      return EINVAL;
+   }
+
+   int err = enterwait_iqturn(queue);
+
+   if (!err) {
+      uint64_t pos = fetchadd_atomicu64(&queue->writepos, 1);
+      iqturnslot_t* slot = &queue->slot[pos & (queue->capacity-1)];
+      uint32_t turn = writeturn_iqturn(queue, pos);
+
+      err = waitturn_iqturn(queue, slot, turn);
+      if (!err) {
+         slot->msg = msg;
+         nextturn_iqturn(slot, turn+1);
+      }
+   }
+
+   leavewait_iqturn(queue);
+
+   return err;
+}
+
+int tryrecv_iqturn(iqturn_t* queue, /*out*/void** msg)
+{
+   uint64_t pos = load_atomicu64(&queue->readpos);
+
+   for (;;) {
+      if (queue->closed) return EPIPE;
+      iqturnslot_t* slot = &queue->slot[pos & (queue->capacity-1)];
+      uint32_t turn = writeturn_iqturn(queue, pos) + 1;
+      if (turn == load_atomicu32(&slot->turn)) {
+         uint64_t oldpos = cmpxchg_atomicu64(&queue->readpos, pos, pos+1);
+         if (oldpos == pos) {
+            *msg = slot->msg;
+            nextturn_iqturn(slot, turn+1);
+            return 0;
+         }
+         pos = oldpos;
+      } else {
+         uint64_t oldpos = pos;
+         pos = load_atomicu64(&queue->readpos);
+         if (oldpos == pos) return EAGAIN;
+      }
+   }
+}
+
+int recv_iqturn(iqturn_t* queue, /*out*/void** msg)
+{
+   int err = enterwait_iqturn(queue);
+
+   if (!err) {
+      uint64_t pos = fetchadd_atomicu64(&queue->readpos, 1);
+      iqturnslot_t* slot = &queue->slot[pos & (queue->capacity-1)];
+      uint32_t turn = writeturn_iqturn(queue, pos) + 1;
+
+      err = waitturn_iqturn(queue, slot, turn);
+      if (!err) {
+         *msg = slot->msg;
+         nextturn_iqturn(slot, turn+1);
+      }
+   }
+
+   leavewait_iqturn(queue);
+
+   return err;
+}
+
+uint32_t size_iqturn(const iqturn_t* queue)
+{
+   uint64_t readpos  = load_atomicu64(&queue->readpos);
+   uint64_t writepos = load_atomicu64(&queue->writepos);
+   if (writepos <= readpos) return 0;
+   return writepos - readpos < queue->capacity ? (uint32_t) (writepos - readpos) : queue->capacity;
+}
+
+// === iqnuma_t ===
+
+// Returns highest id + 1 of the possible NUMA nodes or 1 if it could not be determined.
+// The file contains a list of ranges like "0" or "0-3" or "0,2-3".
+static uint32_t nrnode_sysfs(void)
+{
+   uint32_t nrnode = 1;
+#ifdef __linux__
+   char buf[64];
+   int fd = open("/sys/devices/system/node/possible", O_RDONLY|O_CLOEXEC);
+   if (fd == -1) return nrnode;
+   ssize_t len = read(fd, buf, sizeof(buf)-1);
+   close(fd);
+   uint32_t id = 0;
+   for (ssize_t i = 0; i < len; ++i) {
+      if ('0' <= buf[i] && buf[i] <= '9') {
+         id = 10 * id + (uint32_t) (buf[i] - '0');
+         if (id >= 1024) return nrnode;
+         if (id >= nrnode) nrnode = id + 1;
+      } else {
+         id = 0;
+      }
+   }
+#endif
+   return nrnode;
+}
+
+int new_iqnuma(/*out*/iqnuma_t** queue, uint32_t nrnode, iqpos_t capacity)
+{
+   if (nrnode == 0) {
+      nrnode = nrnode_sysfs();
+   }
+
+   if (nrnode > 1024) {
+      return EINVAL;
+   }
+
+   size_t queuesize = sizeof(iqnuma_t) + nrnode * sizeof(iqueue_t*);
+   iqnuma_t* allocated_queue = (iqnuma_t*) malloc_aligned(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   memset(allocated_queue, 0, queuesize);
+   allocated_queue->nrnode = nrnode;
+
+   int err;
+   uint32_t initcount = 0;
+
+   err = init_iqsignal(&allocated_queue->reader);
+   if (err) goto ONERR;
+   initcount = 1;
+
+   err = init_iqsignal(&allocated_queue->writer);
+   if (err) goto ONERR;
+   initcount = 2;
+
+   for (uint32_t i = 0; i < nrnode; ++i) {
+      err = new_iqueue(&allocated_queue->node[i], capacity);
+      if (err) goto ONERR;
+   }
+
+   *queue = allocated_queue;
+
+   return 0; /*OK*/
+ONERR:
+   for (uint32_t i = 0; i < nrnode; ++i) {
+      delete_iqueue(&allocated_queue->node[i]);
+   }
+   switch (initcount) {
+   case 2: free_iqsignal(&allocated_queue->writer);
+   // fall through
+   case 1: free_iqsignal(&allocated_queue->reader);
+   case 0: break;
+   }
+   free(allocated_queue);
+   return err;
+}
+
+int delete_iqnuma(iqnuma_t** queue)
+{
+   int err = 0;
+   int err2;
+
+   if (*queue) {
+
+      close_iqnuma(*queue);
+
+      for (uint32_t i = 0; i < (*queue)->nrnode; ++i) {
+         err2 = delete_iqueue(&(*queue)->node[i]);
+         if (err2) err = err2;
+      }
+      err2 = free_iqsignal(&(*queue)->writer);
+      if (err2) err = err2;
+      err2 = free_iqsignal(&(*queue)->reader);
+      if (err2) err = err2;
+
+      free(*queue);
+
+      *queue = 0;
+   }
+
+   return err;
+}
+
+void close_iqnuma(iqnuma_t* queue)
+{
+   for (uint32_t i = 0; i < queue->nrnode; ++i) {
+      close_iqueue(queue->node[i]);
+   }
+   close_waiting(&queue->closed, &queue->reader, &queue->writer);
+}
+
+uint32_t node_iqnuma(const iqnuma_t* queue)
+{
+   unsigned cpu;
+   unsigned node = 0;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+   // uses vDSO, no system call
+   if (0 != getcpu(&cpu, &node)) node = 0;
+#elif defined(__linux__)
+   if (0 != syscall(SYS_getcpu, &cpu, &node, 0)) node = 0;
+#else
+   (void) cpu;
+#endif
+   return node < queue->nrnode ? node : node % queue->nrnode;
+}
+
+int trysend_iqnuma(iqnuma_t* queue, void* msg)
+{
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   uint32_t local = node_iqnuma(queue);
+   uint32_t i = local;
+
+   do {
+      int err = trysend_iqueue(queue->node[i], msg);
+      if (EAGAIN != err) return err;
+      if (++i == queue->nrnode) i = 0;
+   } while (i != local);
+
+   return EAGAIN;
+}
+
+int tryrecv_iqnuma(iqnuma_t* queue, /*out*/void** msg)
+{
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   uint32_t local = node_iqnuma(queue);
+   uint32_t i = local;
+
+   do {
+      int err = tryrecv_iqueue(queue->node[i], msg);
+      if (EAGAIN != err) return err;
+      if (++i == queue->nrnode) i = 0;
+   } while (i != local);
+
+   return EAGAIN;
+}
+
+int send_iqnuma(iqnuma_t* queue, void* msg)
+{
+   int err = trysend_iqnuma(queue, msg);
+
+   WAKEUP_READER();
+
+   if (EAGAIN == err) {
+      pthread_mutex_lock(&queue->writer.lock);
+      ++ queue->writer.waitcount;
+
+      for (;;) {
+         ++ queue->writer.signalcount;
+         fence_atomic();
+         err = trysend_iqnuma(queue, msg);
+         if (EAGAIN != err) break;
+         wait_signal(&queue->writer, 0);
+      }
+
+      -- queue->writer.waitcount;
+      pthread_mutex_unlock(&queue->writer.lock);
+
+      WAKEUP_READER();
+   }
+
+   return err;
+}
+
+int recv_iqnuma(iqnuma_t* queue, /*out*/void** msg)
+{
+   int err = tryrecv_iqnuma(queue, msg);
+
+   WAKEUP_WRITER();
+
+   if (EAGAIN == err) {
+      pthread_mutex_lock(&queue->reader.lock);
+      ++ queue->reader.waitcount;
+
+      for (;;) {
+         ++ queue->reader.signalcount;
+         fence_atomic();
+         err = tryrecv_iqnuma(queue, msg);
+         if (EAGAIN != err) break;
+         wait_signal(&queue->reader, 0);
+      }
+
+      -- queue->reader.waitcount;
+      pthread_mutex_unlock(&queue->reader.lock);
+
+      WAKEUP_WRITER();
+   }
+
+   return err;
+}
+
+iqpos_t size_iqnuma(const iqnuma_t* queue)
+{
+   iqpos_t size = 0;
+   for (uint32_t i = 0; i < queue->nrnode; ++i) {
+      size += size_iqueue(queue->node[i]);
+   }
+   return size;
+}
+
+// === iqscq_t ===
+
+#define SCQ_EMPTY    ((uint32_t)-1)
+#define SCQ_SAFE     ((uint64_t)1 << 32)
+#define SCQ_CYCLE(e) ((uint32_t) ((e) >> 33))
+#define SCQ_INDEX(e) ((uint32_t) (e))
+#define SCQ_ENTRY(cycle, safe, index) (((uint64_t)(cycle) << 33) | ((safe) ? SCQ_SAFE : 0) | (index))
+
+// Returns cycle of position pos of a ring with (1 << order) entries.
+static inline uint32_t cycle_iqscq(uint64_t pos, uint32_t order)
+{
+   return (uint32_t) (pos >> order) & 0x7fffffff;
+}
+
+// Returns < 0 if cycle1 is before cycle2, 0 if they are equal and > 0 else. Handles wrap around of 31 bit.
+static inline int32_t cmpcycle_iqscq(uint32_t cycle1, uint32_t cycle2)
+{
+   return (int32_t) ((cycle1 - cycle2) << 1);
+}
+
+// Maps pos to entry index so that consecutive positions are stored on different cache lines.
+static inline uint64_t remap_iqscq(uint64_t pos, uint32_t order)
+{
+   const uint32_t lineorder = 3; // 8 entries per cache line
+   pos &= ((uint64_t)1 << order) - 1;
+   if (order <= lineorder) return pos;
+   uint32_t nrlineorder = order - lineorder;
+   return ((pos & (((uint64_t)1 << nrlineorder) - 1)) << lineorder) | (pos >> nrlineorder);
+}
+
+// Stores index into ring. Never fails cause the ring has twice as many entries as indices.
+static void enqueue_iqscq(iqscqring_t* ring, uint32_t order, int64_t threshold3, uint32_t index)
+{
+   for (;;) {
+      uint64_t tail = fetchadd_atomicu64(&ring->tail, 1);
+      uint64_t* entry = &ring->entry[remap_iqscq(tail, order)];
+      uint32_t cycle = cycle_iqscq(tail, order);
+      uint64_t e = load_atomicu64(entry);
+
+      // a non safe entry is only reused if no receiver could have skipped it
+      while (cmpcycle_iqscq(SCQ_CYCLE(e), cycle) < 0 && SCQ_INDEX(e) == SCQ_EMPTY
+             && ((e & SCQ_SAFE) || load_atomicu64(&ring->head) <= tail)) {
+         uint64_t olde = e;
+         e = cmpxchg_atomicu64(entry, olde, SCQ_ENTRY(cycle, 1, index));
+         if (e == olde) {
+            if ((int64_t) load_atomicu64((uint64_t*)&ring->threshold) != threshold3) {
+               store_atomicu64((uint64_t*)&ring->threshold, (uint64_t)threshold3);
+            }
+            return;
+         }
+      }
+   }
+}
+
+// Sets tail to head if receivers overtook the senders.
+static void catchup_iqscq(iqscqring_t* ring, uint64_t tail, uint64_t head)
+{
+   while (tail != cmpxchg_atomicu64(&ring->tail, tail, head)) {
+      head = load_atomicu64(&ring->head);
+      tail = load_atomicu64(&ring->tail);
+      if (tail >= head) break;
+   }
+}
+
+// Removes next index from ring. Returns SCQ_EMPTY if ring is empty.
+// The threshold bounds the number of failed tries after the last enqueue (livelock freedom).
+static uint32_t dequeue_iqscq(iqscqring_t* ring, uint32_t order)
+{
+   if ((int64_t) load_atomicu64((uint64_t*)&ring->threshold) < 0) {
+      return SCQ_EMPTY;
+   }
+
+   for (;;) {
+      uint64_t head = fetchadd_atomicu64(&ring->head, 1);
+      uint64_t* entry = &ring->entry[remap_iqscq(head, order)];
+      uint32_t cycle = cycle_iqscq(head, order);
+      uint64_t e = load_atomicu64(entry);
+
+      for (;;) {
+         if (SCQ_CYCLE(e) == cycle) {
+            fetchor_atomicu64(entry, SCQ_EMPTY);
+            return SCQ_INDEX(e);
+         }
+         if (cmpcycle_iqscq(SCQ_CYCLE(e), cycle) > 0) break;
+         // entry of older cycle: empty one is advanced to cycle, filled one marked unsafe for its late receiver
+         uint64_t newe = SCQ_INDEX(e) == SCQ_EMPTY ? SCQ_ENTRY(cycle, (e & SCQ_SAFE), SCQ_EMPTY) : (e & ~SCQ_SAFE);
+         uint64_t olde = e;
+         e = cmpxchg_atomicu64(entry, olde, newe);
+         if (e == olde) break;
+      }
+
+      uint64_t tail = load_atomicu64(&ring->tail);
+      if (tail <= head + 1) {
+         catchup_iqscq(ring, tail, head + 1);
+         fetchadd_atomicu64((uint64_t*)&ring->threshold, (uint64_t)-1);
+         return SCQ_EMPTY;
+      }
+      if ((int64_t) fetchadd_atomicu64((uint64_t*)&ring->threshold, (uint64_t)-1) <= 0) {
+         return SCQ_EMPTY;
+      }
+   }
+}
+
+int new_iqscq(/*out*/iqscq_t** queue, uint32_t capacity)
+{
+   if (capacity == 0 || capacity > ((uint32_t)1 << 30)) {
+      return EINVAL;
+   }
+
+   uint32_t order = 1;
+   while (((uint32_t)1 << (order-1)) < capacity) {
+      ++order;
+   }
+   capacity = (uint32_t)1 << (order-1);
+
+   size_t nrentry = (size_t)2 * capacity;
+   size_t queuesize = sizeof(iqscq_t) + capacity * sizeof(void*) + 2 * nrentry * sizeof(uint64_t);
+   iqscq_t* allocated_queue = (iqscq_t*) malloc_aligned(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   memset(allocated_queue, 0, sizeof(iqscq_t) + capacity * sizeof(void*));
+   allocated_queue->capacity = capacity;
+   allocated_queue->order = order;
+   allocated_queue->aq.entry = (uint64_t*) &allocated_queue->msg[capacity];
+   allocated_queue->fq.entry = allocated_queue->aq.entry + nrentry;
+   // all entries empty with cycle -1
+   memset(allocated_queue->aq.entry, 0xff, 2 * nrentry * sizeof(uint64_t));
+   // aq is empty
+   allocated_queue->aq.threshold = -1;
+   // fq contains all indices of msg
+   for (uint32_t i = 0; i < capacity; ++i) {
+      allocated_queue->fq.entry[remap_iqscq(i, order)] = SCQ_ENTRY(0, 1, i);
+   }
+   allocated_queue->fq.tail = capacity;
+   allocated_queue->fq.threshold = 3 * (int64_t)capacity - 1;
+
+   int err;
+   int initcount = 0;
+
+   err = init_iqsignal(&allocated_queue->reader);
+   if (err) goto ONERR;
+   initcount = 1;
+
+   err = init_iqsignal(&allocated_queue->writer);
    if (err) goto ONERR;
    // initcount = 2;
 
@@ -172,205 +3344,600 @@ ONERR:
    return err;
 }
 
-int delete_iqueue(iqueue_t** queue)
+int delete_iqscq(iqscq_t** queue)
 {
    int err = 0;
    int err2;
 
    if (*queue) {
 
-      close_iqueue(*queue);
+      close_iqscq(*queue);
+
+      err = free_iqsignal(&(*queue)->writer);
+      err2 = free_iqsignal(&(*queue)->reader);
+      if (err2) err = err2;
+
+      free(*queue);
+
+      *queue = 0;
+   }
+
+   return err;
+}
+
+void close_iqscq(iqscq_t* queue)
+{
+   close_waiting(&queue->closed, &queue->reader, &queue->writer);
+}
+
+int trysend_iqscq(iqscq_t* queue, void* msg)
+{
+   if (0 == msg) {
+      return EINVAL;
+   }
+
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   uint32_t index = dequeue_iqscq(&queue->fq, queue->order);
+   if (index == SCQ_EMPTY) {
+      return EAGAIN;
+   }
+
+   queue->msg[index] = msg;
+   enqueue_iqscq(&queue->aq, queue->order, 3 * (int64_t)queue->capacity - 1, index);
+
+   return 0;
+}
+
+int tryrecv_iqscq(iqscq_t* queue, /*out*/void** msg)
+{
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   uint32_t index = dequeue_iqscq(&queue->aq, queue->order);
+   if (index == SCQ_EMPTY) {
+      return EAGAIN;
+   }
+
+   *msg = queue->msg[index];
+   enqueue_iqscq(&queue->fq, queue->order, 3 * (int64_t)queue->capacity - 1, index);
+
+   return 0;
+}
+
+int send_iqscq(iqscq_t* queue, void* msg)
+{
+   int err = trysend_iqscq(queue, msg);
+
+   WAKEUP_READER();
+
+   if (EAGAIN == err) {
+      pthread_mutex_lock(&queue->writer.lock);
+      ++ queue->writer.waitcount;
+
+      for (;;) {
+         ++ queue->writer.signalcount;
+         fence_atomic();
+         err = trysend_iqscq(queue, msg);
+         if (EAGAIN != err) break;
+         wait_signal(&queue->writer, 0);
+      }
+
+      -- queue->writer.waitcount;
+      pthread_mutex_unlock(&queue->writer.lock);
+
+      WAKEUP_READER();
+   }
+
+   return err;
+}
+
+int recv_iqscq(iqscq_t* queue, /*out*/void** msg)
+{
+   int err = tryrecv_iqscq(queue, msg);
+
+   WAKEUP_WRITER();
+
+   if (EAGAIN == err) {
+      pthread_mutex_lock(&queue->reader.lock);
+      ++ queue->reader.waitcount;
+
+      for (;;) {
+         ++ queue->reader.signalcount;
+         fence_atomic();
+         err = tryrecv_iqscq(queue, msg);
+         if (EAGAIN != err) break;
+         wait_signal(&queue->reader, 0);
+      }
+
+      -- queue->reader.waitcount;
+      pthread_mutex_unlock(&queue->reader.lock);
+
+      WAKEUP_WRITER();
+   }
+
+   return err;
+}
+
+uint32_t size_iqscq(const iqscq_t* queue)
+{
+   uint64_t head = load_atomicu64(&queue->aq.head);
+   uint64_t tail = load_atomicu64(&queue->aq.tail);
+   if (tail <= head) return 0;
+   return tail - head < queue->capacity ? (uint32_t) (tail - head) : queue->capacity;
+}
+
+// === iqwf_t ===
+
+#define WF_RECORD(queue, index) ((iqwfstate_t*) ((queue)->records + (size_t)(index) * (queue)->recordsize))
+
+// Returns the msg slots of state.
+static inline void** slot_iqwf(const iqwf_t* queue, iqwfstate_t* state)
+{
+   return &state->ret[queue->nrthread];
+}
+
+int new_iqwf(/*out*/iqwf_t** queue, uint32_t capacity, uint32_t nrthread)
+{
+   if (capacity == 0 || capacity > 65536 || nrthread == 0 || nrthread > 64) {
+      return EINVAL;
+   }
+
+   uint32_t aligned_capacity = 1;
+   while (aligned_capacity < capacity) {
+      aligned_capacity <<= 1;
+   }
+
+   size_t recordsize = sizeof(iqwfstate_t) + (nrthread + aligned_capacity) * sizeof(void*);
+   recordsize = (recordsize + SIZE_CACHELINE - 1) / SIZE_CACHELINE * SIZE_CACHELINE;
+   size_t headsize = sizeof(iqwf_t) + nrthread * sizeof(iqwfthread_t);
+   headsize = (headsize + SIZE_CACHELINE - 1) / SIZE_CACHELINE * SIZE_CACHELINE;
+   size_t recordssize = (2 * nrthread + 1) * recordsize;
+   size_t queuesize = headsize + recordssize + nrthread * nrthread * sizeof(void*);
+   iqwf_t* allocated_queue = (iqwf_t*) malloc_aligned(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   memset(allocated_queue, 0, queuesize);
+   allocated_queue->capacity = aligned_capacity;
+   allocated_queue->nrthread = nrthread;
+   allocated_queue->recordsize = (uint32_t) recordsize;
+   allocated_queue->records = (uint8_t*)allocated_queue + headsize;
+   allocated_queue->result = (void**) (allocated_queue->records + recordssize);
+   // initial record is the last one and is never reused
+   allocated_queue->state = 2 * nrthread;
+
+   *queue = allocated_queue;
+
+   return 0;
+}
+
+int delete_iqwf(iqwf_t** queue)
+{
+   if (*queue) {
+      free(*queue);
+      *queue = 0;
+   }
+
+   return 0;
+}
+
+void close_iqwf(iqwf_t* queue)
+{
+   store_atomicu32(&queue->closed, 1);
+}
+
+// Copies the state of record from into to. Only the stored messages are copied.
+// from could be overwritten concurrently, readpos and writepos are checked so that no access is out of bounds.
+static void copy_iqwf(const iqwf_t* queue, iqwfstate_t* to, iqwfstate_t* from)
+{
+   const uint32_t mask = queue->capacity - 1;
+   void** toslot = slot_iqwf(queue, to);
+   void** fromslot = slot_iqwf(queue, from);
+   memcpy(to, from, sizeof(iqwfstate_t) + queue->nrthread * sizeof(void*));
+   uint64_t size = to->writepos - to->readpos;
+   if (size > queue->capacity) size = queue->capacity;
+   for (uint64_t pos = to->readpos, end = to->readpos + size; pos != end; ++pos) {
+      toslot[pos & mask] = fromslot[pos & mask];
+   }
+}
+
+// Applies all operations announced in toggles which are not applied in state.
+static void apply_iqwf(iqwf_t* queue, iqwfstate_t* state, uint64_t toggles)
+{
+   const uint32_t mask = queue->capacity - 1;
+   void** slot = slot_iqwf(queue, state);
+   uint64_t pending = toggles ^ state->applied;
+
+   for (uint32_t t = 0; pending; ++t, pending >>= 1) {
+      if (0 == (pending & 1)) continue;
+      void* msg = load_atomicptr(&queue->thread[t].msg);
+      if (msg) {
+         if (state->writepos - state->readpos < queue->capacity) {
+            slot[state->writepos++ & mask] = msg;
+            state->ret[t] = msg;
+         } else {
+            state->ret[t] = 0;
+         }
+      } else {
+         if (state->writepos != state->readpos) {
+            state->ret[t] = slot[state->readpos++ & mask];
+         } else {
+            state->ret[t] = 0;
+         }
+      }
+   }
+
+   state->applied = toggles;
+}
+
+// Copies the results of the installed record which is reused next into row tid of queue->result.
+// A thread which reads from this record while it is overwritten finds its result there.
+static void publish_iqwf(iqwf_t* queue, uint32_t tid)
+{
+   iqwfthread_t* thread = &queue->thread[tid];
+   uint64_t state = thread->installed[thread->record];
+
+   if (!state) return;
+
+   iqwfstate_t* record = WF_RECORD(queue, 2 * tid + thread->record);
+   void** row = &queue->result[tid * queue->nrthread];
+   for (uint32_t t = 0; t < queue->nrthread; ++t) {
+      store_atomicptr(&row[t], record->ret[t]);
+   }
+   store_atomicu64(&thread->published, state);
+   thread->installed[thread->record] = 0;
+   fence_atomic();
+}
+
+// Announces operation msg (0: receive) of thread tid and returns its result (0: queue full or empty).
+// Any thread which installs a new state applies all announced operations.
+// If both attempts fail, other threads installed two states and the second one contains the operation.
+static void* combine_iqwf(iqwf_t* queue, uint32_t tid, void* msg)
+{
+   iqwfthread_t* thread = &queue->thread[tid];
+   const uint64_t bit = (uint64_t)1 << tid;
+
+   publish_iqwf(queue, tid);
+
+   store_atomicptr(&thread->msg, msg);
+   thread->toggle ^= 1;
+   fetchxor_atomicu64(&queue->toggles, bit);
+   const uint64_t mytoggle = thread->toggle ? bit : 0;
+
+   for (int attempt = 0; attempt < 2; ++attempt) {
+      uint64_t state = load_atomicu64(&queue->state);
+      uint32_t index = 2 * tid + thread->record;
+      iqwfstate_t* record = WF_RECORD(queue, index);
+      copy_iqwf(queue, record, WF_RECORD(queue, state & 0xff));
+      fence_atomic();
+      if (state != load_atomicu64(&queue->state)) continue;
+
+      if ((record->applied & bit) == mytoggle) {
+         // already applied by another thread
+         return record->ret[tid];
+      }
+
+      apply_iqwf(queue, record, load_atomicu64(&queue->toggles));
+
+      uint64_t newstate = ((state >> 8) + 1) << 8 | index;
+      if (state == cmpxchg_atomicu64(&queue->state, state, newstate)) {
+         thread->installed[thread->record] = newstate;
+         thread->record ^= 1;
+         return record->ret[tid];
+      }
+   }
+
+   // the current state contains the result but its record could be reused by its owner.
+   // The owner publishes the results before it overwrites the record, so if the read
+   // value could be overwritten, the published one is taken which is the same in every later state.
+   uint64_t state = load_atomicu64(&queue->state);
+   uint32_t index = (uint32_t) (state & 0xff);
+   void* ret = WF_RECORD(queue, index)->ret[tid];
+   if (index < 2 * queue->nrthread) {
+      uint32_t owner = index / 2;
+      fence_atomic();
+      if ((load_atomicu64(&queue->thread[owner].published) >> 8) >= (state >> 8)) {
+         ret = load_atomicptr(&queue->result[owner * queue->nrthread + tid]);
+      }
+   }
+
+   return ret;
+}
+
+int trysend_iqwf(iqwf_t* queue, uint32_t tid, void* msg)
+{
+   if (0 == msg || tid >= queue->nrthread) {
+      return EINVAL;
+   }
+
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   return combine_iqwf(queue, tid, msg) ? 0 : EAGAIN;
+}
+
+int tryrecv_iqwf(iqwf_t* queue, uint32_t tid, /*out*/void** msg)
+{
+   if (tid >= queue->nrthread) {
+      return EINVAL;
+   }
+
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   void* ret = combine_iqwf(queue, tid, 0);
+   if (!ret) return EAGAIN;
+
+   *msg = ret;
+
+   return 0;
+}
+
+uint32_t size_iqwf(const iqwf_t* queue)
+{
+   uint64_t state = load_atomicu64(&queue->state);
+   iqwfstate_t* record = WF_RECORD(queue, state & 0xff);
+   uint64_t size = record->writepos - record->readpos;
+   return size < queue->capacity ? (uint32_t) size : queue->capacity;
+}
+
+// === iqfc_t ===
+
+int new_iqfc(/*out*/iqfc_t** queue, uint32_t capacity, uint32_t nrthread)
+{
+   if (capacity == 0 || capacity > ((uint32_t)1 << 30) || nrthread == 0 || nrthread > 1024) {
+      return EINVAL;
+   }
+
+   uint32_t aligned_capacity = 1;
+   while (aligned_capacity < capacity) {
+      aligned_capacity <<= 1;
+   }
+
+   size_t queuesize = sizeof(iqfc_t) + nrthread * sizeof(iqfcslot_t) + aligned_capacity * sizeof(void*);
+   iqfc_t* allocated_queue = (iqfc_t*) malloc_aligned(queuesize);
+
+   if (!allocated_queue) {
+      return ENOMEM;
+   }
+
+   memset(allocated_queue, 0, queuesize);
+   allocated_queue->capacity = aligned_capacity;
+   allocated_queue->nrthread = nrthread;
+   allocated_queue->msg = (void**) &allocated_queue->slot[nrthread];
+
+   *queue = allocated_queue;
 
-      err = free_iqsignal(&(*queue)->writer);
-      err2 = free_iqsignal(&(*queue)->reader);
-      if (err2) err = err2;
+   return 0;
+}
 
+int delete_iqfc(iqfc_t** queue)
+{
+   if (*queue) {
       free(*queue);
-
       *queue = 0;
    }
 
-   return err;
+   return 0;
 }
 
-void close_iqueue(iqueue_t* queue)
+void close_iqfc(iqfc_t* queue)
 {
-   pthread_mutex_lock(&queue->reader.lock);
-   pthread_mutex_lock(&queue->writer.lock);
-   queue->closed = 1;
-   pthread_mutex_unlock(&queue->writer.lock);
-   pthread_mutex_unlock(&queue->reader.lock);
+   store_atomicu32(&queue->closed, 1);
+}
 
-   // Wait until reader/writer woken up
-   for (;;) {
-      pthread_mutex_lock(&queue->reader.lock);
-      pthread_cond_broadcast(&queue->reader.cond);
-      size_t isreader = queue->reader.waitcount;
-      pthread_mutex_unlock(&queue->reader.lock);
+// Applies all published requests to the ring. The lock must be held.
+static void combine_iqfc(iqfc_t* queue)
+{
+   const uint32_t mask = queue->capacity - 1;
+   uint32_t readpos  = queue->readpos;
+   uint32_t writepos = queue->writepos;
+
+   for (uint32_t t = 0; t < queue->nrthread; ++t) {
+      iqfcslot_t* slot = &queue->slot[t];
+      if (! load_atomicu32(&slot->pending)) continue;
+      void* msg = slot->msg;
+      if (msg) {
+         if (writepos - readpos < queue->capacity) {
+            queue->msg[writepos++ & mask] = msg;
+         } else {
+            msg = 0;
+         }
+      } else if (writepos != readpos) {
+         msg = queue->msg[readpos++ & mask];
+      }
+      slot->ret = msg;
+      store_atomicu32(&slot->pending, 0);
+   }
 
-      pthread_mutex_lock(&queue->writer.lock);
-      pthread_cond_broadcast(&queue->writer.cond);
-      size_t iswriter = queue->writer.waitcount;
-      pthread_mutex_unlock(&queue->writer.lock);
+   queue->readpos  = readpos;
+   queue->writepos = writepos;
+}
 
-      if (!isreader && !iswriter) break;
+// Publishes request msg (0: receive) of thread tid and returns its result (0: queue full or empty).
+// Either the calling thread acquires the lock and combines all requests or it waits until its request is applied.
+static void* request_iqfc(iqfc_t* queue, uint32_t tid, void* msg)
+{
+   iqfcslot_t* slot = &queue->slot[tid];
 
-      sched_yield();
+   slot->msg = msg;
+   store_atomicu32(&slot->pending, 1);
+
+   for (int i = 0; load_atomicu32(&slot->pending); ++i) {
+      if (0 == queue->lock && 0 == xchg_atomicu32(&queue->lock, 1)) {
+         combine_iqfc(queue);
+         store_atomicu32(&queue->lock, 0);
+         break;
+      }
+      if (i >= 100) sched_yield();
    }
+
+   return slot->ret;
 }
 
-int trysend_iqueue(iqueue_t* queue, void* msg)
+int trysend_iqfc(iqfc_t* queue, uint32_t tid, void* msg)
 {
-   uint32_t ifree;
-
-   if (0 == msg) {
+   if (0 == msg || tid >= queue->nrthread) {
       return EINVAL;
    }
 
-   for (int i = 0;; ++i) {
-      ifree = queue->ifree;
-      if (queue->closed) return EPIPE;
-      uint32_t sizefree = fetchadd_atomicu32(&queue->sizefree[ifree], (uint32_t)-1) - 1;
-      if (sizefree < queue->capacity) break;
-      fetchadd_atomicu32(&queue->sizefree[ifree], 1);
-      cmpxchg_atomicu32(&queue->ifree, ifree, (ifree+1) & (NROFSIZE-1));
-      if (i == NROFSIZE-1) return EAGAIN;
+   if (queue->closed) {
+      return EPIPE;
    }
 
-   uint32_t pos = fetchadd_atomicu32(&queue->writepos, 1);
-   pos &= (queue->capacity-1);
+   return request_iqfc(queue, tid, msg) ? 0 : EAGAIN;
+}
 
-   while (0 != cmpxchg_atomicptr(&queue->msg[pos], 0, msg)) ;
+int tryrecv_iqfc(iqfc_t* queue, uint32_t tid, /*out*/void** msg)
+{
+   if (tid >= queue->nrthread) {
+      return EINVAL;
+   }
 
-   fetchadd_atomicu32(&queue->sizeused[ifree], 1);
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   void* ret = request_iqfc(queue, tid, 0);
+   if (!ret) return EAGAIN;
+
+   *msg = ret;
 
    return 0;
 }
 
-int tryrecv_iqueue(iqueue_t* queue, /*out*/void** msg)
+uint32_t size_iqfc(const iqfc_t* queue)
 {
-   uint32_t iused;
+   uint32_t size = queue->writepos - queue->readpos;
+   return size < queue->capacity ? size : queue->capacity;
+}
 
-   for (int i = 0;; ++i) {
-      iused = queue->iused;
-      if (queue->closed) return EPIPE;
-      uint32_t sizeused = fetchadd_atomicu32(&queue->sizeused[iused], (uint32_t)-1) - 1;
-      if (sizeused < queue->capacity) break;
-      fetchadd_atomicu32(&queue->sizeused[iused], 1);
-      cmpxchg_atomicu32(&queue->iused, iused, (iused+1) & (NROFSIZE-1));
-      if (i == NROFSIZE-1) return EAGAIN;
+// === iqbuffer_t ===
+
+int new_iqbuffer(/*out*/iqbuffer_t** buffer, iqueue_t* queue, uint32_t capacity, uint32_t maxlatency_usec)
+{
+   if (capacity == 0) {
+      return EINVAL;
    }
 
-   uint32_t pos = fetchadd_atomicu32(&queue->readpos, 1);
-   pos &= (queue->capacity-1);
+   size_t buffersize = sizeof(iqbuffer_t) + capacity * sizeof(void*);
+   iqbuffer_t* allocated_buffer = (iqbuffer_t*) malloc_aligned(buffersize);
 
-   void* fetchedmsg;
-   do {
-      fetchedmsg = queue->msg[pos];
-   } while (fetchedmsg != cmpxchg_atomicptr(&queue->msg[pos], fetchedmsg, 0) || 0 == fetchedmsg);
+   if (!allocated_buffer) {
+      return ENOMEM;
+   }
 
-   *msg = fetchedmsg;
+   memset(allocated_buffer, 0, buffersize);
+   allocated_buffer->queue = queue;
+   allocated_buffer->capacity = capacity;
+   allocated_buffer->maxlatency_usec = maxlatency_usec;
 
-   fetchadd_atomicu32(&queue->sizefree[iused], 1);
+   *buffer = allocated_buffer;
 
    return 0;
 }
 
-#define WAKEUP_READER() \
-   if (!err && queue->reader.signalcount) {      \
-      pthread_mutex_lock(&queue->reader.lock);   \
-      if (queue->reader.signalcount) {           \
-         --queue->reader.signalcount;            \
-         pthread_cond_signal(&queue->reader.cond); \
-      }                                          \
-      pthread_mutex_unlock(&queue->reader.lock); \
-   }
-
-#define WAKEUP_WRITER() \
-   if (!err && queue->writer.signalcount) {      \
-      pthread_mutex_lock(&queue->writer.lock);   \
-      if (queue->writer.signalcount) {           \
-         --queue->writer.signalcount;            \
-         pthread_cond_signal(&queue->writer.cond); \
-      }                                          \
-      pthread_mutex_unlock(&queue->writer.lock); \
-   }
-
-int send_iqueue(iqueue_t* queue, void* msg)
+int delete_iqbuffer(iqbuffer_t** buffer)
 {
-   int err = trysend_iqueue(queue, msg);
-
-   WAKEUP_READER();
+   int err = 0;
 
-   if (EAGAIN == err) {
-      pthread_mutex_lock(&queue->writer.lock);
-      ++ queue->writer.waitcount;
+   if (*buffer) {
+      err = flush_iqbuffer(*buffer);
 
-      for (;;) {
-         err = trysend_iqueue(queue, msg);
-         if (EAGAIN != err) break;
-         ++ queue->writer.signalcount;
-         pthread_cond_wait(&queue->writer.cond, &queue->writer.lock);
-      }
+      free(*buffer);
 
-      -- queue->writer.waitcount;
-      pthread_mutex_unlock(&queue->writer.lock);
+      *buffer = 0;
    }
 
    return err;
 }
 
-int recv_iqueue(iqueue_t* queue, /*out*/void** msg)
+int send_iqbuffer(iqbuffer_t* buffer, void* msg)
 {
-   int err = tryrecv_iqueue(queue, msg);
-
-   WAKEUP_WRITER();
+   if (0 == msg) {
+      return EINVAL;
+   }
 
-   if (EAGAIN == err) {
-      pthread_mutex_lock(&queue->reader.lock);
-      ++ queue->reader.waitcount;
+   if (buffer->size == buffer->capacity) {
+      // last flush failed
+      int err = flush_iqbuffer(buffer);
+      if (err) return err;
+   }
 
-      for (;;) {
-         err = tryrecv_iqueue(queue, msg);
-         if (EAGAIN != err) break;
-         ++ queue->reader.signalcount;
-         pthread_cond_wait(&queue->reader.cond, &queue->reader.lock);
-      }
+   uint64_t now = now_usec();
+   if (0 == buffer->size) {
+      buffer->firsttime_usec = now;
+   }
+   buffer->msg[buffer->size ++] = msg;
 
-      -- queue->reader.waitcount;
-      pthread_mutex_unlock(&queue->reader.lock);
+   if (buffer->size == buffer->capacity || now - buffer->firsttime_usec >= buffer->maxlatency_usec) {
+      return flush_iqbuffer(buffer);
    }
 
-   return err;
+   return 0;
 }
 
-uint32_t size_iqueue(const iqueue_t* queue)
+int flush_iqbuffer(iqbuffer_t* buffer)
 {
-   uint32_t size = 0;
-   for (int i = 0; i < NROFSIZE; ++i) {
-      uint32_t sizeused = cmpxchg_atomicu32((uint32_t*)(uintptr_t)&queue->sizeused[i], 0, 0);
-      size += (sizeused < queue->capacity ? sizeused : 0);
+   iqueue_t* queue = buffer->queue;
+   size_t n = 0;
+   int err = 0;
+
+   while (n < buffer->size) {
+      size_t nrsent;
+      err = trysendn_iqueue(queue, &buffer->msg[n], buffer->size - n, &nrsent);
+      if (! err) {
+         for (size_t i = 0; i < nrsent && queue->reader.signalcount; ++i) {
+            wakeup_waiting(&queue->reader);
+         }
+         n += nrsent;
+         continue;
+      }
+      if (EAGAIN != err) break;
+      // queue is full: wait for a free slot
+      err = send_iqueue(queue, buffer->msg[n]);
+      if (err) break;
+      ++ n;
    }
-   return size <= queue->capacity ? size : queue->capacity;
+
+   if (n) {
+      buffer->size -= (uint32_t) n;
+      memmove(buffer->msg, &buffer->msg[n], buffer->size * sizeof(void*));
+   }
+
+   return err;
 }
 
-// === iqueue1_t ===
+// === iqline_t ===
 
-int new_iqueue1(/*out*/iqueue1_t** queue, uint32_t capacity)
+int new_iqline(/*out*/iqline_t** queue, uint32_t capacity)
 {
-   if (capacity == 0 || ((size_t)-1 - sizeof(iqueue1_t))/sizeof(void*) <= capacity) {
+   if (capacity == 0 || capacity > ((uint32_t)1 << 30)) {
       return EINVAL;
    }
 
-   size_t queuesize = sizeof(iqueue1_t) + capacity * sizeof(void*);
-   iqueue1_t* allocated_queue = (iqueue1_t*) malloc(queuesize);
+   uint32_t aligned_capacity = IQLINE_NRSLOT;
+   while (aligned_capacity < capacity) {
+      aligned_capacity <<= 1;
+   }
+
+   size_t queuesize = sizeof(iqline_t) + aligned_capacity * sizeof(void*);
+   iqline_t* allocated_queue = (iqline_t*) malloc_aligned(queuesize);
 
    if (!allocated_queue) {
       return ENOMEM;
    }
 
    memset(allocated_queue, 0, queuesize);
-   allocated_queue->capacity = capacity;
+   allocated_queue->capacity = aligned_capacity;
 
    int err;
    int initcount = 0;
@@ -395,14 +3962,14 @@ ONERR:
    return err;
 }
 
-int delete_iqueue1(iqueue1_t** queue)
+int delete_iqline(iqline_t** queue)
 {
    int err = 0;
    int err2;
 
    if (*queue) {
 
-      close_iqueue1(*queue);
+      close_iqline(*queue);
 
       err = free_iqsignal(&(*queue)->writer);
       err2 = free_iqsignal(&(*queue)->reader);
@@ -416,33 +3983,45 @@ int delete_iqueue1(iqueue1_t** queue)
    return err;
 }
 
-void close_iqueue1(iqueue1_t* queue)
+void close_iqline(iqline_t* queue)
 {
-   pthread_mutex_lock(&queue->reader.lock);
-   pthread_mutex_lock(&queue->writer.lock);
-   queue->closed = 1;
-   pthread_mutex_unlock(&queue->writer.lock);
-   pthread_mutex_unlock(&queue->reader.lock);
-
-   // Wait until reader/writer woken up
-   for (;;) {
-      pthread_mutex_lock(&queue->reader.lock);
-      pthread_cond_broadcast(&queue->reader.cond);
-      size_t isreader = queue->reader.waitcount;
-      pthread_mutex_unlock(&queue->reader.lock);
+   close_waiting(&queue->closed, &queue->reader, &queue->writer);
+}
 
-      pthread_mutex_lock(&queue->writer.lock);
-      pthread_cond_broadcast(&queue->writer.cond);
-      size_t iswriter = queue->writer.waitcount;
-      pthread_mutex_unlock(&queue->writer.lock);
+// Makes all stored messages visible to the reader with a single release store.
+static inline void publish_iqline(iqline_t* queue)
+{
+   if (queue->writepos != queue->nextpos) {
+      store_atomicu32(&queue->writepos, queue->nextpos);
+   }
+}
 
-      if (!isreader && !iswriter) break;
+// Wakes up a waiting reader if writepos has changed since oldpos.
+static inline void wakeupreader_iqline(iqline_t* queue, uint32_t oldpos)
+{
+   if (queue->writepos != oldpos) {
+      // publication must be visible before signalcount is read
+      fence_atomic();
+      if (queue->reader.signalcount) {
+         wakeup_waiting(&queue->reader);
+      }
+   }
+}
 
-      sched_yield();
+// Wakes up a waiting writer if the reader freed a whole line or received all published messages.
+static inline void wakeupwriter_iqline(iqline_t* queue)
+{
+   uint32_t pos = queue->readpos;
+   if (0 == pos % IQLINE_NRSLOT || pos == queue->readlimit) {
+      // readpos must be visible before signalcount is read
+      fence_atomic();
+      if (queue->writer.signalcount) {
+         wakeup_waiting(&queue->writer);
+      }
    }
 }
 
-int trysend_iqueue1(iqueue1_t* queue, void* msg)
+int trysend_iqline(iqline_t* queue, void* msg)
 {
    if (0 == msg) {
       return EINVAL;
@@ -452,108 +4031,143 @@ int trysend_iqueue1(iqueue1_t* queue, void* msg)
       return EPIPE;
    }
 
-   uint32_t pos = queue->writepos;
-   uint32_t oldpos = pos;
-   ++pos;
-   if (pos >= queue->capacity) {
-      pos = 0;
-   }
-   queue->writepos = pos;
-
-   if (0 != cmpxchg_atomicptr(&queue->msg[oldpos], 0, msg)) {
-      queue->writepos = oldpos;
-      return EAGAIN;
-   }
-
-   return 0;
-}
-
-int tryrecv_iqueue1(iqueue1_t* queue, /*out*/void** msg)
-{
-   if (queue->closed) {
-      return EPIPE;
-   }
+   uint32_t pos = queue->nextpos;
 
-   uint32_t pos = queue->readpos;
-   uint32_t oldpos = pos;
-   ++pos;
-   if (pos >= queue->capacity) {
-      pos = 0;
+   if (pos - queue->writelimit == queue->capacity) {
+      queue->writelimit = load_atomicu32(&queue->readpos);
+      if (pos - queue->writelimit == queue->capacity) {
+         // flush on idle: the reader must not wait for an incomplete line
+         publish_iqline(queue);
+         return EAGAIN;
+      }
    }
-   queue->readpos = pos;
 
-   void* fetchedmsg = queue->msg[oldpos];
+   queue->msg[pos & (queue->capacity-1)] = msg;
+   queue->nextpos = ++pos;
 
-   if (fetchedmsg != cmpxchg_atomicptr(&queue->msg[oldpos], fetchedmsg, 0) || 0 == fetchedmsg) {
-      queue->readpos = oldpos;
-      return EAGAIN;
+   if (0 == pos % IQLINE_NRSLOT) {
+      store_atomicu32(&queue->writepos, pos);
    }
 
-   *msg = fetchedmsg;
-
    return 0;
 }
 
-int send_iqueue1(iqueue1_t* queue, void* msg)
+int send_iqline(iqline_t* queue, void* msg)
 {
-   int err = trysend_iqueue1(queue, msg);
+   uint32_t oldpos = queue->writepos;
+   int err = trysend_iqline(queue, msg);
 
-   WAKEUP_READER();
+   wakeupreader_iqline(queue, oldpos);
 
    if (EAGAIN == err) {
+      oldpos = queue->writepos;
       pthread_mutex_lock(&queue->writer.lock);
       ++ queue->writer.waitcount;
 
       for (;;) {
-         err = trysend_iqueue1(queue, msg);
-         if (EAGAIN != err) break;
          ++ queue->writer.signalcount;
-         pthread_cond_wait(&queue->writer.cond, &queue->writer.lock);
+         fence_atomic();
+         err = trysend_iqline(queue, msg);
+         if (EAGAIN != err) break;
+         wait_signal(&queue->writer, 0);
       }
 
       -- queue->writer.waitcount;
       pthread_mutex_unlock(&queue->writer.lock);
+
+      wakeupreader_iqline(queue, oldpos);
    }
 
    return err;
 }
 
-int recv_iqueue1(iqueue1_t* queue, /*out*/void** msg)
+void flush_iqline(iqline_t* queue)
 {
-   int err = tryrecv_iqueue1(queue, msg);
+   uint32_t oldpos = queue->writepos;
 
-   WAKEUP_WRITER();
+   publish_iqline(queue);
+
+   wakeupreader_iqline(queue, oldpos);
+}
+
+int tryrecv_iqline(iqline_t* queue, /*out*/void** msg)
+{
+   if (queue->closed) {
+      return EPIPE;
+   }
+
+   uint32_t pos = queue->readpos;
+
+   if (pos == queue->readlimit) {
+      queue->readlimit = load_atomicu32(&queue->writepos);
+      if (pos == queue->readlimit) {
+         return EAGAIN;
+      }
+   }
+
+   *msg = queue->msg[pos & (queue->capacity-1)];
+   store_atomicu32(&queue->readpos, pos + 1);
+
+   return 0;
+}
+
+int recv_iqline(iqline_t* queue, /*out*/void** msg)
+{
+   int err = tryrecv_iqline(queue, msg);
 
    if (EAGAIN == err) {
       pthread_mutex_lock(&queue->reader.lock);
       ++ queue->reader.waitcount;
 
       for (;;) {
-         err = tryrecv_iqueue1(queue, msg);
-         if (EAGAIN != err) break;
          ++ queue->reader.signalcount;
-         pthread_cond_wait(&queue->reader.cond, &queue->reader.lock);
+         fence_atomic();
+         err = tryrecv_iqline(queue, msg);
+         if (EAGAIN != err) break;
+         wait_signal(&queue->reader, 0);
       }
 
       -- queue->reader.waitcount;
       pthread_mutex_unlock(&queue->reader.lock);
    }
 
+   if (! err) {
+      wakeupwriter_iqline(queue);
+   }
+
    return err;
 }
 
-uint32_t size_iqueue1(const iqueue1_t* queue)
+int tryrecvn_iqline(iqline_t* queue, /*out*/void* msg[/*nrmsg*/], size_t nrmsg, /*out*/size_t* nrrecv)
 {
-   uint32_t rpos = cmpxchg_atomicu32((uint32_t*)(uintptr_t)&queue->readpos, 0, 0);
-   uint32_t wpos = cmpxchg_atomicu32((uint32_t*)(uintptr_t)&queue->writepos, 0, 0);
+   if (queue->closed) {
+      return EPIPE;
+   }
 
-   if (rpos < wpos) {
-      return (wpos - rpos);
+   uint32_t pos = queue->readpos;
 
-   } else {
-      uint32_t free = (rpos - wpos);
-      return (free == 0 && 0 == queue->msg[wpos == 0?queue->capacity-1:wpos-1])
-             ? 0
-             : (queue->capacity - free);
+   if (queue->readlimit - pos < nrmsg) {
+      queue->readlimit = load_atomicu32(&queue->writepos);
+      if (pos == queue->readlimit) {
+         return EAGAIN;
+      }
+   }
+
+   const uint32_t mask = queue->capacity - 1;
+   size_t n = queue->readlimit - pos;
+   if (n > nrmsg) n = nrmsg;
+
+   for (size_t i = 0; i < n; ++i) {
+      msg[i] = queue->msg[(pos + (uint32_t)i) & mask];
    }
+   store_atomicu32(&queue->readpos, pos + (uint32_t)n);
+
+   *nrrecv = n;
+
+   return 0;
+}
+
+uint32_t size_iqline(const iqline_t* queue)
+{
+   return load_atomicu32(&queue->writepos) - load_atomicu32(&queue->readpos);
 }
@@ -16,11 +16,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 // len of iqueue->sizeused
 #define LENOFSIZE 256
 
+// current state record of iqwf_t (see iqueue.c)
+#define WF_STATE(queue) ((iqwfstate_t*) ((queue)->records + (size_t)((queue)->state & 0xff) * (queue)->recordsize))
+
 #define TEST(COND) \
          if (!(COND)) { \
             fprintf(stderr, "\n%s:%d: TEST failed\n", __FILE__, __LINE__); \
@@ -189,6 +193,22 @@ static void test_initfree(void)
    pthread_t thr;
    iqueue_t* queue = 0;
 
+   // TEST new_iqueue: fields written by readers / writers / waiting threads live on different cache lines
+   TEST(0 == new_iqueue(&queue, 1));
+   TEST(0 == (uintptr_t)queue % SIZE_CACHELINE);
+   TEST(offsetof(iqueue_t, capacity)/SIZE_CACHELINE < offsetof(iqueue_t, readpos)/SIZE_CACHELINE);
+   TEST(offsetof(iqueue_t, iused)/SIZE_CACHELINE == offsetof(iqueue_t, readpos)/SIZE_CACHELINE);
+   TEST(offsetof(iqueue_t, readpos)/SIZE_CACHELINE < offsetof(iqueue_t, ifree)/SIZE_CACHELINE);
+   TEST(offsetof(iqueue_t, ifree)/SIZE_CACHELINE == offsetof(iqueue_t, writepos)/SIZE_CACHELINE);
+   TEST(offsetof(iqueue_t, writepos)/SIZE_CACHELINE < offsetof(iqueue_t, sizeused)/SIZE_CACHELINE);
+   TEST(0 == offsetof(iqueue_t, reader) % SIZE_CACHELINE);
+   TEST(0 == offsetof(iqueue_t, writer) % SIZE_CACHELINE);
+   TEST(0 == offsetof(iqueue_t, msg) % SIZE_CACHELINE);
+   TEST(offsetof(iqueue_t, writer) - offsetof(iqueue_t, reader) >= sizeof(iqsignal_t));
+   TEST(offsetof(iqueue_t, msg) - offsetof(iqueue_t, writer) >= sizeof(iqsignal_t));
+   TEST(0 == delete_iqueue(&queue));
+   PASS();
+
    // TEST new_iqueue + delete_iqueue: capacity <= LENOFSIZE
    for (uint32_t capacity = 0; capacity <= LENOFSIZE; ++capacity) {
       TEST(0 == new_iqueue(&queue, capacity));
@@ -282,7 +302,7 @@ static void test_initfree(void)
    PASS();
 
    // TEST new_iqueue: EINVAL
-   TEST(EINVAL == new_iqueue(&queue, (uint32_t)-1));
+   TEST(EINVAL == new_iqueue(&queue, (iqpos_t)-1));
    PASS();
 }
 
@@ -329,6 +349,43 @@ static void test_query(void)
    TEST(0 == delete_iqueue(&queue));
 }
 
+static void test_positions(void)
+{
+   iqueue_t* queue = 0;
+   int       msg[4];
+   void*     rmsg;
+
+   // prepare
+   TEST(0 == new_iqueue(&queue, LENOFSIZE));
+
+   // TEST trysend_iqueue, tryrecv_iqueue: positions beyond 2^32 (iqpos_t is 64 bit wide)
+   // or wrapped around (iqpos_t is 32 bit wide)
+   queue->readpos  = (iqpos_t) 0xfffffffe;
+   queue->writepos = (iqpos_t) 0xfffffffe;
+   for (int i = 0; i < 4; ++i) {
+      TEST(0 == trysend_iqueue(queue, &msg[i]));
+      TEST((iqpos_t)0xfffffffe + (iqpos_t)i + 1 == queue->writepos);
+   }
+   TEST(&msg[0] == queue->msg[LENOFSIZE-2]);
+   TEST(&msg[1] == queue->msg[LENOFSIZE-1]);
+   TEST(&msg[2] == queue->msg[0]);
+   TEST(&msg[3] == queue->msg[1]);
+   TEST(4 == size_iqueue(queue));
+   for (int i = 0; i < 4; ++i) {
+      TEST(0 == tryrecv_iqueue(queue, &rmsg));
+      TEST(&msg[i] == rmsg);
+      TEST((iqpos_t)0xfffffffe + (iqpos_t)i + 1 == queue->readpos);
+   }
+   TEST(0 == size_iqueue(queue));
+#ifdef IQUEUE_POS64
+   TEST(0x100000002 == queue->readpos);
+#endif
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
+}
+
 static void* thread_simulate_read(void* param)
 {
    iqueue_t* queue = param;
@@ -458,7 +515,7 @@ static void* thread_call_send(void* param)
 
    TEST(0 == queue->writer.waitcount);
    TEST(0 == pthread_mutex_lock(&queue->writer.lock));
-   uint32_t pos = queue->writepos;
+   iqpos_t pos = queue->writepos;
    pos %= queue->capacity;
    void* msg = queue->msg[pos];
    TEST(0 == pthread_mutex_unlock(&queue->writer.lock));
@@ -517,7 +574,9 @@ static void test_send_single(void)
             sched_yield();
             if (cmpxchg_atomicsize(&queue->writer.waitcount, 0, 0)) break;
          }
-         TEST(1 == cmpxchg_atomicsize(&queue->writer.waitcount, 0, 0));
+         TEST(0 == pthread_mutex_lock(&queue->writer.lock));
+         TEST(1 == queue->writer.waitcount);
+         TEST(0 == pthread_mutex_unlock(&queue->writer.lock));
          if (wr < 5) {
             TEST(0 == pthread_mutex_lock(&queue->writer.lock));
             TEST(0 == pthread_cond_signal(&queue->writer.cond));
@@ -642,7 +701,9 @@ static void test_tryrecv_single(void)
          sched_yield();
          if (cmpxchg_atomicsize(&queue->writer.waitcount, 0, 0)) break;
       }
-      TEST(1 == cmpxchg_atomicsize(&queue->writer.waitcount, 0, 0));
+      TEST(0 == pthread_mutex_lock(&queue->writer.lock));
+      TEST(1 == queue->writer.waitcount);
+      TEST(0 == pthread_mutex_unlock(&queue->writer.lock));
       TEST(0 == tryrecv_iqueue(queue, &rcv));
       TEST(rcv == &msg[i]);
       for (int wc = 0; wc < 100; ++wc) {
@@ -736,7 +797,9 @@ static void test_recv_single(void)
             sched_yield();
             if (cmpxchg_atomicsize(&queue->reader.waitcount, 0, 0)) break;
          }
-         TEST(1 == cmpxchg_atomicsize(&queue->reader.waitcount, 0, 0));
+         TEST(0 == pthread_mutex_lock(&queue->reader.lock));
+         TEST(1 == queue->reader.waitcount);
+         TEST(0 == pthread_mutex_unlock(&queue->reader.lock));
          if (wr < 5) {
             TEST(0 == pthread_mutex_lock(&queue->reader.lock));
             TEST(0 == pthread_cond_signal(&queue->reader.cond));
@@ -1129,297 +1192,3930 @@ void test_multi_sendrecv(void)
    }
 }
 
-static void* thr_lock1(void* param)
+#define NRPINGPONG 100000
+
+// Every message is answered, so the other side has always just started to wait.
+static void* thread_pingpong(void* queue)
 {
-   iqueue1_t* queue = param;
+   iqueue_t** q = queue;
+   void*      msg;
+   for (int i = 0; i < NRPINGPONG; ++i) {
+      TEST(0 == recv_iqueue(q[0], &msg));
+      TEST(0 == send_iqueue(q[1], msg));
+   }
+   return 0;
+}
 
-   TEST(0 == pthread_mutex_lock(&queue->writer.lock));
-   cmpxchg_atomicu32(&queue->closed, 0, 1);
-   TEST(0 == pthread_cond_wait(&queue->writer.cond, &queue->writer.lock));
-   TEST(0 == pthread_mutex_unlock(&queue->writer.lock));
+static void* thread_pingpong1(void* queue)
+{
+   iqueue1_t** q = queue;
+   void*       msg;
+   for (int i = 0; i < NRPINGPONG; ++i) {
+      TEST(0 == recv_iqueue1(q[0], &msg));
+      TEST(0 == send_iqueue1(q[1], msg));
+   }
+   return 0;
+}
 
-   TEST(0 == pthread_mutex_lock(&queue->reader.lock));
-   cmpxchg_atomicu32(&queue->closed, 1, 2);
-   TEST(0 == pthread_cond_wait(&queue->reader.cond, &queue->reader.lock));
-   TEST(0 == pthread_mutex_unlock(&queue->reader.lock));
-   cmpxchg_atomicu32(&queue->closed, 2, 3);
+static void test_wakeup(void)
+{
+   iqueue_t*  q[2] = { 0, 0 };
+   iqueue1_t* q1[2] = { 0, 0 };
+   pthread_t  thr;
+   void*      msg;
+
+   // prepare
+   TEST(0 == new_iqueue(&q[0], 1));
+   TEST(0 == new_iqueue(&q[1], 1));
+   TEST(0 == new_iqueue1(&q1[0], 1));
+   TEST(0 == new_iqueue1(&q1[1], 1));
+   // a lost wakeup blocks both threads forever
+   alarm(60);
+
+   // TEST send_iqueue, recv_iqueue: a waiting reader is never missed by a concurrent send
+   TEST(0 == pthread_create(&thr, 0, &thread_pingpong, q));
+   for (int i = 0; i < NRPINGPONG; ++i) {
+      TEST(0 == send_iqueue(q[0], &thr));
+      TEST(0 == recv_iqueue(q[1], &msg));
+      TEST(&thr == msg);
+   }
+   TEST(0 == pthread_join(thr, 0));
+   PASS();
+
+   // TEST send_iqueue1, recv_iqueue1: a waiting reader is never missed by a concurrent send
+   TEST(0 == pthread_create(&thr, 0, &thread_pingpong1, q1));
+   for (int i = 0; i < NRPINGPONG; ++i) {
+      TEST(0 == send_iqueue1(q1[0], &thr));
+      TEST(0 == recv_iqueue1(q1[1], &msg));
+      TEST(&thr == msg);
+   }
+   TEST(0 == pthread_join(thr, 0));
+   PASS();
+
+   // unprepare
+   alarm(0);
+   TEST(0 == delete_iqueue(&q[0]));
+   TEST(0 == delete_iqueue(&q[1]));
+   TEST(0 == delete_iqueue1(&q1[0]));
+   TEST(0 == delete_iqueue1(&q1[1]));
+}
+
+// returns microseconds of CLOCK_MONOTONIC
+static uint64_t monotonic_usec(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// sets deadline to CLOCK_MONOTONIC + usec
+static void deadline_after(/*out*/struct timespec* deadline, uint64_t usec)
+{
+   uint64_t time = monotonic_usec() + usec;
+   deadline->tv_sec  = (time_t) (time / 1000000);
+   deadline->tv_nsec = (long) (time % 1000000) * 1000;
+}
 
+static void* thread_send_slowly(void* queue)
+{
+   static int s_msg[4];
+   for (int i = 0; i < 4; ++i) {
+      usleep(1000);
+      TEST(0 == send_iqueue(queue, &s_msg[i]));
+   }
+   return s_msg;
+}
+
+static void* thread_close_delayed(void* queue)
+{
+   usleep(10000);
+   close_iqueue(queue);
    return 0;
 }
 
-static void test_initfree1(void)
+static void test_recvn(void)
 {
+   iqueue_t* queue = 0;
    pthread_t thr;
-   iqueue1_t* queue = 0;
+   int       msg[64];
+   void*     rmsg[64];
+   size_t    nr;
+   uint64_t  start;
 
-   // TEST new_iqueue
-   TEST(0 == new_iqueue1(&queue, 12345));
-   TEST(0 != queue);
-   TEST(12345 == queue->capacity);
-   TEST(0 == queue->readpos);
-   TEST(0 == queue->writepos);
-   TEST(0 == queue->closed);
-   TEST(0 == queue->reader.waitcount);
-   TEST(0 == queue->writer.waitcount);
-   for (size_t i = 0; i < queue->capacity; ++i) {
-      TEST(0 == queue->msg[i]);
-   }
-   // test writelock + writecond
-   TEST(0 == pthread_create(&thr, 0, &thr_lock1, queue));
-   for (int i = 0; i < 100000; ++i) {
-      if (0 != cmpxchg_atomicu32(&queue->closed, 0, 0)) break;
-      sched_yield();
-   }
-   // thr_lock1 is waiting on writecond
-   TEST(1 == cmpxchg_atomicu32(&queue->closed, 0, 0));
-   TEST(0 == pthread_mutex_lock(&queue->writer.lock));
-   TEST(0 == pthread_cond_signal(&queue->writer.cond));
+   // prepare
+   TEST(0 == new_iqueue(&queue, 64));
+
+   // TEST recvn_iqueue: EINVAL
+   TEST(EINVAL == recvn_iqueue(queue, rmsg, 0, 0, 0, &nr));
+   TEST(EINVAL == recvn_iqueue(queue, rmsg, 4, 5, 0, &nr));
+   PASS();
+
+   // TEST recvn_iqueue: minmsg available ==> receives all available up to nrmsg without waiting
    for (int i = 0; i < 10; ++i) {
-      sched_yield();
-      TEST(1 == cmpxchg_atomicu32(&queue->closed, 0, 0));
-   }
-   TEST(0 == pthread_mutex_unlock(&queue->writer.lock));
-   for (int i = 0; i < 100000; ++i) {
-      if (1 != cmpxchg_atomicu32(&queue->closed, 0, 0)) break;
-      sched_yield();
+      TEST(0 == trysend_iqueue(queue, &msg[i]));
    }
-   // thr_lock is waiting on readcond
-   TEST(2 == cmpxchg_atomicu32(&queue->closed, 0, 0));
-   TEST(0 == pthread_mutex_lock(&queue->reader.lock));
-   TEST(0 == pthread_cond_signal(&queue->reader.cond));
-   for (int i = 0; i < 10; ++i) {
-      sched_yield();
-      TEST(2 == cmpxchg_atomicu32(&queue->closed, 0, 0));
+   TEST(0 == recvn_iqueue(queue, rmsg, 8, 4, 10000000, &nr));
+   TEST(8 == nr);
+   for (int i = 0; i < 8; ++i) {
+      TEST(rmsg[i] == &msg[i]);
    }
-   TEST(0 == pthread_mutex_unlock(&queue->reader.lock));
-   TEST(0 == pthread_join(thr, 0));
-   TEST(3 == cmpxchg_atomicu32(&queue->closed, 0, 0));
+   start = monotonic_usec();
+   TEST(0 == recvn_iqueue(queue, rmsg, 8, 2, 10000000, &nr));
+   TEST(monotonic_usec() - start < 1000000);
+   TEST(2 == nr);
+   TEST(rmsg[0] == &msg[8] && rmsg[1] == &msg[9]);
+   TEST(0 == size_iqueue(queue));
    PASS();
 
-   // TEST delete_iqueue
-   TEST(0 == delete_iqueue1(&queue));
-   TEST(0 == queue);
+   // TEST recvn_iqueue: less than minmsg ==> returns after maxlatency_usec
+   TEST(0 == trysend_iqueue(queue, &msg[0]));
+   TEST(0 == trysend_iqueue(queue, &msg[1]));
+   start = monotonic_usec();
+   TEST(0 == recvn_iqueue(queue, rmsg, 64, 32, 20000, &nr));
+   TEST(monotonic_usec() - start >= 20000);
+   TEST(2 == nr);
+   TEST(rmsg[0] == &msg[0] && rmsg[1] == &msg[1]);
+   TEST(0 == queue->reader.waitcount);
    PASS();
 
-   // TEST new_iqueue: different size parameter
-   for (size_t s = 1; s < 65536; s = (s << 1) + 33) {
-      TEST(0 == new_iqueue1(&queue, (uint16_t) s));
-      TEST(0 != queue);
-      TEST(s == queue->capacity);
-      TEST(0 == queue->readpos);
-      TEST(0 == queue->writepos);
-      TEST(0 == queue->closed);
-      TEST(0 == queue->reader.waitcount);
-      TEST(0 == queue->writer.waitcount);
-      for (size_t i = 0; i < queue->capacity; ++i) {
-         TEST(0 == queue->msg[i]);
-      }
-      TEST(0 == delete_iqueue1(&queue));
-      TEST(0 == queue);
+   // TEST recvn_iqueue: waits for first message and then for minmsg messages
+   TEST(0 == pthread_create(&thr, 0, &thread_send_slowly, queue));
+   start = monotonic_usec();
+   TEST(0 == recvn_iqueue(queue, rmsg, 64, 4, 10000000, &nr));
+   TEST(monotonic_usec() - start < 10000000);
+   void* smsg;
+   TEST(0 == pthread_join(thr, &smsg));
+   TEST(4 == nr);
+   for (int i = 0; i < 4; ++i) {
+      TEST(rmsg[i] == &((int*)smsg)[i]);
    }
    PASS();
 
-   // TEST new_iqueue: EINVAL
-   TEST(EINVAL == new_iqueue1(&queue, 0));
+   // TEST recvn_iqueue: returns received messages if queue is closed while waiting
+   TEST(0 == trysend_iqueue(queue, &msg[0]));
+   TEST(0 == pthread_create(&thr, 0, &thread_close_delayed, queue));
+   TEST(0 == recvn_iqueue(queue, rmsg, 64, 32, 10000000, &nr));
+   TEST(0 == pthread_join(thr, 0));
+   TEST(1 == nr);
+   TEST(rmsg[0] == &msg[0]);
+   TEST(EPIPE == recvn_iqueue(queue, rmsg, 64, 32, 10000000, &nr));
    PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
 }
 
-static void test_query1(void)
+static void* thread_recv_delayed(void* queue)
 {
-   iqueue1_t* queue = 0;
+   void* msg;
+   usleep(10000);
+   TEST(0 == recv_iqueue(queue, &msg));
+   return msg;
+}
+
+static void test_timed(void)
+{
+   iqueue_t* queue = 0;
+   pthread_t thr;
+   int       msg[LENOFSIZE];
+   void*     rmsg;
+   struct timespec deadline;
+   uint64_t  start;
 
    // prepare
-   TEST(0 == new_iqueue1(&queue, 128));
+   TEST(0 == new_iqueue(&queue, LENOFSIZE));
 
-   // TEST capacity_iqueue
-   TEST(128 == capacity_iqueue1(queue));
+   // TEST timedrecv_iqueue: ETIMEDOUT
+   start = monotonic_usec();
+   deadline_after(&deadline, 20000);
+   TEST(ETIMEDOUT == timedrecv_iqueue(queue, &rmsg, &deadline));
+   TEST(monotonic_usec() - start >= 20000);
+   TEST(0 == queue->reader.waitcount);
+   // deadline in the past
+   TEST(ETIMEDOUT == timedrecv_iqueue(queue, &rmsg, &deadline));
    PASS();
 
-   // TEST size_iqueue
-   TEST(0 == size_iqueue1(queue));
+   // TEST timedsend_iqueue, timedrecv_iqueue: EINVAL (tv_nsec out of range)
+   for (int i = 0; i < 2; ++i) {
+      size_t signalcount = queue->reader.signalcount;
+      struct timespec invalid = deadline;
+      invalid.tv_nsec = i ? -1 : 2000000000;
+      TEST(EINVAL == timedrecv_iqueue(queue, &rmsg, &invalid));
+      TEST(0 == queue->reader.waitcount);
+      TEST(signalcount == queue->reader.signalcount);
+      TEST(EINVAL == timedsend_iqueue(queue, &msg[0], &invalid));
+      TEST(EAGAIN == tryrecv_iqueue(queue, &rmsg));
+   }
    PASS();
 
-   // TEST capacity_iqueue1: returns value from capacity
-   queue->capacity = 0;
-   TEST(0 == capacity_iqueue1(queue));
-   for (uint32_t i = 1; i; i = (uint16_t)(i << 1)) {
-      queue->capacity = i;
-      TEST(i == capacity_iqueue1(queue));
+   // TEST timedsend_iqueue, timedrecv_iqueue: no waiting
+   deadline_after(&deadline, 0);
+   for (int i = 0; i < LENOFSIZE; ++i) {
+      TEST(0 == timedsend_iqueue(queue, &msg[i], &deadline));
    }
-   queue->capacity = 128;
    PASS();
 
-   // TEST size_iqueue: readpos < writepos
-   for (uint32_t i = 1; i; i = (i << 1)) {
-      queue->readpos  = 0;
-      queue->writepos = i;
-      TEST(i == size_iqueue1(queue));
-   }
-   for (uint32_t i = 1; i; i = (i << 1)) {
-      for (uint32_t s = 10; s; --s) {
-         queue->readpos = i;
-         queue->writepos = (i+s);
-         TEST(s == size_iqueue1(queue));
-      }
-   }
+   // TEST timedsend_iqueue: ETIMEDOUT
+   start = monotonic_usec();
+   deadline_after(&deadline, 20000);
+   TEST(ETIMEDOUT == timedsend_iqueue(queue, &msg[0], &deadline));
+   TEST(monotonic_usec() - start >= 20000);
+   TEST(0 == queue->writer.waitcount);
    PASS();
 
-   // TEST size_iqueue: writepos < readpos
-   for (uint32_t i = 1; i; i = (i << 1)) {
-      for (uint32_t c = 65535; c >= 32768; c = (uint16_t)(c - (~c + 1))) {
-         queue->capacity = c;
-         queue->readpos  = i;
-         queue->writepos = 0;
-         TEST((c - i) == size_iqueue1(queue));
-      }
-   }
-   for (uint32_t i = 1; i; i = (i << 1)) {
-      for (uint32_t s = 10; s; --s) {
-         for (uint32_t c = 65535; c >= 32768; c = (uint16_t)(c - (~c + 1))) {
-            queue->capacity = c;
-            queue->readpos = (i+s);
-            queue->writepos = i;
-            TEST((c-s) == size_iqueue1(queue));
-         }
-      }
+   // TEST timedsend_iqueue: woken up by reader before deadline
+   TEST(0 == pthread_create(&thr, 0, &thread_recv_delayed, queue));
+   deadline_after(&deadline, 10000000);
+   TEST(0 == timedsend_iqueue(queue, &msg[0], &deadline));
+   TEST(0 == pthread_join(thr, &rmsg));
+   TEST(rmsg == &msg[0]);
+   for (int i = 1; i < LENOFSIZE; ++i) {
+      TEST(0 == timedrecv_iqueue(queue, &rmsg, &deadline));
+      TEST(rmsg == &msg[i]);
    }
-   queue->capacity = 128;
+   TEST(0 == timedrecv_iqueue(queue, &rmsg, &deadline));
+   TEST(rmsg == &msg[0]);
    PASS();
 
-   // TEST size_iqueue: writepos == readpos
-   for (uint32_t c = 1; c <= 128; ++c) {
-      // writepos == 0
-      queue->capacity = c;
-      queue->readpos  = 0;
-      queue->writepos = 0;
-      TEST(0 == size_iqueue1(queue));
-      queue->msg[c-1] = (void*) 1;
-      TEST(c == size_iqueue1(queue));
-      queue->msg[c-1] = (void*) 0;
-   }
-   for (uint32_t i = 1; i < 128; ++i) {
-      for (uint32_t c = 1; c <= 128; ++c) {
-         // writepos > 0
-         queue->capacity = c;
-         queue->readpos  = i;
-         queue->writepos = i;
-         TEST(0 == size_iqueue1(queue));
-         queue->msg[i-1] = (void*) 1;
-         TEST(c == size_iqueue1(queue));
-         queue->msg[i-1] = (void*) 0;
-      }
-   }
+   // TEST timedsend_iqueue, timedrecv_iqueue: EPIPE
+   close_iqueue(queue);
+   TEST(EPIPE == timedsend_iqueue(queue, &msg[0], &deadline));
+   TEST(EPIPE == timedrecv_iqueue(queue, &rmsg, &deadline));
    PASS();
 
    // unprepare
-   TEST(0 == delete_iqueue1(&queue));
+   TEST(0 == delete_iqueue(&queue));
 }
 
-void* thread_sendrange1(void* queue)
+static void test_reset(void)
 {
-   uint32_t myid = 0;
-   struct range_t msg[2*QUEUESIZE];
-
-   for (uint32_t nr = 0; nr < 2*QUEUESIZE; ++nr) {
-      msg[nr].nr = MAXRANGE;
-   }
+   iqueue_t* queue = 0;
+   int       msg;
+   void*     rmsg;
 
-   for (uint32_t nr = 0; nr < MAXRANGE; ++nr) {
-      uint32_t m = nr % (2*QUEUESIZE);
-      while (MAXRANGE != cmpxchg_atomicu32(&msg[m].nr, MAXRANGE, 0)) {
-         sched_yield(); // message in use
-      }
-      msg[m].tid = myid;
-      msg[m].nr  = nr;
+   // prepare
+   TEST(0 == new_iqueue(&queue, 1));
 
-      for (int i = 0; ; ++i) {
-         int err = s_threadtry ? trysend_iqueue1(queue, &msg[m]) : send_iqueue1(queue, &msg[m]);
-         if (err == 0) break;
-         TEST(s_threadtry && err == EAGAIN);
-         sched_yield();
-         if (i == 1000000) {
-            printf("Sender starvation\n");
-            exit(1);
-         }
-      }
-   }
+   // TEST reset_iqueue: EINVAL (not closed)
+   TEST(EINVAL == reset_iqueue(queue));
+   PASS();
+
+   // TEST reset_iqueue: EBUSY (not empty)
+   TEST(0 == trysend_iqueue(queue, &msg));
+   close_iqueue(queue);
+   TEST(EBUSY == reset_iqueue(queue));
+   TEST(1 == queue->closed);
+   PASS();
+
+   // TEST reset_iqueue: reopens drained queue
+   queue->closed = 0;
+   TEST(0 == tryrecv_iqueue(queue, &rmsg));
+   close_iqueue(queue);
+   TEST(EPIPE == trysend_iqueue(queue, &msg));
+   TEST(0 == reset_iqueue(queue));
+   TEST(0 == queue->closed);
+   for (int r = 0; r < 2; ++r) {
+      for (int i = 0; i < LENOFSIZE; ++i) {
+         TEST(0 == trysend_iqueue(queue, &msg));
+      }
+      TEST(EAGAIN == trysend_iqueue(queue, &msg));
+      for (int i = 0; i < LENOFSIZE; ++i) {
+         TEST(0 == tryrecv_iqueue(queue, &rmsg));
+      }
+      TEST(EAGAIN == tryrecv_iqueue(queue, &rmsg));
+      close_iqueue(queue);
+      TEST(0 == reset_iqueue(queue));
+   }
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
+}
+
+static void test_sendn(void)
+{
+   iqueue_t* queue = 0;
+   int       msg[300];
+   void*     msgptr[300];
+   void*     rmsg;
+   size_t    nrsent;
+
+   // prepare
+   for (int i = 0; i < 300; ++i) {
+      msgptr[i] = &msg[i];
+   }
+   TEST(0 == new_iqueue(&queue, 4096));
+
+   // TEST trysendn_iqueue: EINVAL
+   msgptr[3] = 0;
+   TEST(EINVAL == trysendn_iqueue(queue, msgptr, 4, &nrsent));
+   msgptr[3] = &msg[3];
+   PASS();
+
+   // TEST trysendn_iqueue: reserves a block of free slots with a single counter
+   uint32_t ifree = queue->ifree;
+   TEST(0 == trysendn_iqueue(queue, msgptr, 10, &nrsent));
+   TEST(10 == nrsent);
+   TEST(6 == queue->sizefree[ifree]);
+   TEST(10 == queue->sizeused[ifree]);
+   TEST(10 == queue->writepos);
+   TEST(10 == size_iqueue(queue));
+   for (int i = 0; i < 10; ++i) {
+      TEST(0 == tryrecv_iqueue(queue, &rmsg));
+      TEST(&msg[i] == rmsg);
+   }
+   PASS();
+
+   // TEST trysendn_iqueue: continues with next counters
+   TEST(0 == trysendn_iqueue(queue, msgptr, 300, &nrsent));
+   TEST(300 == nrsent);
+   TEST(300 == size_iqueue(queue));
+   for (int i = 0; i < 300; ++i) {
+      TEST(0 == tryrecv_iqueue(queue, &rmsg));
+      TEST(&msg[i] == rmsg);
+   }
+   TEST(0 == size_iqueue(queue));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
+
+   // TEST trysendn_iqueue: EAGAIN if full
+   TEST(0 == new_iqueue(&queue, 256));
+   TEST(0 == trysendn_iqueue(queue, msgptr, 300, &nrsent));
+   TEST(256 == nrsent);
+   TEST(EAGAIN == trysendn_iqueue(queue, msgptr, 1, &nrsent));
+   TEST(0 == nrsent);
+   for (int i = 0; i < 256; ++i) {
+      TEST(0 == tryrecv_iqueue(queue, &rmsg));
+      TEST(&msg[i] == rmsg);
+   }
+   PASS();
+
+   // TEST trysendn_iqueue: EPIPE
+   close_iqueue(queue);
+   TEST(EPIPE == trysendn_iqueue(queue, msgptr, 1, &nrsent));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
+}
+
+static void* thread_recv(void* queue)
+{
+   void* msg;
+   TEST(0 == recv_iqueue(queue, &msg));
+   return msg;
+}
+
+static void test_buffer(void)
+{
+   iqueue_t*   queue = 0;
+   iqbuffer_t* buffer = 0;
+   int         msg[256];
+   void*       rmsg;
+   pthread_t   thr[3];
+
+   // prepare
+   TEST(0 == new_iqueue(&queue, 256));
+
+   // TEST new_iqbuffer, delete_iqbuffer
+   TEST(0 == new_iqbuffer(&buffer, queue, 4, 1000));
+   TEST(0 != buffer);
+   TEST(queue == buffer->queue);
+   TEST(0 == buffer->size);
+   TEST(4 == buffer->capacity);
+   TEST(1000 == buffer->maxlatency_usec);
+   TEST(0 == delete_iqbuffer(&buffer));
+   TEST(0 == buffer);
+   TEST(0 == delete_iqbuffer(&buffer));
+   TEST(0 == buffer);
+   PASS();
+
+   // TEST new_iqbuffer: EINVAL
+   TEST(EINVAL == new_iqbuffer(&buffer, queue, 0, 1000));
+   TEST(0 == buffer);
+   PASS();
+
+   // TEST send_iqbuffer: flush if buffer is full
+   TEST(0 == new_iqbuffer(&buffer, queue, 4, 1000000));
+   TEST(EINVAL == send_iqbuffer(buffer, 0));
+   for (int r = 0; r < 3; ++r) {
+      for (int i = 0; i < 3; ++i) {
+         TEST(0 == send_iqbuffer(buffer, &msg[i]));
+         TEST((uint32_t)i+1 == size_iqbuffer(buffer));
+      }
+      TEST(0 == size_iqueue(queue));
+      TEST(0 == send_iqbuffer(buffer, &msg[3]));
+      TEST(0 == size_iqbuffer(buffer));
+      TEST(4 == size_iqueue(queue));
+      for (int i = 0; i < 4; ++i) {
+         TEST(0 == tryrecv_iqueue(queue, &rmsg));
+         TEST(&msg[i] == rmsg);
+      }
+   }
+   PASS();
+
+   // TEST flush_iqbuffer
+   TEST(0 == flush_iqbuffer(buffer));
+   TEST(0 == send_iqbuffer(buffer, &msg[0]));
+   TEST(0 == send_iqbuffer(buffer, &msg[1]));
+   TEST(0 == size_iqueue(queue));
+   TEST(0 == flush_iqbuffer(buffer));
+   TEST(0 == size_iqbuffer(buffer));
+   TEST(2 == size_iqueue(queue));
+   for (int i = 0; i < 2; ++i) {
+      TEST(0 == tryrecv_iqueue(queue, &rmsg));
+      TEST(&msg[i] == rmsg);
+   }
+   TEST(0 == delete_iqbuffer(&buffer));
+   PASS();
+
+   // TEST send_iqbuffer: flush if oldest message is older than maxlatency_usec
+   TEST(0 == new_iqbuffer(&buffer, queue, 4, 10000));
+   TEST(0 == send_iqbuffer(buffer, &msg[0]));
+   TEST(1 == size_iqbuffer(buffer));
+   usleep(20000);
+   TEST(0 == send_iqbuffer(buffer, &msg[1]));
+   TEST(0 == size_iqbuffer(buffer));
+   TEST(2 == size_iqueue(queue));
+   for (int i = 0; i < 2; ++i) {
+      TEST(0 == tryrecv_iqueue(queue, &rmsg));
+      TEST(&msg[i] == rmsg);
+   }
+   TEST(0 == delete_iqbuffer(&buffer));
+   PASS();
+
+   // TEST flush_iqbuffer: wakes up waiting reader
+   TEST(0 == new_iqbuffer(&buffer, queue, 4, 1000000));
+   TEST(0 == pthread_create(&thr[0], 0, &thread_recv, queue));
+   for (;;) {
+      pthread_mutex_lock(&queue->reader.lock);
+      size_t waitcount = queue->reader.waitcount;
+      pthread_mutex_unlock(&queue->reader.lock);
+      if (waitcount) break;
+      sched_yield();
+   }
+   TEST(0 == send_iqbuffer(buffer, &msg[5]));
+   TEST(0 == flush_iqbuffer(buffer));
+   TEST(0 == pthread_join(thr[0], &rmsg));
+   TEST(&msg[5] == rmsg);
+   PASS();
+
+   // TEST flush_iqbuffer: blocks if queue is full
+   for (int i = 0; i < 255; ++i) {
+      TEST(0 == trysend_iqueue(queue, &msg[i]));
+   }
+   for (int i = 0; i < 3; ++i) {
+      TEST(0 == send_iqbuffer(buffer, &msg[i]));
+   }
+   for (int i = 0; i < 3; ++i) {
+      TEST(0 == pthread_create(&thr[i], 0, &thread_recv_delayed, queue));
+   }
+   TEST(0 == flush_iqbuffer(buffer));
+   TEST(0 == size_iqbuffer(buffer));
+   for (int i = 0; i < 3; ++i) {
+      TEST(0 == pthread_join(thr[i], 0));
+   }
+   TEST(255 == size_iqueue(queue));
+   for (int i = 3; i < 255; ++i) {
+      TEST(0 == tryrecv_iqueue(queue, &rmsg));
+      TEST(&msg[i] == rmsg);
+   }
+   for (int i = 0; i < 3; ++i) {
+      TEST(0 == tryrecv_iqueue(queue, &rmsg));
+      TEST(&msg[i] == rmsg);
+   }
+   PASS();
+
+   // TEST flush_iqbuffer: EPIPE keeps messages
+   TEST(0 == send_iqbuffer(buffer, &msg[0]));
+   TEST(0 == send_iqbuffer(buffer, &msg[1]));
+   close_iqueue(queue);
+   TEST(EPIPE == flush_iqbuffer(buffer));
+   TEST(2 == size_iqbuffer(buffer));
+   TEST(&msg[0] == buffer->msg[0]);
+   TEST(&msg[1] == buffer->msg[1]);
+   TEST(EPIPE == delete_iqbuffer(&buffer));
+   TEST(0 == buffer);
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
+}
+
+static void test_capture(void)
+{
+#ifdef IQUEUE_CAPTURE
+   iqueue_t*  queue = 0;
+   iqueue1_t* queue1 = 0;
+   int        msg[4];
+   void*      rmsg[4];
+   size_t     nr;
+   char       filename[64];
+   FILE*      file;
+   iqcaptureheader_t header;
+   iqcaptureevent_t  event[8];
+
+   // prepare
+   snprintf(filename, sizeof(filename), "/tmp/iqueue_test_capture.%d", (int)getpid());
+   TEST(0 == new_iqueue(&queue, 4));
+   TEST(0 == new_iqueue1(&queue1, 4));
+
+   // TEST start_iqcapture: EINVAL, EALREADY
+   TEST(EINVAL == stop_iqcapture());
+   TEST(EINVAL == start_iqcapture(filename, 0));
+   TEST(0 == start_iqcapture(filename, 5));
+   TEST(EALREADY == start_iqcapture(filename, 5));
+   PASS();
+
+   // TEST stop_iqcapture: writes successful operations sorted by time, surplus is lost
+   TEST(0 == trysend_iqueue(queue, &msg[0]));
+   TEST(0 == tryrecv_iqueue(queue, &rmsg[0]));
+   TEST(EAGAIN == tryrecv_iqueue(queue, &rmsg[0]));
+   void* batch[3] = { &msg[1], &msg[2], &msg[3] };
+   TEST(0 == trysendn_iqueue1(queue1, batch, 3, &nr));
+   TEST(0 == tryrecvn_iqueue1(queue1, rmsg, 4, &nr));
+   TEST(0 == trysend_iqueue1(queue1, &msg[0]));
+   TEST(0 == tryrecv_iqueue1(queue1, &rmsg[0]));
+   TEST(0 == stop_iqcapture());
+   TEST(EINVAL == stop_iqcapture());
+   file = fopen(filename, "rb");
+   TEST(0 != file);
+   TEST(1 == fread(&header, sizeof(header), 1, file));
+   TEST(0 == memcmp(header.magic, "iqcapt1", 8));
+   TEST(5 == header.nrevent);
+   TEST(1 == header.nrlost);
+   TEST(5 == fread(event, sizeof(event[0]), 8, file));
+   TEST(0 == fclose(file));
+   TEST(0 == unlink(filename));
+   uint8_t type[5]  = { IQCAPTURE_SEND, IQCAPTURE_RECV, IQCAPTURE_SEND, IQCAPTURE_RECV, IQCAPTURE_SEND };
+   uint16_t nrmsg[5] = { 1, 1, 3, 3, 1 };
+   for (int i = 0; i < 5; ++i) {
+      TEST(i == 0 || event[i-1].time_nsec <= event[i].time_nsec);
+      TEST(1 == event[i].threadid);
+      TEST(type[i] == event[i].type);
+      TEST(nrmsg[i] == event[i].nrmsg);
+      TEST((i < 2 ? IQCAPTURE_IQUEUE : IQCAPTURE_IQUEUE1) == event[i].queuetype);
+      TEST(0 != event[i].queueid);
+      TEST((i < 2 ? event[0].queueid : event[2].queueid) == event[i].queueid);
+   }
+   TEST(event[0].queueid != event[2].queueid);
+   PASS();
+
+   // TEST stop_iqcapture: no events after stop
+   TEST(0 == trysend_iqueue(queue, &msg[0]));
+   TEST(0 == start_iqcapture(filename, 1));
+   TEST(0 == stop_iqcapture());
+   file = fopen(filename, "rb");
+   TEST(0 != file);
+   TEST(1 == fread(&header, sizeof(header), 1, file));
+   TEST(0 == header.nrevent);
+   TEST(0 == header.nrlost);
+   TEST(0 == fclose(file));
+   TEST(0 == unlink(filename));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
+   TEST(0 == delete_iqueue1(&queue1));
+#else
+   // TEST start_iqcapture, stop_iqcapture: ENOSYS
+   TEST(ENOSYS == start_iqcapture("iqueue.trace", 1));
+   TEST(ENOSYS == stop_iqcapture());
+   PASS();
+#endif
+}
+
+static void test_registry(void)
+{
+   iqueue_t*  queue = 0;
+   iqueue1_t* queue1 = 0;
+   char       buf[16384];
+   size_t     len;
+   void*      msg;
+   int        fd[2];
+   struct timespec deadline;
+
+   // prepare
+   TEST(0 == new_iqueue(&queue, 256));
+   TEST(0 == new_iqueue1(&queue1, 8));
+   TEST(0 == queue->regentry);
+   TEST(0 == queue1->regentry);
+
+   // TEST print_iqregistry: empty registry
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_JSON, &len));
+   TEST(0 == strcmp(buf, "{\"queues\":[\n]}\n"));
+   TEST(strlen(buf) == len);
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_PROMETHEUS, &len));
+   TEST(0 != strstr(buf, "# TYPE iqueue_depth gauge\n"));
+   TEST(0 == strstr(buf, "{queue="));
+   PASS();
+
+   // TEST register_iqueue, register_iqueue1: EINVAL, EEXIST
+   TEST(EINVAL == register_iqueue(queue, ""));
+   memset(buf, 'x', 256);
+   buf[256] = 0;
+   TEST(EINVAL == register_iqueue(queue, buf));
+   buf[255] = 0;
+   TEST(0 == register_iqueue(queue, buf));
+   TEST(0 != queue->regentry);
+   TEST(EEXIST == register_iqueue(queue, "q"));
+   TEST(0 == delete_iqueue(&queue));
+   TEST(0 == new_iqueue(&queue, 256));
+   TEST(0 == register_iqueue(queue, "orders"));
+   TEST(0 == register_iqueue1(queue1, "log\"1\""));
+   TEST(EEXIST == register_iqueue1(queue1, "log"));
+   PASS();
+
+   // TEST print_iqregistry: IQREGISTRY_PROMETHEUS
+   TEST(0 == trysend_iqueue(queue, &len));
+   TEST(0 == trysend_iqueue(queue, &len));
+   TEST(0 == tryrecv_iqueue(queue, &msg));
+   TEST(0 == trysend_iqueue1(queue1, &len));
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_PROMETHEUS, &len));
+   TEST(strlen(buf) == len);
+   TEST(0 != strstr(buf, "iqueue_depth{queue=\"orders\",type=\"iqueue\"} 1\n"));
+   TEST(0 != strstr(buf, "iqueue_depth{queue=\"log\\\"1\\\"\",type=\"iqueue1\"} 1\n"));
+   TEST(0 != strstr(buf, "iqueue_capacity{queue=\"orders\",type=\"iqueue\"} 256\n"));
+   TEST(0 != strstr(buf, "iqueue_capacity{queue=\"log\\\"1\\\"\",type=\"iqueue1\"} 8\n"));
+   TEST(0 != strstr(buf, "# TYPE iqueue_sent_total counter\niqueue_sent_total{queue=\"orders\",type=\"iqueue\"} 2\n#"));
+   TEST(0 != strstr(buf, "iqueue_received_total{queue=\"orders\",type=\"iqueue\"} 1\n#"));
+   TEST(0 != strstr(buf, "iqueue_waiting_readers{queue=\"orders\",type=\"iqueue\"} 0\n"));
+   TEST(0 != strstr(buf, "iqueue_waiting_writers{queue=\"log\\\"1\\\"\",type=\"iqueue1\"} 0\n"));
+   TEST(0 != strstr(buf, "iqueue_wait_seconds_bucket{queue=\"orders\",type=\"iqueue\",le=\"1e-06\"} 0\n"));
+   TEST(0 != strstr(buf, "iqueue_wait_seconds_bucket{queue=\"orders\",type=\"iqueue\",le=\"+Inf\"} 0\n"));
+   TEST(0 != strstr(buf, "iqueue_wait_seconds_count{queue=\"orders\",type=\"iqueue\"} 0\n"));
+   // orders is registered before log
+   TEST(strstr(buf, "iqueue_depth{queue=\"orders\"") < strstr(buf, "iqueue_depth{queue=\"log"));
+   PASS();
+
+   // TEST print_iqregistry: blocking paths record waiting time
+   deadline_after(&deadline, 20000);
+   TEST(0 == tryrecv_iqueue(queue, &msg));
+   TEST(ETIMEDOUT == timedrecv_iqueue(queue, &msg, &deadline));
+   TEST(0 == recv_iqueue1(queue1, &msg));
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_PROMETHEUS, &len));
+   TEST(0 != strstr(buf, "iqueue_wait_seconds_bucket{queue=\"orders\",type=\"iqueue\",le=\"0.001024\"} 0\n"));
+   TEST(0 != strstr(buf, "iqueue_wait_seconds_bucket{queue=\"orders\",type=\"iqueue\",le=\"+Inf\"} 1\n"));
+   TEST(0 != strstr(buf, "iqueue_wait_seconds_count{queue=\"orders\",type=\"iqueue\"} 1\n"));
+   TEST(0 == strstr(buf, "iqueue_wait_seconds_sum{queue=\"orders\",type=\"iqueue\"} 0\n"));
+   // recv_iqueue1 did not block
+   TEST(0 != strstr(buf, "iqueue_wait_seconds_count{queue=\"log\\\"1\\\"\",type=\"iqueue1\"} 0\n"));
+   PASS();
+
+   // TEST print_iqregistry: IQREGISTRY_JSON
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_JSON, &len));
+   TEST(strlen(buf) == len);
+   TEST(buf == strstr(buf, "{\"queues\":[\n{\"name\":\"orders\",\"type\":\"iqueue\",\"depth\":0,\"capacity\":256,\"sent\":2,\"received\":2,\"waiting_readers\":0,\"waiting_writers\":0,\"wait_sum_usec\":"));
+   TEST(0 != strstr(buf, ",\n{\"name\":\"log\\\"1\\\"\",\"type\":\"iqueue1\",\"depth\":0,\"capacity\":8,\"waiting_readers\":0,\"waiting_writers\":0,\"wait_sum_usec\":0,\"wait_buckets\":[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0]}\n]}\n"));
+   PASS();
+
+   // TEST print_iqregistry: ENOBUFS, EINVAL
+   size_t len2;
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_JSON, &len));
+   TEST(ENOBUFS == print_iqregistry(buf, len, IQREGISTRY_JSON, &len2));
+   TEST(len == len2);
+   TEST(len-1 == strlen(buf));
+   TEST(ENOBUFS == print_iqregistry(0, 0, IQREGISTRY_JSON, &len2));
+   TEST(len == len2);
+   TEST(EINVAL == print_iqregistry(buf, sizeof(buf), 0, &len2));
+   PASS();
+
+   // TEST write_iqregistry
+   TEST(0 == pipe(fd));
+   TEST(0 == write_iqregistry(fd[1], IQREGISTRY_JSON));
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_JSON, &len));
+   char buf2[sizeof(buf)];
+   TEST((ssize_t)len == read(fd[0], buf2, sizeof(buf2)));
+   TEST(0 == memcmp(buf, buf2, len));
+   TEST(EINVAL == write_iqregistry(fd[1], 3));
+   TEST(0 == close(fd[0]));
+   TEST(0 == close(fd[1]));
+   PASS();
+
+   // TEST delete_iqueue, delete_iqueue1: unregister queue
+   TEST(0 == delete_iqueue(&queue));
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_JSON, &len));
+   TEST(0 == strstr(buf, "orders"));
+   TEST(0 != strstr(buf, "log"));
+   TEST(0 == delete_iqueue1(&queue1));
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_JSON, &len));
+   TEST(0 == strcmp(buf, "{\"queues\":[\n]}\n"));
+   PASS();
+
+   // TEST register_iqueue: registry order after removal of last entry
+   TEST(0 == new_iqueue(&queue, 256));
+   TEST(0 == new_iqueue1(&queue1, 4));
+   TEST(0 == register_iqueue(queue, "a"));
+   TEST(0 == register_iqueue1(queue1, "b"));
+   TEST(0 == delete_iqueue1(&queue1));
+   TEST(0 == new_iqueue1(&queue1, 4));
+   TEST(0 == register_iqueue1(queue1, "c"));
+   TEST(0 == print_iqregistry(buf, sizeof(buf), IQREGISTRY_JSON, &len));
+   TEST(0 != strstr(buf, "\"a\""));
+   TEST(0 == strstr(buf, "\"b\""));
+   TEST(strstr(buf, "\"a\"") < strstr(buf, "\"c\""));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
+   TEST(0 == delete_iqueue1(&queue1));
+}
+
+#ifdef IQUEUE_PROFILE
+// Row of a table of a profile report.
+typedef struct profilerow_t {
+   unsigned           rank;
+   unsigned long long count;
+   char               location[32]; // location or cache line in the cache line table
+   char               line[32];     // last field: cache line
+} profilerow_t;
+
+// Parses the rows of table (0: locations, 1: cache lines) of a profile report into row[].
+// The fields are separated by whitespace, the cache line is always the last one.
+// Returns nr of parsed rows.
+static size_t parse_profile(const char* report, int table, /*out*/profilerow_t* row, size_t maxrow)
+{
+   size_t nrrow = 0;
+   int    t = -1;
+
+   for (const char* next = report; *next; ) {
+      char   text[256];
+      size_t len = strcspn(next, "\n");
+      snprintf(text, sizeof(text), "%.*s", (int) len, next);
+      next += len + (next[len] == '\n');
+      char first[16] = "";
+      sscanf(text, "%15s", first);
+      if (0 == strcmp(first, "rank")) {
+         ++ t;
+         continue;
+      }
+      const char* last = strrchr(text, ' ');
+      if (t != table || nrrow == maxrow || !last) continue;
+      if (  3 == sscanf(text, "%u %llu %*s %31s", &row[nrrow].rank, &row[nrrow].count, row[nrrow].location)
+         && 1 == sscanf(last, "%31s", row[nrrow].line)) {
+         ++ nrrow;
+      }
+   }
+
+   return nrrow;
+}
+
+// Returns row of location or 0.
+static const profilerow_t* find_profile(const profilerow_t* row, size_t nrrow, const char* location)
+{
+   for (size_t i = 0; i < nrrow; ++i) {
+      if (0 == strcmp(row[i].location, location)) return &row[i];
+   }
+   return 0;
+}
+#endif
+
+static void test_profile(void)
+{
+#ifdef IQUEUE_PROFILE
+   iqueue_t* queue = 0;
+   char      buf[65536];
+   size_t    len;
+   size_t    len2;
+   void*     msg;
+   int       fd[2];
+
+   // prepare
+   TEST(0 == new_iqueue(&queue, 256));
+   TEST(0 == reset_iqprofile());
+
+   // TEST print_iqprofile: no events
+   TEST(0 == print_iqprofile(buf, sizeof(buf), &len));
+   TEST(strlen(buf) == len);
+   TEST(buf == strstr(buf, "iqueue_t contention profile: 0 events\n"));
+   TEST(0 == strstr(buf, "sizefree["));
+   PASS();
+
+   // TEST print_iqprofile: failed reservations of sizefree / sizeused ranked by count
+   for (int i = 0; i < 256; ++i) {
+      TEST(0 == trysend_iqueue(queue, &len));
+   }
+   TEST(EAGAIN == trysend_iqueue(queue, &len));
+   TEST(EAGAIN == trysend_iqueue(queue, &len));
+   for (int i = 0; i < 256; ++i) {
+      TEST(0 == tryrecv_iqueue(queue, &msg));
+   }
+   TEST(EAGAIN == tryrecv_iqueue(queue, &msg));
+   TEST(0 == print_iqprofile(buf, sizeof(buf), &len));
+   TEST(strlen(buf) == len);
+   // every counter is skipped at least once after the previous reservation filled or emptied it
+   // (how often exactly depends on scheduling, a slow fetch-and-add adds events of readpos / writepos)
+   static profilerow_t row[1024];
+   static profilerow_t lines[1024];
+   unsigned long long  nrevent = 0;
+   unsigned long long  sumfree = 0;
+   unsigned long long  sumused = 0;
+   unsigned long long  sumrow  = 0;
+   unsigned long long  sumline = 0;
+   TEST(1 == sscanf(buf, "iqueue_t contention profile: %llu events\n", &nrevent));
+   size_t nrrow  = parse_profile(buf, 0, row, 1024);
+   size_t nrline = parse_profile(buf, 1, lines, 1024);
+   TEST(2*256 <= nrrow && nrrow < 1024);
+   TEST(1 <= nrline && nrline < nrrow);
+   for (unsigned i = 0; i < 256; ++i) {
+      char location[32];
+      snprintf(location, sizeof(location), "sizefree[%u]", i);
+      const profilerow_t* rowfree = find_profile(row, nrrow, location);
+      snprintf(location, sizeof(location), "sizeused[%u]", i);
+      const profilerow_t* rowused = find_profile(row, nrrow, location);
+      TEST(rowfree && 1 <= rowfree->count);
+      TEST(rowused && 1 <= rowused->count);
+      sumfree += rowfree->count;
+      sumused += rowused->count;
+   }
+   // the writer is rejected by a full queue twice, the reader by an empty queue only once
+   TEST(sumused < sumfree);
+   // rows are ranked by count
+   for (size_t i = 0; i < nrrow; ++i) {
+      TEST(i+1 == row[i].rank);
+      TEST(i == 0 || row[i-1].count >= row[i].count);
+      sumrow += row[i].count;
+   }
+   TEST(nrevent == sumrow);
+   // every cache line sums up the events of all locations it holds
+   for (size_t l = 0; l < nrline; ++l) {
+      unsigned long long sum = 0;
+      TEST(l+1 == lines[l].rank);
+      TEST(l == 0 || lines[l-1].count >= lines[l].count);
+      TEST(0 == strcmp(lines[l].location, lines[l].line));
+      for (size_t i = 0; i < nrrow; ++i) {
+         if (0 == strcmp(row[i].line, lines[l].line)) sum += row[i].count;
+      }
+      TEST(sum == lines[l].count);
+      sumline += lines[l].count;
+   }
+   TEST(nrevent == sumline);
+   TEST(0 == find_profile(row, nrrow, "ifree"));
+   TEST(0 == strstr(buf, "  msg"));
+   PASS();
+
+   // TEST print_iqprofile: ENOBUFS
+   TEST(ENOBUFS == print_iqprofile(buf, 10, &len2));
+   TEST(len == len2);
+   TEST(9 == strlen(buf));
+   PASS();
+
+   // TEST write_iqprofile
+   TEST(0 == pipe(fd));
+   TEST(0 == write_iqprofile(fd[1]));
+   TEST(0 == close(fd[1]));
+   TEST(0 == print_iqprofile(buf, sizeof(buf), &len));
+   char buf2[sizeof(buf)];
+   size_t nrread = 0;
+   for (ssize_t bytes; 0 < (bytes = read(fd[0], buf2 + nrread, sizeof(buf2) - nrread)); ) {
+      nrread += (size_t) bytes;
+   }
+   TEST(len == nrread);
+   TEST(0 == memcmp(buf, buf2, len));
+   TEST(0 == close(fd[0]));
+   PASS();
+
+   // TEST reset_iqprofile
+   TEST(0 == reset_iqprofile());
+   TEST(0 == print_iqprofile(buf, sizeof(buf), &len));
+   TEST(0 != strstr(buf, " 0 events\n"));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
+#else
+   char   buf[4] = "x";
+   size_t len = 1;
+
+   // TEST reset_iqprofile, print_iqprofile, write_iqprofile: ENOSYS
+   TEST(ENOSYS == reset_iqprofile());
+   TEST(ENOSYS == print_iqprofile(buf, sizeof(buf), &len));
+   TEST(0 == buf[0]);
+   TEST(0 == len);
+   TEST(ENOSYS == write_iqprofile(1));
+   PASS();
+#endif
+}
+
+static void* thr_lock1(void* param)
+{
+   iqueue1_t* queue = param;
+
+   TEST(0 == pthread_mutex_lock(&queue->writer.lock));
+   cmpxchg_atomicu32(&queue->closed, 0, 1);
+   TEST(0 == pthread_cond_wait(&queue->writer.cond, &queue->writer.lock));
+   TEST(0 == pthread_mutex_unlock(&queue->writer.lock));
+
+   TEST(0 == pthread_mutex_lock(&queue->reader.lock));
+   cmpxchg_atomicu32(&queue->closed, 1, 2);
+   TEST(0 == pthread_cond_wait(&queue->reader.cond, &queue->reader.lock));
+   TEST(0 == pthread_mutex_unlock(&queue->reader.lock));
+   cmpxchg_atomicu32(&queue->closed, 2, 3);
+
+   return 0;
+}
+
+static void test_initfree1(void)
+{
+   pthread_t thr;
+   iqueue1_t* queue = 0;
+
+   // TEST new_iqueue1: readpos / writepos / waiting threads / msg live on different cache lines
+   TEST(0 == new_iqueue1(&queue, 1));
+   TEST(0 == (uintptr_t)queue % SIZE_CACHELINE);
+   TEST(0 == offsetof(iqueue1_t, readpos) % SIZE_CACHELINE);
+   TEST(0 == offsetof(iqueue1_t, writepos) % SIZE_CACHELINE);
+   TEST(0 == offsetof(iqueue1_t, reader) % SIZE_CACHELINE);
+   TEST(0 == offsetof(iqueue1_t, writer) % SIZE_CACHELINE);
+   TEST(0 == offsetof(iqueue1_t, msg) % SIZE_CACHELINE);
+   TEST(offsetof(iqueue1_t, writepos) < offsetof(iqueue1_t, reader));
+   TEST(offsetof(iqueue1_t, writer) - offsetof(iqueue1_t, reader) >= sizeof(iqsignal_t));
+   TEST(offsetof(iqueue1_t, msg) - offsetof(iqueue1_t, writer) >= sizeof(iqsignal_t));
+   TEST(0 == delete_iqueue1(&queue));
+   PASS();
+
+   // TEST new_iqueue
+   TEST(0 == new_iqueue1(&queue, 12345));
+   TEST(0 != queue);
+   TEST(12345 == queue->capacity);
+   TEST(0 == queue->readpos);
+   TEST(0 == queue->writepos);
+   TEST(0 == queue->closed);
+   TEST(0 == queue->reader.waitcount);
+   TEST(0 == queue->writer.waitcount);
+   for (size_t i = 0; i < queue->capacity; ++i) {
+      TEST(0 == queue->msg[i]);
+   }
+   // test writelock + writecond
+   TEST(0 == pthread_create(&thr, 0, &thr_lock1, queue));
+   for (int i = 0; i < 100000; ++i) {
+      if (0 != cmpxchg_atomicu32(&queue->closed, 0, 0)) break;
+      sched_yield();
+   }
+   // thr_lock1 is waiting on writecond
+   TEST(1 == cmpxchg_atomicu32(&queue->closed, 0, 0));
+   TEST(0 == pthread_mutex_lock(&queue->writer.lock));
+   TEST(0 == pthread_cond_signal(&queue->writer.cond));
+   for (int i = 0; i < 10; ++i) {
+      sched_yield();
+      TEST(1 == cmpxchg_atomicu32(&queue->closed, 0, 0));
+   }
+   TEST(0 == pthread_mutex_unlock(&queue->writer.lock));
+   for (int i = 0; i < 100000; ++i) {
+      if (1 != cmpxchg_atomicu32(&queue->closed, 0, 0)) break;
+      sched_yield();
+   }
+   // thr_lock is waiting on readcond
+   TEST(2 == cmpxchg_atomicu32(&queue->closed, 0, 0));
+   TEST(0 == pthread_mutex_lock(&queue->reader.lock));
+   TEST(0 == pthread_cond_signal(&queue->reader.cond));
+   for (int i = 0; i < 10; ++i) {
+      sched_yield();
+      TEST(2 == cmpxchg_atomicu32(&queue->closed, 0, 0));
+   }
+   TEST(0 == pthread_mutex_unlock(&queue->reader.lock));
+   TEST(0 == pthread_join(thr, 0));
+   TEST(3 == cmpxchg_atomicu32(&queue->closed, 0, 0));
+   PASS();
+
+   // TEST delete_iqueue
+   TEST(0 == delete_iqueue1(&queue));
+   TEST(0 == queue);
+   PASS();
+
+   // TEST new_iqueue: different size parameter
+   for (size_t s = 1; s < 65536; s = (s << 1) + 33) {
+      TEST(0 == new_iqueue1(&queue, (uint16_t) s));
+      TEST(0 != queue);
+      TEST(s == queue->capacity);
+      TEST(0 == queue->readpos);
+      TEST(0 == queue->writepos);
+      TEST(0 == queue->closed);
+      TEST(0 == queue->reader.waitcount);
+      TEST(0 == queue->writer.waitcount);
+      for (size_t i = 0; i < queue->capacity; ++i) {
+         TEST(0 == queue->msg[i]);
+      }
+      TEST(0 == delete_iqueue1(&queue));
+      TEST(0 == queue);
+   }
+   PASS();
+
+   // TEST new_iqueue: EINVAL
+   TEST(EINVAL == new_iqueue1(&queue, 0));
+   PASS();
+}
+
+static void test_query1(void)
+{
+   iqueue1_t* queue = 0;
+
+   // prepare
+   TEST(0 == new_iqueue1(&queue, 128));
+
+   // TEST capacity_iqueue
+   TEST(128 == capacity_iqueue1(queue));
+   PASS();
+
+   // TEST size_iqueue
+   TEST(0 == size_iqueue1(queue));
+   PASS();
+
+   // TEST capacity_iqueue1: returns value from capacity
+   queue->capacity = 0;
+   TEST(0 == capacity_iqueue1(queue));
+   for (uint32_t i = 1; i; i = (uint16_t)(i << 1)) {
+      queue->capacity = i;
+      TEST(i == capacity_iqueue1(queue));
+   }
+   queue->capacity = 128;
+   PASS();
+
+   // TEST size_iqueue: readpos < writepos
+   for (uint32_t i = 1; i; i = (i << 1)) {
+      queue->readpos  = 0;
+      queue->writepos = i;
+      TEST(i == size_iqueue1(queue));
+   }
+   for (uint32_t i = 1; i; i = (i << 1)) {
+      for (uint32_t s = 10; s; --s) {
+         queue->readpos = i;
+         queue->writepos = (i+s);
+         TEST(s == size_iqueue1(queue));
+      }
+   }
+   PASS();
+
+   // TEST size_iqueue: writepos < readpos
+   for (uint32_t i = 1; i; i = (i << 1)) {
+      for (uint32_t c = 65535; c >= 32768; c = (uint16_t)(c - (~c + 1))) {
+         queue->capacity = c;
+         queue->readpos  = i;
+         queue->writepos = 0;
+         TEST((iqpos_t)c - i == size_iqueue1(queue));
+      }
+   }
+   for (uint32_t i = 1; i; i = (i << 1)) {
+      for (uint32_t s = 10; s; --s) {
+         for (uint32_t c = 65535; c >= 32768; c = (uint16_t)(c - (~c + 1))) {
+            queue->capacity = c;
+            queue->readpos = (i+s);
+            queue->writepos = i;
+            TEST((c-s) == size_iqueue1(queue));
+         }
+      }
+   }
+   queue->capacity = 128;
+   PASS();
+
+   // TEST size_iqueue: writepos == readpos
+   for (uint32_t c = 1; c <= 128; ++c) {
+      // writepos == 0
+      queue->capacity = c;
+      queue->readpos  = 0;
+      queue->writepos = 0;
+      TEST(0 == size_iqueue1(queue));
+      queue->msg[c-1] = (void*) 1;
+      TEST(c == size_iqueue1(queue));
+      queue->msg[c-1] = (void*) 0;
+   }
+   for (uint32_t i = 1; i < 128; ++i) {
+      for (uint32_t c = 1; c <= 128; ++c) {
+         // writepos > 0
+         queue->capacity = c;
+         queue->readpos  = i;
+         queue->writepos = i;
+         TEST(0 == size_iqueue1(queue));
+         queue->msg[i-1] = (void*) 1;
+         TEST(c == size_iqueue1(queue));
+         queue->msg[i-1] = (void*) 0;
+      }
+   }
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue1(&queue));
+}
+
+void* thread_sendrange1(void* queue)
+{
+   uint32_t myid = 0;
+   struct range_t msg[2*QUEUESIZE];
+
+   for (uint32_t nr = 0; nr < 2*QUEUESIZE; ++nr) {
+      msg[nr].nr = MAXRANGE;
+   }
+
+   for (uint32_t nr = 0; nr < MAXRANGE; ++nr) {
+      uint32_t m = nr % (2*QUEUESIZE);
+      while (MAXRANGE != cmpxchg_atomicu32(&msg[m].nr, MAXRANGE, 0)) {
+         sched_yield(); // message in use
+      }
+      msg[m].tid = myid;
+      msg[m].nr  = nr;
+
+      for (int i = 0; ; ++i) {
+         int err = s_threadtry ? trysend_iqueue1(queue, &msg[m]) : send_iqueue1(queue, &msg[m]);
+         if (err == 0) break;
+         TEST(s_threadtry && err == EAGAIN);
+         sched_yield();
+         if (i == 1000000) {
+            printf("Sender starvation\n");
+            exit(1);
+         }
+      }
+   }
 
    wait_iqsignal(&s_threadsignal);
 
-   return 0;
+   return 0;
+}
+
+void* thread_recvrange1(void* queue)
+{
+   void* imsg;
+
+   for (;;) {
+      for (int i = 0; ; ++i) {
+         int err = s_threadtry ? tryrecv_iqueue1(queue, &imsg) : recv_iqueue1(queue, &imsg);
+         if (err == EPIPE) return 0;
+         if (err == 0) break;
+         TEST(err == EAGAIN);
+         sched_yield();
+         if (i == 1000000) {
+            printf("Receiver starvation\n");
+            exit(1);
+         }
+      }
+
+      struct range_t* rmsg = (struct range_t*) imsg;
+      TEST(rmsg->tid < MAXTHREAD);
+      TEST(rmsg->nr  < MAXRANGE);
+      s_flag[rmsg->tid][rmsg->nr] = (uint8_t) (s_flag[rmsg->tid][rmsg->nr] + 1);
+      // message processed
+      cmpxchg_atomicu32(&rmsg->nr, rmsg->nr, MAXRANGE);
+   }
+
+   return 0;
+}
+
+void test_single_sendrecv1(void)
+{
+   iqueue1_t* queue = 0;
+   pthread_t rthr;
+   pthread_t sthr;
+
+   for (int usetry = 0; usetry <= 1; ++usetry) {
+      memset(s_flag, 0, sizeof(s_flag));
+      // start threads
+      s_threadid  = 0;
+      s_threadtry = usetry;
+      TEST(0 == init_iqsignal(&s_threadsignal));
+      TEST(0 == new_iqueue1(&queue, QUEUESIZE));
+      TEST(0 == pthread_create(&sthr, 0, &thread_sendrange1, queue));
+      TEST(0 == pthread_create(&rthr, 0, &thread_recvrange1, queue));
+      for (int r = 0; r < MAXRANGE; ++r) {
+         int x = 0;
+         while (__sync_fetch_and_add(&s_flag[0][r], 0) == 0) {
+            sched_yield();
+            ++x;
+            if (x == 1000000) {
+               // DEBUG:
+               printf("usetry:%d rwait:%d wwait:%d wready:%d rpos:%d wpos:%d\n", usetry, queue->reader.waitcount, queue->writer.waitcount, s_threadsignal.waitcount, queue->readpos, queue->writepos);
+               x = 0;
+            }
+         }
+         // == DEBUG: PRINT PROGRESS (change 0 into 1) ==
+         if (0 && 0 == r % 1000) {
+            printf("%d: %d\n", 0, r);
+         }
+      }
+      close_iqueue1(queue);
+      // stop threads
+      TEST(0 == pthread_join(rthr, 0));
+      signal_iqsignal(&s_threadsignal);
+      TEST(0 == pthread_join(sthr, 0));
+      TEST(0 == delete_iqueue1(&queue));
+      TEST(0 == free_iqsignal(&s_threadsignal));
+      for (int r = 0; r < MAXRANGE; ++r) {
+         TEST(s_flag[0][r] == 1);
+      }
+      PASS();
+   }
+}
+
+static void test_batch1(void)
+{
+   iqueue1_t* queue = 0;
+   int    msg[10];
+   void*  smsg[10];
+   void*  rmsg[10];
+   size_t nr;
+
+   // prepare
+   for (int i = 0; i < 10; ++i) {
+      smsg[i] = &msg[i];
+   }
+   TEST(0 == new_iqueue1(&queue, 7));
+
+   // TEST tryrecvn_iqueue1: EAGAIN
+   nr = 1;
+   TEST(EAGAIN == tryrecvn_iqueue1(queue, rmsg, 10, &nr));
+   TEST(0 == nr);
+   PASS();
+
+   // TEST trysendn_iqueue1, tryrecvn_iqueue1: wrap around
+   for (unsigned r = 0; r < 7; ++r) {
+      TEST(0 == trysendn_iqueue1(queue, smsg, 3, &nr));
+      TEST(3 == nr);
+      TEST((3+3*r) % 7 == queue->writepos);
+      TEST(3 == size_iqueue1(queue));
+      memset(rmsg, 0, sizeof(rmsg));
+      TEST(0 == tryrecvn_iqueue1(queue, rmsg, 10, &nr));
+      TEST(3 == nr);
+      TEST((3+3*r) % 7 == queue->readpos);
+      for (int i = 0; i < 3; ++i) {
+         TEST(rmsg[i] == &msg[i]);
+      }
+      TEST(0 == rmsg[3]);
+      TEST(0 == size_iqueue1(queue));
+   }
+   PASS();
+
+   // TEST trysendn_iqueue1: partial + EAGAIN if full
+   TEST(0 == trysendn_iqueue1(queue, smsg, 10, &nr));
+   TEST(7 == nr);
+   TEST(7 == size_iqueue1(queue));
+   TEST(EAGAIN == trysendn_iqueue1(queue, smsg, 10, &nr));
+   TEST(0 == nr);
+   TEST(EAGAIN == trysend_iqueue1(queue, smsg[0]));
+   PASS();
+
+   // TEST tryrecvn_iqueue1: partial
+   TEST(0 == tryrecvn_iqueue1(queue, rmsg, 2, &nr));
+   TEST(2 == nr);
+   TEST(rmsg[0] == &msg[0] && rmsg[1] == &msg[1]);
+   TEST(0 == tryrecv_iqueue1(queue, &rmsg[0]));
+   TEST(rmsg[0] == &msg[2]);
+   TEST(0 == tryrecvn_iqueue1(queue, rmsg, 10, &nr));
+   TEST(4 == nr);
+   for (int i = 0; i < 4; ++i) {
+      TEST(rmsg[i] == &msg[3+i]);
+   }
+   PASS();
+
+   // TEST tryrecvn_iqueue1: run of filled slots is stopped by empty slot (vectorized scan)
+   {
+      iqueue1_t* queue2 = 0;
+      int   msg2[40];
+      void* smsg2[40];
+      void* rmsg2[40];
+      for (int i = 0; i < 40; ++i) {
+         smsg2[i] = &msg2[i];
+      }
+      TEST(0 == new_iqueue1(&queue2, 37));
+      for (iqpos_t start = 0; start < 37; ++start) {
+         for (iqpos_t len = 0; len <= 30; ++len) {
+            queue2->readpos = queue2->writepos = start;
+            if (len) {
+               TEST(0 == trysendn_iqueue1(queue2, smsg2, len, &nr));
+               TEST(len == nr);
+            }
+            // filled slot after the empty one
+            queue2->msg[(start+len+1) % 37] = &msg2[39];
+            memset(rmsg2, 0, sizeof(rmsg2));
+            TEST((len ? 0 : EAGAIN) == tryrecvn_iqueue1(queue2, rmsg2, 36, &nr));
+            TEST(len == nr);
+            TEST((start+len) % 37 == queue2->readpos);
+            for (iqpos_t i = 0; i < len; ++i) {
+               TEST(rmsg2[i] == &msg2[i]);
+            }
+            TEST(0 == rmsg2[len]);
+            queue2->msg[(start+len+1) % 37] = 0;
+            for (iqpos_t i = 0; i < 37; ++i) {
+               TEST(0 == queue2->msg[i]);
+            }
+         }
+      }
+      TEST(0 == delete_iqueue1(&queue2));
+   }
+   PASS();
+
+   // TEST trysendn_iqueue1: EINVAL
+   smsg[2] = 0;
+   TEST(EINVAL == trysendn_iqueue1(queue, smsg, 3, &nr));
+   TEST(0 == size_iqueue1(queue));
+   smsg[2] = &msg[2];
+   PASS();
+
+   // TEST trysendn_iqueue1, tryrecvn_iqueue1: EPIPE
+   close_iqueue1(queue);
+   TEST(EPIPE == trysendn_iqueue1(queue, smsg, 3, &nr));
+   TEST(EPIPE == tryrecvn_iqueue1(queue, rmsg, 3, &nr));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue1(&queue));
+}
+
+static void* thread_recv1(void* queue)
+{
+   void* msg = 0;
+   TEST(0 == recv_iqueue1(queue, &msg));
+   return msg;
+}
+
+#define NRMSG_SPLICE 100000
+
+static void* thread_sendn_splice(void* queue)
+{
+   void*  msg[64];
+   size_t nr;
+
+   for (uintptr_t i = 1; i <= NRMSG_SPLICE; ) {
+      size_t n = 0;
+      for (; n < 64 && i+n <= NRMSG_SPLICE; ++n) {
+         msg[n] = (void*) (i+n);
+      }
+      while (trysendn_iqueue1(queue, msg, n, &nr)) sched_yield();
+      i += nr;
+   }
+
+   return 0;
+}
+
+static void* thread_recvn_splice(void* queue)
+{
+   void*  msg[64];
+   size_t nr;
+
+   for (uintptr_t i = 1; i <= NRMSG_SPLICE; ) {
+      while (tryrecvn_iqueue1(queue, msg, 64, &nr)) sched_yield();
+      for (size_t r = 0; r < nr; ++r, ++i) {
+         TEST(msg[r] == (void*) i);
+      }
+   }
+
+   return 0;
+}
+
+static void test_splice1(void)
+{
+   iqueue1_t* src  = 0;
+   iqueue1_t* dest = 0;
+   pthread_t  thr;
+   pthread_t  thr2;
+   int        msg[100];
+   void*      rmsg;
+   size_t     nr;
+
+   // prepare
+   TEST(0 == new_iqueue1(&src, 100));
+   TEST(0 == new_iqueue1(&dest, 30));
+
+   // TEST splice_iqueue1: EAGAIN
+   nr = 1;
+   TEST(EAGAIN == splice_iqueue1(dest, src, 10, &nr));
+   TEST(0 == nr);
+   PASS();
+
+   // TEST splice_iqueue1: moves up to maxn messages in order
+   for (int i = 0; i < 100; ++i) {
+      TEST(0 == trysend_iqueue1(src, &msg[i]));
+   }
+   TEST(0 == splice_iqueue1(dest, src, 10, &nr));
+   TEST(10 == nr);
+   TEST(90 == size_iqueue1(src));
+   TEST(10 == size_iqueue1(dest));
+   PASS();
+
+   // TEST splice_iqueue1: stops if dest is full
+   TEST(0 == splice_iqueue1(dest, src, 1000, &nr));
+   TEST(20 == nr);
+   TEST(70 == size_iqueue1(src));
+   TEST(30 == size_iqueue1(dest));
+   TEST(EAGAIN == splice_iqueue1(dest, src, 1000, &nr));
+   TEST(0 == nr);
+   for (int i = 0; i < 30; ++i) {
+      TEST(0 == tryrecv_iqueue1(dest, &rmsg));
+      TEST(rmsg == &msg[i]);
+   }
+   PASS();
+
+   // TEST splice_iqueue1: stops if src is empty
+   TEST(0 == splice_iqueue1(dest, src, 1000, &nr));
+   TEST(30 == nr);
+   for (int i = 30; i < 60; ++i) {
+      TEST(0 == tryrecv_iqueue1(dest, &rmsg));
+      TEST(rmsg == &msg[i]);
+   }
+   TEST(0 == splice_iqueue1(dest, src, 1000, &nr));
+   TEST(30 == nr);
+   for (int i = 60; i < 90; ++i) {
+      TEST(0 == tryrecv_iqueue1(dest, &rmsg));
+      TEST(rmsg == &msg[i]);
+   }
+   TEST(0 == splice_iqueue1(dest, src, 1000, &nr));
+   TEST(10 == nr);
+   TEST(0 == size_iqueue1(src));
+   TEST(EAGAIN == splice_iqueue1(dest, src, 1000, &nr));
+   for (int i = 90; i < 100; ++i) {
+      TEST(0 == tryrecv_iqueue1(dest, &rmsg));
+      TEST(rmsg == &msg[i]);
+   }
+   PASS();
+
+   // TEST splice_iqueue1: wakes up waiting reader of dest
+   TEST(0 == pthread_create(&thr, 0, &thread_recv1, dest));
+   for (int wc = 0; wc < 100000; ++wc) {
+      sched_yield();
+      if (cmpxchg_atomicsize(&dest->reader.waitcount, 0, 0)) break;
+   }
+   TEST(0 == pthread_mutex_lock(&dest->reader.lock));
+   TEST(1 == dest->reader.waitcount);
+   TEST(0 == pthread_mutex_unlock(&dest->reader.lock));
+   TEST(0 == trysend_iqueue1(src, &msg[0]));
+   TEST(0 == splice_iqueue1(dest, src, 1000, &nr));
+   TEST(1 == nr);
+   TEST(0 == pthread_join(thr, &rmsg));
+   TEST(rmsg == &msg[0]);
+   PASS();
+
+   // TEST splice_iqueue1: concurrent writer of src and reader of dest
+   TEST(0 == pthread_create(&thr, 0, &thread_sendn_splice, src));
+   TEST(0 == pthread_create(&thr2, 0, &thread_recvn_splice, dest));
+   for (size_t total = 0; total < NRMSG_SPLICE; total += nr) {
+      if (splice_iqueue1(dest, src, (size_t)-1, &nr)) sched_yield();
+   }
+   TEST(0 == pthread_join(thr, 0));
+   TEST(0 == pthread_join(thr2, 0));
+   TEST(0 == size_iqueue1(src));
+   TEST(0 == size_iqueue1(dest));
+   PASS();
+
+   // TEST splice_iqueue1: EINVAL, EPIPE
+   TEST(EINVAL == splice_iqueue1(src, src, 1, &nr));
+   close_iqueue1(dest);
+   TEST(EPIPE == splice_iqueue1(dest, src, 1, &nr));
+   TEST(EPIPE == splice_iqueue1(src, dest, 1, &nr));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue1(&src));
+   TEST(0 == delete_iqueue1(&dest));
+}
+
+static void* thread_recv_delayed1(void* queue)
+{
+   void* msg;
+   usleep(10000);
+   TEST(0 == recv_iqueue1(queue, &msg));
+   return msg;
+}
+
+static void test_timed1(void)
+{
+   iqueue1_t* queue = 0;
+   pthread_t thr;
+   int       msg[4];
+   void*     rmsg;
+   struct timespec deadline;
+   uint64_t  start;
+
+   // prepare
+   TEST(0 == new_iqueue1(&queue, 4));
+
+   // TEST timedrecv_iqueue1: ETIMEDOUT
+   start = monotonic_usec();
+   deadline_after(&deadline, 20000);
+   TEST(ETIMEDOUT == timedrecv_iqueue1(queue, &rmsg, &deadline));
+   TEST(monotonic_usec() - start >= 20000);
+   TEST(0 == queue->reader.waitcount);
+   // deadline in the past
+   TEST(ETIMEDOUT == timedrecv_iqueue1(queue, &rmsg, &deadline));
+   PASS();
+
+   // TEST timedsend_iqueue1, timedrecv_iqueue1: EINVAL (tv_nsec out of range)
+   for (int i = 0; i < 2; ++i) {
+      size_t signalcount = queue->reader.signalcount;
+      struct timespec invalid = deadline;
+      invalid.tv_nsec = i ? -1 : 2000000000;
+      TEST(EINVAL == timedrecv_iqueue1(queue, &rmsg, &invalid));
+      TEST(0 == queue->reader.waitcount);
+      TEST(signalcount == queue->reader.signalcount);
+      TEST(EINVAL == timedsend_iqueue1(queue, &msg[0], &invalid));
+      TEST(EAGAIN == tryrecv_iqueue1(queue, &rmsg));
+   }
+   PASS();
+
+   // TEST timedsend_iqueue1, timedrecv_iqueue1: no waiting
+   deadline_after(&deadline, 0);
+   for (int i = 0; i < 4; ++i) {
+      TEST(0 == timedsend_iqueue1(queue, &msg[i], &deadline));
+   }
+   PASS();
+
+   // TEST timedsend_iqueue1: ETIMEDOUT
+   start = monotonic_usec();
+   deadline_after(&deadline, 20000);
+   TEST(ETIMEDOUT == timedsend_iqueue1(queue, &msg[0], &deadline));
+   TEST(monotonic_usec() - start >= 20000);
+   TEST(0 == queue->writer.waitcount);
+   PASS();
+
+   // TEST timedsend_iqueue1: woken up by reader before deadline
+   TEST(0 == pthread_create(&thr, 0, &thread_recv_delayed1, queue));
+   deadline_after(&deadline, 10000000);
+   TEST(0 == timedsend_iqueue1(queue, &msg[0], &deadline));
+   TEST(0 == pthread_join(thr, &rmsg));
+   TEST(rmsg == &msg[0]);
+   for (int i = 1; i < 4; ++i) {
+      TEST(0 == timedrecv_iqueue1(queue, &rmsg, &deadline));
+      TEST(rmsg == &msg[i]);
+   }
+   TEST(0 == timedrecv_iqueue1(queue, &rmsg, &deadline));
+   TEST(rmsg == &msg[0]);
+   PASS();
+
+   // TEST timedsend_iqueue1, timedrecv_iqueue1: EPIPE
+   close_iqueue1(queue);
+   TEST(EPIPE == timedsend_iqueue1(queue, &msg[0], &deadline));
+   TEST(EPIPE == timedrecv_iqueue1(queue, &rmsg, &deadline));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue1(&queue));
+}
+
+typedef struct cancelparam_t {
+   void*       queue;
+   iqcancel_t* cancel;
+   void*       msg;
+   int         err;
+} cancelparam_t;
+
+static void* thread_waitrecv_cancel(void* param)
+{
+   cancelparam_t* p = param;
+   p->err = waitrecv_iqueue(p->queue, &p->msg, 0, p->cancel);
+   return 0;
+}
+
+static void* thread_waitsend1_cancel(void* param)
+{
+   cancelparam_t* p = param;
+   p->err = waitsend_iqueue1(p->queue, p->msg, 0, p->cancel);
+   return 0;
+}
+
+static void test_cancel(void)
+{
+   iqueue_t*  queue  = 0;
+   iqueue1_t* queue1 = 0;
+   iqcancel_t cancel[2];
+   cancelparam_t param[2];
+   pthread_t  thr[2];
+   int        msg[2];
+   void*      rmsg;
+
+   // prepare
+   TEST(0 == new_iqueue(&queue, 1));
+   TEST(0 == new_iqueue1(&queue1, 1));
+
+   // TEST init_iqcancel
+   memset(cancel, 255, sizeof(cancel));
+   init_iqcancel(&cancel[0]);
+   init_iqcancel(&cancel[1]);
+   TEST(0 == cancel[0].canceled);
+   TEST(0 == cancel[0].signal);
+   PASS();
+
+   // TEST cancel_iqcancel: wakes up only the canceled reader
+   for (int i = 0; i < 2; ++i) {
+      param[i] = (cancelparam_t) { queue, &cancel[i], 0, -1 };
+      TEST(0 == pthread_create(&thr[i], 0, &thread_waitrecv_cancel, &param[i]));
+   }
+   for (int wc = 0; wc < 100000; ++wc) {
+      sched_yield();
+      if (2 == cmpxchg_atomicsize(&queue->reader.waitcount, 0, 0)) break;
+   }
+   TEST(0 == pthread_mutex_lock(&queue->reader.lock));
+   TEST(2 == queue->reader.waitcount);
+   TEST(cancel[0].signal == &queue->reader);
+   TEST(cancel[1].signal == &queue->reader);
+   TEST(0 == pthread_mutex_unlock(&queue->reader.lock));
+   cancel_iqcancel(&cancel[0]);
+   TEST(1 == cancel[0].canceled);
+   TEST(0 == pthread_join(thr[0], 0));
+   TEST(ECANCELED == param[0].err);
+   TEST(0 == cancel[0].signal);
+   TEST(1 == cmpxchg_atomicsize(&queue->reader.waitcount, 0, 0));
+   TEST(-1 == param[1].err);
+   // other reader receives message
+   TEST(0 == send_iqueue(queue, &msg[1]));
+   TEST(0 == pthread_join(thr[1], 0));
+   TEST(0 == param[1].err);
+   TEST(&msg[1] == param[1].msg);
+   TEST(0 == cancel[1].signal);
+   TEST(0 == queue->reader.waitcount);
+   PASS();
+
+   // TEST waitrecv_iqueue: canceled handle returns ECANCELED instead of waiting
+   TEST(ECANCELED == waitrecv_iqueue(queue, &rmsg, 0, &cancel[0]));
+   // message available ==> no waiting
+   TEST(0 == trysend_iqueue(queue, &msg[0]));
+   TEST(0 == waitrecv_iqueue(queue, &rmsg, 0, &cancel[0]));
+   TEST(rmsg == &msg[0]);
+   PASS();
+
+   // TEST cancel_iqcancel: wakes up waiting writer
+   init_iqcancel(&cancel[0]);
+   TEST(0 == trysend_iqueue1(queue1, &msg[0]));
+   param[0] = (cancelparam_t) { queue1, &cancel[0], &msg[1], -1 };
+   TEST(0 == pthread_create(&thr[0], 0, &thread_waitsend1_cancel, &param[0]));
+   for (int wc = 0; wc < 100000; ++wc) {
+      sched_yield();
+      if (cmpxchg_atomicsize(&queue1->writer.waitcount, 0, 0)) break;
+   }
+   cancel_iqcancel(&cancel[0]);
+   TEST(0 == pthread_join(thr[0], 0));
+   TEST(ECANCELED == param[0].err);
+   TEST(0 == queue1->writer.waitcount);
+   TEST(1 == size_iqueue1(queue1));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue(&queue));
+   TEST(0 == delete_iqueue1(&queue1));
+}
+
+static void test_reset1(void)
+{
+   iqueue1_t* queue = 0;
+   int        msg;
+   void*      rmsg;
+
+   // prepare
+   TEST(0 == new_iqueue1(&queue, 3));
+
+   // TEST reset_iqueue1: EINVAL (not closed)
+   TEST(EINVAL == reset_iqueue1(queue));
+   PASS();
+
+   // TEST reset_iqueue1: EBUSY (not empty / full)
+   TEST(0 == trysend_iqueue1(queue, &msg));
+   close_iqueue1(queue);
+   TEST(EBUSY == reset_iqueue1(queue));
+   queue->closed = 0;
+   TEST(0 == trysend_iqueue1(queue, &msg));
+   TEST(0 == trysend_iqueue1(queue, &msg));
+   TEST(0 == tryrecv_iqueue1(queue, &rmsg));
+   TEST(0 == trysend_iqueue1(queue, &msg));
+   TEST(queue->readpos == queue->writepos);
+   close_iqueue1(queue);
+   TEST(EBUSY == reset_iqueue1(queue));
+   queue->closed = 0;
+   for (int i = 0; i < 3; ++i) {
+      TEST(0 == tryrecv_iqueue1(queue, &rmsg));
+   }
+   PASS();
+
+   // TEST reset_iqueue1: reopens drained queue
+   TEST(0 != queue->readpos);
+   close_iqueue1(queue);
+   TEST(0 == reset_iqueue1(queue));
+   TEST(0 == queue->closed);
+   TEST(0 == queue->readpos);
+   TEST(0 == queue->writepos);
+   TEST(0 == trysend_iqueue1(queue, &msg));
+   TEST(0 == tryrecv_iqueue1(queue, &rmsg));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue1(&queue));
+}
+
+static void test_pool(void)
+{
+   iqpool_t*  pool = 0;
+   iqueue1_t* queue[3];
+   iqueue1_t* queue2;
+   int        msg;
+   void*      rmsg;
+
+   // TEST new_iqpool, delete_iqpool
+   TEST(0 == new_iqpool(&pool, 2));
+   TEST(0 != pool);
+   TEST(2 == pool->maxfree);
+   for (int i = 0; i < 32; ++i) {
+      TEST(0 == pool->sizeclass[i].nrfree);
+      TEST(0 == pool->sizeclass[i].free);
+   }
+   TEST(0 == delete_iqpool(&pool));
+   TEST(0 == pool);
+   TEST(0 == delete_iqpool(&pool));
+   PASS();
+
+   // prepare
+   TEST(0 == new_iqpool(&pool, 2));
+
+   // TEST get_iqpool: EINVAL
+   TEST(EINVAL == get_iqpool(pool, &queue[0], 0));
+   PASS();
+
+   // TEST get_iqpool: capacity rounded up to power of two
+   for (iqpos_t c = 1; c <= 1000; c = 3*c+1) {
+      TEST(0 == get_iqpool(pool, &queue[0], c));
+      TEST(c <= queue[0]->capacity && queue[0]->capacity < 2*c);
+      TEST(0 == (queue[0]->capacity & (queue[0]->capacity-1)));
+      put_iqpool(pool, &queue[0]);
+      TEST(0 == queue[0]);
+   }
+   PASS();
+
+   // TEST put_iqpool, get_iqpool: reuse closed queue
+   for (int i = 0; i < 3; ++i) {
+      TEST(0 == get_iqpool(pool, &queue[i], 16));
+   }
+   for (int i = 0; i < 3; ++i) {
+      TEST(0 == trysend_iqueue1(queue[i], &msg));
+      TEST(0 == tryrecv_iqueue1(queue[i], &rmsg));
+   }
+   put_iqpool(pool, &queue[0]);
+   put_iqpool(pool, &queue[1]);
+   put_iqpool(pool, &queue[2]); // pool full ==> deleted
+   TEST(2 == pool->sizeclass[4].nrfree);
+   queue2 = pool->sizeclass[4].free;
+   TEST(0 == get_iqpool(pool, &queue[0], 9));
+   TEST(queue2 == queue[0]);
+   TEST(1 == pool->sizeclass[4].nrfree);
+   TEST(0 == queue[0]->closed);
+   TEST(0 == queue[0]->readpos);
+   TEST(0 == queue[0]->writepos);
+   for (iqpos_t i = 0; i < queue[0]->capacity; ++i) {
+      TEST(0 == queue[0]->msg[i]);
+   }
+   PASS();
+
+   // TEST put_iqpool: not empty queue is deleted
+   TEST(0 == trysend_iqueue1(queue[0], &msg));
+   put_iqpool(pool, &queue[0]);
+   TEST(0 == queue[0]);
+   TEST(1 == pool->sizeclass[4].nrfree);
+   PASS();
+
+   // TEST put_iqpool: capacity not power of two ==> deleted
+   TEST(0 == new_iqueue1(&queue2, 3));
+   uint32_t nrfree = pool->sizeclass[2].nrfree;
+   put_iqpool(pool, &queue2);
+   TEST(0 == queue2);
+   TEST(0 == pool->sizeclass[1].nrfree);
+   TEST(nrfree == pool->sizeclass[2].nrfree);
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqpool(&pool));
+}
+
+iqueue_STATIC(staticq, int, 8)
+iqueue1_STATIC(staticq1, int, 5)
+
+static staticq1_t s_staticq1;
+
+static void* thread_recv_static1(void* queue)
+{
+   int* msg;
+   TEST(0 == recv_staticq1(queue, &msg));
+   return msg;
+}
+
+static void test_static(void)
+{
+   staticq_t  queue;
+   int        msg[5];
+   int*       rmsg;
+   pthread_t  thr;
+   size_t     nrofbytes;
+   size_t     nrofbytes2;
+
+   // TEST init_iqueue, init_iqueue1: EINVAL
+   TEST(EINVAL == init_iqueue(&queue.queue, 0));
+   TEST(EINVAL == init_iqueue(&queue.queue, 6));
+   TEST(EINVAL == init_iqueue1(&s_staticq1.queue, 0));
+   PASS();
+
+   // TEST init_staticq, init_staticq1: no heap memory
+   TEST(0 == allocated_bytes(&nrofbytes));
+   TEST(0 == init_staticq(&queue));
+   TEST(0 == init_staticq1(&s_staticq1));
+   TEST(0 == allocated_bytes(&nrofbytes2));
+   TEST(nrofbytes == nrofbytes2);
+   TEST(8 == capacity_iqueue(&queue.queue));
+   TEST(5 == capacity_iqueue1(&s_staticq1.queue));
+   TEST(queue.queue.msg == queue.storage);
+   TEST(s_staticq1.queue.msg == s_staticq1.storage);
+   PASS();
+
+   // TEST staticq_t, staticq1_t: aligned to a cache line
+   TEST(SIZE_CACHELINE == __alignof__(staticq_t));
+   TEST(SIZE_CACHELINE == __alignof__(staticq1_t));
+   TEST(0 == (uintptr_t)&queue % SIZE_CACHELINE);
+   TEST(0 == (uintptr_t)&s_staticq1 % SIZE_CACHELINE);
+   PASS();
+
+   // TEST trysend_staticq, tryrecv_staticq
+   for (int r = 0; r < 3; ++r) {
+      for (int i = 0; i < 8; ++i) {
+         TEST(0 == trysend_staticq(&queue, &msg[i%5]));
+      }
+      TEST(EAGAIN == trysend_staticq(&queue, &msg[0]));
+      TEST(8 == size_iqueue(&queue.queue));
+      for (int i = 0; i < 8; ++i) {
+         TEST(0 == tryrecv_staticq(&queue, &rmsg));
+         TEST(&msg[i%5] == rmsg);
+      }
+      TEST(EAGAIN == tryrecv_staticq(&queue, &rmsg));
+   }
+   PASS();
+
+   // TEST trysend_staticq1, tryrecv_staticq1: inlined fast path wraps around capacity
+   for (int r = 0; r < 3; ++r) {
+      TEST(EINVAL == trysend_staticq1(&s_staticq1, 0));
+      for (int i = 0; i < 5; ++i) {
+         TEST(0 == trysend_staticq1(&s_staticq1, &msg[i]));
+      }
+      TEST(EAGAIN == trysend_staticq1(&s_staticq1, &msg[0]));
+      TEST(5 == size_iqueue1(&s_staticq1.queue));
+      for (int i = 0; i < 5; ++i) {
+         TEST(0 == tryrecv_staticq1(&s_staticq1, &rmsg));
+         TEST(&msg[i] == rmsg);
+      }
+      TEST(EAGAIN == tryrecv_staticq1(&s_staticq1, &rmsg));
+      TEST(0 == trysend_staticq1(&s_staticq1, &msg[r]));
+      TEST(0 == tryrecv_iqueue1(&s_staticq1.queue, (void**)&rmsg));
+      TEST(&msg[r] == rmsg);
+   }
+   PASS();
+
+   // TEST recv_staticq1: blocking receive wakes up after send
+   TEST(0 == pthread_create(&thr, 0, &thread_recv_static1, &s_staticq1));
+   usleep(1000);
+   TEST(0 == send_staticq1(&s_staticq1, &msg[3]));
+   TEST(0 == pthread_join(thr, (void**)&rmsg));
+   TEST(&msg[3] == rmsg);
+   PASS();
+
+   // TEST close_staticq, close_staticq1: EPIPE
+   close_staticq(&queue);
+   close_staticq1(&s_staticq1);
+   TEST(EPIPE == trysend_staticq(&queue, &msg[0]));
+   TEST(EPIPE == trysend_staticq1(&s_staticq1, &msg[0]));
+   TEST(EPIPE == tryrecv_staticq1(&s_staticq1, &rmsg));
+   PASS();
+
+   // TEST free_staticq, free_staticq1
+   TEST(0 == free_staticq(&queue));
+   TEST(0 == free_staticq1(&s_staticq1));
+   PASS();
+}
+
+static void test_initfree_triple(void)
+{
+   iqtriple_t* triple = 0;
+
+   // TEST new_iqtriple
+   for (size_t bufsize = 1; bufsize < 1000; bufsize += 37) {
+      TEST(0 == new_iqtriple(&triple, bufsize));
+      TEST(0 != triple);
+      TEST(bufsize == bufsize_iqtriple(triple));
+      TEST(0 == triple->windex);
+      TEST(1 == triple->state);
+      TEST(2 == triple->rindex);
+      for (int i = 0; i < 3; ++i) {
+         TEST(0 != triple->buffer[i]);
+         if (i) TEST(triple->buffer[i-1] + bufsize <= triple->buffer[i]);
+         for (size_t b = 0; b < bufsize; ++b) {
+            TEST(0 == triple->buffer[i][b]);
+         }
+      }
+      TEST(triple->buffer[0] == writebuf_iqtriple(triple));
+      // TEST delete_iqtriple
+      TEST(0 == delete_iqtriple(&triple));
+      TEST(0 == triple);
+      TEST(0 == delete_iqtriple(&triple));
+      TEST(0 == triple);
+   }
+   PASS();
+
+   // TEST new_iqtriple: EINVAL
+   TEST(EINVAL == new_iqtriple(&triple, 0));
+   TEST(EINVAL == new_iqtriple(&triple, (size_t)-1));
+   TEST(0 == triple);
+   PASS();
+}
+
+static void test_publishread_triple(void)
+{
+   iqtriple_t* triple = 0;
+   const void* buf;
+
+   // prepare
+   TEST(0 == new_iqtriple(&triple, sizeof(int)));
+
+   // TEST read_iqtriple: EAGAIN (initial buffer is zeroed)
+   TEST(EAGAIN == read_iqtriple(triple, &buf));
+   TEST(triple->buffer[2] == buf);
+   TEST(0 == *(const int*)buf);
+   PASS();
+
+   // TEST publish_iqtriple: writer gets free buffer
+   for (int i = 1; i <= 3; ++i) {
+      int* wbuf = writebuf_iqtriple(triple);
+      TEST(wbuf != buf);
+      *wbuf = i;
+      publish_iqtriple(triple);
+      TEST(wbuf != writebuf_iqtriple(triple));
+      TEST(buf  != writebuf_iqtriple(triple));
+      TEST(IQTRIPLE_FRESH == (triple->state & IQTRIPLE_FRESH));
+   }
+   PASS();
+
+   // TEST read_iqtriple: latest value
+   TEST(0 == read_iqtriple(triple, &buf));
+   TEST(3 == *(const int*)buf);
+   TEST(0 == (triple->state & IQTRIPLE_FRESH));
+   TEST(buf != writebuf_iqtriple(triple));
+   PASS();
+
+   // TEST read_iqtriple: EAGAIN returns last value
+   for (int i = 0; i < 3; ++i) {
+      const void* buf2 = 0;
+      TEST(EAGAIN == read_iqtriple(triple, &buf2));
+      TEST(buf == buf2);
+      TEST(3 == *(const int*)buf2);
+   }
+   PASS();
+
+   // TEST publish_iqtriple + read_iqtriple: alternating
+   for (int i = 4; i < 100; ++i) {
+      int* wbuf = writebuf_iqtriple(triple);
+      *wbuf = i;
+      publish_iqtriple(triple);
+      TEST(0 == read_iqtriple(triple, &buf));
+      TEST(i == *(const int*)buf);
+      TEST(buf == wbuf);
+      TEST(buf != writebuf_iqtriple(triple));
+   }
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqtriple(&triple));
+}
+
+#define MAXVALUE_TRIPLE 200000
+
+static void* thread_publish_triple(void* triple)
+{
+   for (uint32_t i = 1; i <= MAXVALUE_TRIPLE; ++i) {
+      uint32_t* wbuf = writebuf_iqtriple(triple);
+      wbuf[0] = i;
+      wbuf[1] = ~i;
+      publish_iqtriple(triple);
+   }
+   return 0;
+}
+
+static void test_threads_triple(void)
+{
+   iqtriple_t* triple = 0;
+   pthread_t   thr;
+   uint32_t    last = 0;
+
+   // prepare
+   TEST(0 == new_iqtriple(&triple, 2*sizeof(uint32_t)));
+
+   // TEST read_iqtriple: values are consistent and increasing
+   TEST(0 == pthread_create(&thr, 0, &thread_publish_triple, triple));
+   while (last != MAXVALUE_TRIPLE) {
+      const void* buf;
+      int err = read_iqtriple(triple, &buf);
+      const uint32_t* value = buf;
+      TEST(value[1] == (value[0] ? ~value[0] : 0)); // initial value is 0
+      if (err) {
+         TEST(EAGAIN == err);
+         TEST(last == value[0]);
+         sched_yield();
+      } else {
+         TEST(last < value[0]);
+         last = value[0];
+      }
+   }
+   TEST(0 == pthread_join(thr, 0));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqtriple(&triple));
+}
+
+static void test_initfree_conflate(void)
+{
+   iqconflate_t* queue = 0;
+
+   // TEST new_iqconflate
+   for (uint32_t nrkeys = 1; nrkeys < 5000; nrkeys = 2*nrkeys + 1) {
+      TEST(0 == new_iqconflate(&queue, nrkeys));
+      TEST(0 != queue);
+      TEST(0 != queue->keys);
+      TEST(nrkeys <= capacity_iqueue(queue->keys));
+      TEST(nrkeys == queue->nrkeys);
+      TEST(nrkeys == capacity_iqconflate(queue));
+      TEST(0 == size_iqconflate(queue));
+      for (uint32_t i = 0; i < nrkeys; ++i) {
+         TEST(0 == queue->msg[i]);
+      }
+      // TEST delete_iqconflate
+      TEST(0 == delete_iqconflate(&queue));
+      TEST(0 == queue);
+      TEST(0 == delete_iqconflate(&queue));
+      TEST(0 == queue);
+   }
+   PASS();
+
+   // TEST new_iqconflate: EINVAL
+   TEST(EINVAL == new_iqconflate(&queue, 0));
+   TEST(EINVAL == new_iqconflate(&queue, (uint32_t)-1));
+   TEST(0 == queue);
+   PASS();
+}
+
+static void test_sendrecv_conflate(void)
+{
+   iqconflate_t* queue = 0;
+   int      msg[30];
+   void*    replaced;
+   void*    rmsg;
+   uint32_t key;
+
+   // prepare
+   TEST(0 == new_iqconflate(&queue, 10));
+
+   // TEST send_iqconflate: EINVAL
+   TEST(EINVAL == send_iqconflate(queue, 0, 0, &replaced));
+   TEST(EINVAL == send_iqconflate(queue, 10, &msg[0], &replaced));
+   TEST(0 == size_iqconflate(queue));
+   PASS();
+
+   // TEST tryrecv_iqconflate: EAGAIN
+   TEST(EAGAIN == tryrecv_iqconflate(queue, &key, &rmsg));
+   PASS();
+
+   // TEST send_iqconflate: append new keys
+   for (uint32_t i = 0; i < 10; ++i) {
+      replaced = &msg[0];
+      TEST(0 == send_iqconflate(queue, 9-i, &msg[i], &replaced));
+      TEST(0 == replaced);
+      TEST(&msg[i] == queue->msg[9-i]);
+      TEST(i+1 == size_iqconflate(queue));
+   }
+   PASS();
+
+   // TEST send_iqconflate: replace pending messages in place
+   for (uint32_t i = 10; i < 30; ++i) {
+      void* old = queue->msg[9-i%10];
+      TEST(0 == send_iqconflate(queue, 9-i%10, &msg[i], &replaced));
+      TEST(old == replaced);
+      TEST(&msg[i] == queue->msg[9-i%10]);
+      TEST(10 == size_iqconflate(queue));
+   }
+   TEST(0 == send_iqconflate(queue, 9, &msg[20], 0));
+   PASS();
+
+   // TEST tryrecv_iqconflate: order of first arrival + latest message
+   for (uint32_t i = 0; i < 10; ++i) {
+      TEST(0 == tryrecv_iqconflate(queue, &key, &rmsg));
+      TEST(9-i == key);
+      TEST(&msg[20+i] == rmsg);
+      TEST(0 == queue->msg[key]);
+      TEST(9-i == size_iqconflate(queue));
+   }
+   TEST(EAGAIN == tryrecv_iqconflate(queue, &key, &rmsg));
+   PASS();
+
+   // TEST send_iqconflate: received key is appended again
+   TEST(0 == send_iqconflate(queue, 3, &msg[0], &replaced));
+   TEST(0 == replaced);
+   TEST(0 == send_iqconflate(queue, 5, &msg[1], &replaced));
+   TEST(0 == replaced);
+   TEST(0 == recv_iqconflate(queue, &key, &rmsg));
+   TEST(3 == key && &msg[0] == rmsg);
+   TEST(0 == send_iqconflate(queue, 3, &msg[2], &replaced));
+   TEST(0 == replaced);
+   TEST(0 == recv_iqconflate(queue, &key, &rmsg));
+   TEST(5 == key && &msg[1] == rmsg);
+   TEST(0 == recv_iqconflate(queue, &key, &rmsg));
+   TEST(3 == key && &msg[2] == rmsg);
+   PASS();
+
+   // TEST send_iqconflate, tryrecv_iqconflate, recv_iqconflate: EPIPE
+   close_iqconflate(queue);
+   TEST(EPIPE == send_iqconflate(queue, 0, &msg[0], &replaced));
+   TEST(0 == queue->msg[0]);
+   TEST(EPIPE == tryrecv_iqconflate(queue, &key, &rmsg));
+   TEST(EPIPE == recv_iqconflate(queue, &key, &rmsg));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqconflate(&queue));
+}
+
+#define NRKEYS_CONFLATE 64
+#define MAXVALUE_CONFLATE 20000
+
+static void* thread_send_conflate(void* queue)
+{
+   for (uintptr_t value = 1; value <= MAXVALUE_CONFLATE; ++value) {
+      for (uint32_t key = 0; key < NRKEYS_CONFLATE; ++key) {
+         TEST(0 == send_iqconflate(queue, key, (void*)value, 0));
+      }
+   }
+   return 0;
+}
+
+static void test_threads_conflate(void)
+{
+   iqconflate_t* queue = 0;
+   pthread_t thr;
+   uintptr_t last[NRKEYS_CONFLATE] = { 0 };
+   uint32_t  nrdone = 0;
+
+   // prepare
+   TEST(0 == new_iqconflate(&queue, NRKEYS_CONFLATE));
+
+   // TEST recv_iqconflate: values of every key are increasing
+   TEST(0 == pthread_create(&thr, 0, &thread_send_conflate, queue));
+   while (nrdone < NRKEYS_CONFLATE) {
+      uint32_t key;
+      void*    msg;
+      TEST(0 == recv_iqconflate(queue, &key, &msg));
+      TEST(key < NRKEYS_CONFLATE);
+      TEST(last[key] < (uintptr_t)msg);
+      last[key] = (uintptr_t)msg;
+      nrdone += (MAXVALUE_CONFLATE == last[key]);
+      TEST(size_iqconflate(queue) <= NRKEYS_CONFLATE);
+   }
+   TEST(0 == pthread_join(thr, 0));
+   TEST(0 == size_iqconflate(queue));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqconflate(&queue));
+}
+
+static void test_initfree_lossy(void)
+{
+   iqlossy_t* queue = 0;
+
+   // TEST new_iqlossy: capacity is rounded up to power of two
+   for (uint32_t capacity = 1; capacity < 100000; capacity = 3*capacity + 1) {
+      uint32_t aligned = 1;
+      while (aligned < capacity) aligned *= 2;
+      TEST(0 == new_iqlossy(&queue, capacity));
+      TEST(0 != queue);
+      TEST(0 == queue->closed);
+      TEST(aligned == queue->capacity);
+      TEST(aligned == capacity_iqlossy(queue));
+      TEST(0 == queue->readpos);
+      TEST(0 == queue->nrlost);
+      TEST(0 == queue->writepos);
+      TEST(0 == size_iqlossy(queue));
+      for (uint32_t i = 0; i < aligned; ++i) {
+         TEST(0 == queue->msg[i].seq);
+         TEST(0 == queue->msg[i].msg);
+      }
+      // TEST delete_iqlossy
+      TEST(0 == delete_iqlossy(&queue));
+      TEST(0 == queue);
+      TEST(0 == delete_iqlossy(&queue));
+      TEST(0 == queue);
+   }
+   PASS();
+
+   // TEST new_iqlossy: EINVAL
+   TEST(EINVAL == new_iqlossy(&queue, 0));
+   TEST(EINVAL == new_iqlossy(&queue, (uint32_t)-1));
+   TEST(0 == queue);
+   PASS();
+}
+
+static void test_sendrecv_lossy(void)
+{
+   iqlossy_t* queue = 0;
+   void*      msg;
+   uint64_t   nrlost;
+
+   // prepare
+   TEST(0 == new_iqlossy(&queue, 8));
+
+   // TEST send_iqlossy: EINVAL
+   TEST(EINVAL == send_iqlossy(queue, 0));
+   TEST(0 == queue->writepos);
+   PASS();
+
+   // TEST tryrecv_iqlossy: EAGAIN
+   TEST(EAGAIN == tryrecv_iqlossy(queue, &msg, &nrlost));
+   PASS();
+
+   // TEST send_iqlossy: store into queue
+   for (uintptr_t i = 1; i <= 8; ++i) {
+      TEST(0 == send_iqlossy(queue, (void*)i));
+      TEST(i == queue->writepos);
+      TEST(i == queue->msg[i-1].seq);
+      TEST((void*)i == queue->msg[i-1].msg);
+      TEST(i == size_iqlossy(queue));
+   }
+   PASS();
+
+   // TEST tryrecv_iqlossy: no loss
+   for (uintptr_t i = 1; i <= 8; ++i) {
+      nrlost = 1;
+      TEST(0 == tryrecv_iqlossy(queue, &msg, &nrlost));
+      TEST((void*)i == msg);
+      TEST(0 == nrlost);
+      TEST(i == queue->readpos);
+      TEST(8-i == size_iqlossy(queue));
+   }
+   TEST(EAGAIN == tryrecv_iqlossy(queue, &msg, &nrlost));
+   PASS();
+
+   // TEST send_iqlossy: overwrites oldest messages if full
+   for (uintptr_t i = 9; i <= 28; ++i) {
+      TEST(0 == send_iqlossy(queue, (void*)i));
+      TEST(i == queue->writepos);
+      TEST((i-8 < 8 ? i-8 : 8) == size_iqlossy(queue));
+   }
+   PASS();
+
+   // TEST tryrecv_iqlossy: reports lost messages and resynchronizes
+   TEST(0 == tryrecv_iqlossy(queue, &msg, &nrlost));
+   TEST((void*)21 == msg);
+   TEST(12 == nrlost);
+   for (uintptr_t i = 22; i <= 28; ++i) {
+      TEST(0 == tryrecv_iqlossy(queue, &msg, &nrlost));
+      TEST((void*)i == msg);
+      TEST(0 == nrlost);
+   }
+   TEST(EAGAIN == tryrecv_iqlossy(queue, &msg, &nrlost));
+   PASS();
+
+   // TEST tryrecv_iqlossy: slot overwritten during read is skipped
+   TEST(0 == send_iqlossy(queue, (void*)29));
+   TEST(0 == send_iqlossy(queue, (void*)30));
+   queue->msg[28 & 7].seq = 0; // simulate writer of position 36
+   TEST(0 == tryrecv_iqlossy(queue, &msg, &nrlost));
+   TEST((void*)30 == msg);
+   TEST(1 == nrlost);
+   PASS();
+
+   // TEST send_iqlossy, tryrecv_iqlossy: EPIPE
+   close_iqlossy(queue);
+   TEST(EPIPE == send_iqlossy(queue, (void*)1));
+   TEST(EPIPE == tryrecv_iqlossy(queue, &msg, &nrlost));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqlossy(&queue));
+}
+
+#define MAXVALUE_LOSSY 1000000
+
+static void* thread_send_lossy(void* queue)
+{
+   for (uintptr_t value = 1; value <= MAXVALUE_LOSSY; ++value) {
+      TEST(0 == send_iqlossy(queue, (void*)value));
+   }
+   return 0;
+}
+
+static void test_threads_lossy(void)
+{
+   iqlossy_t* queue = 0;
+   pthread_t  thr;
+   uintptr_t  last = 0;
+   uint64_t   total = 0;
+
+   // prepare
+   TEST(0 == new_iqlossy(&queue, 64));
+
+   // TEST tryrecv_iqlossy: every message is either received or counted as lost
+   TEST(0 == pthread_create(&thr, 0, &thread_send_lossy, queue));
+   while (last != MAXVALUE_LOSSY) {
+      void*    msg;
+      uint64_t nrlost;
+      int err = tryrecv_iqlossy(queue, &msg, &nrlost);
+      if (err) {
+         TEST(EAGAIN == err);
+         continue;
+      }
+      TEST(last + 1 + nrlost == (uintptr_t)msg);
+      last = (uintptr_t)msg;
+      total += nrlost;
+   }
+   TEST(0 == pthread_join(thr, 0));
+   TEST(total < MAXVALUE_LOSSY);
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqlossy(&queue));
+}
+
+static void test_arena(void)
+{
+   iqarena_t arena;
+   struct { int64_t x; char c[3]; } elem[100];
+
+   // TEST init_iqarena
+   memset(&arena, 255, sizeof(arena));
+   TEST(0 == init_iqarena(&arena, elem, sizeof(elem[0]), 100));
+   TEST((uint8_t*)elem == arena.base);
+   TEST(sizeof(elem[0]) == arena.elemsize);
+   TEST(100 == arena.nrelem);
+   PASS();
+
+   // TEST handle_iqarena, ptr_iqarena
+   for (uint32_t i = 0; i < 100; ++i) {
+      TEST(i+1 == handle_iqarena(&arena, &elem[i]));
+      TEST(&elem[i] == ptr_iqarena(&arena, i+1));
+   }
+   PASS();
+
+   // TEST init_iqarena: EINVAL
+   TEST(EINVAL == init_iqarena(&arena, 0, sizeof(elem[0]), 100));
+   TEST(EINVAL == init_iqarena(&arena, elem, 0, 100));
+   TEST(EINVAL == init_iqarena(&arena, elem, sizeof(elem[0]), 0));
+   TEST(EINVAL == init_iqarena(&arena, elem, 1, (uint32_t)-1));
+   TEST((uint8_t*)elem == arena.base);
+   TEST(sizeof(elem[0]) == arena.elemsize);
+   TEST(100 == arena.nrelem);
+   PASS();
+}
+
+static void test_initfree1h(void)
+{
+   iqueue1h_t* queue = 0;
+   iqarena_t   arena;
+   int         elem[10];
+
+   // prepare
+   TEST(0 == init_iqarena(&arena, elem, sizeof(elem[0]), 10));
+
+   // TEST new_iqueue1h
+   for (uint32_t s = 1; s < 65536; s = (s << 1) + 33) {
+      TEST(0 == new_iqueue1h(&queue, s, &arena));
+      TEST(0 != queue);
+      TEST(0 == queue->closed);
+      TEST(s == queue->capacity);
+      TEST(s == capacity_iqueue1h(queue));
+      TEST((uint8_t*)elem == queue->arena.base);
+      TEST(sizeof(elem[0]) == queue->arena.elemsize);
+      TEST(10 == queue->arena.nrelem);
+      TEST(&queue->arena == arena_iqueue1h(queue));
+      TEST(0 == queue->readpos);
+      TEST(0 == queue->writepos);
+      TEST(0 == queue->reader.waitcount);
+      TEST(0 == queue->writer.waitcount);
+      TEST(0 == size_iqueue1h(queue));
+      for (uint32_t i = 0; i < s; ++i) {
+         TEST(0 == queue->msg[i]);
+      }
+      // TEST delete_iqueue1h
+      TEST(0 == delete_iqueue1h(&queue));
+      TEST(0 == queue);
+      TEST(0 == delete_iqueue1h(&queue));
+      TEST(0 == queue);
+   }
+   PASS();
+
+   // TEST new_iqueue1h: EINVAL
+   TEST(EINVAL == new_iqueue1h(&queue, 0, &arena));
+   TEST(0 == queue);
+   PASS();
+}
+
+static void test_sendrecv1h(void)
+{
+   iqueue1h_t* queue = 0;
+   iqarena_t   arena;
+   int         elem[10];
+   uint32_t    handle;
+
+   // prepare
+   TEST(0 == init_iqarena(&arena, elem, sizeof(elem[0]), 10));
+   TEST(0 == new_iqueue1h(&queue, 5, &arena));
+
+   // TEST trysend_iqueue1h: EINVAL
+   TEST(EINVAL == trysend_iqueue1h(queue, 0));
+   TEST(EINVAL == trysend_iqueue1h(queue, 11));
+   TEST(0 == queue->writepos);
+   PASS();
+
+   // TEST tryrecv_iqueue1h: EAGAIN
+   TEST(EAGAIN == tryrecv_iqueue1h(queue, &handle));
+   TEST(0 == queue->readpos);
+   PASS();
+
+   for (uint32_t r = 0; r < 3; ++r) {
+      // TEST trysend_iqueue1h: store into queue
+      for (uint32_t i = 0; i < 5; ++i) {
+         TEST(0 == trysend_iqueue1h(queue, handle_iqarena(&arena, &elem[i+r])));
+         TEST(i+r+1 == queue->msg[i]);
+         TEST((i+1)%5 == queue->writepos);
+         TEST(i+1 == size_iqueue1h(queue));
+      }
+      // TEST trysend_iqueue1h: EAGAIN
+      TEST(EAGAIN == trysend_iqueue1h(queue, 1));
+      TEST(0 == queue->writepos);
+      // TEST tryrecv_iqueue1h: read from queue
+      for (uint32_t i = 0; i < 5; ++i) {
+         TEST(0 == tryrecv_iqueue1h(queue, &handle));
+         TEST(&elem[i+r] == ptr_iqarena(&arena, handle));
+         TEST(0 == queue->msg[i]);
+         TEST((i+1)%5 == queue->readpos);
+         TEST(4-i == size_iqueue1h(queue));
+      }
+      TEST(EAGAIN == tryrecv_iqueue1h(queue, &handle));
+   }
+   PASS();
+
+   // TEST send_iqueue1h, recv_iqueue1h: queue not full / empty
+   TEST(0 == send_iqueue1h(queue, 10));
+   TEST(0 == recv_iqueue1h(queue, &handle));
+   TEST(10 == handle);
+   PASS();
+
+   // TEST trysend_iqueue1h, send_iqueue1h, tryrecv_iqueue1h, recv_iqueue1h: EPIPE
+   close_iqueue1h(queue);
+   TEST(EPIPE == trysend_iqueue1h(queue, 1));
+   TEST(EPIPE == send_iqueue1h(queue, 1));
+   TEST(EPIPE == tryrecv_iqueue1h(queue, &handle));
+   TEST(EPIPE == recv_iqueue1h(queue, &handle));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue1h(&queue));
+}
+
+#define NRELEM_1H 100000
+
+static void* thread_send1h(void* queue)
+{
+   const iqarena_t* arena = arena_iqueue1h(queue);
+   for (uint32_t i = 0; i < NRELEM_1H; ++i) {
+      TEST(0 == send_iqueue1h(queue, handle_iqarena(arena, (uint32_t*)(void*)arena->base + i)));
+   }
+   return 0;
+}
+
+static void test_threads1h(void)
+{
+   iqueue1h_t* queue = 0;
+   iqarena_t   arena;
+   uint32_t*   elem = malloc(NRELEM_1H * sizeof(uint32_t));
+   pthread_t   thr;
+
+   // prepare
+   TEST(0 != elem);
+   for (uint32_t i = 0; i < NRELEM_1H; ++i) {
+      elem[i] = i;
+   }
+   TEST(0 == init_iqarena(&arena, elem, sizeof(elem[0]), NRELEM_1H));
+   TEST(0 == new_iqueue1h(&queue, 64, &arena));
+
+   // TEST send_iqueue1h, recv_iqueue1h: messages are received in order
+   TEST(0 == pthread_create(&thr, 0, &thread_send1h, queue));
+   for (uint32_t i = 0; i < NRELEM_1H; ++i) {
+      uint32_t handle;
+      TEST(0 == recv_iqueue1h(queue, &handle));
+      TEST(i == *(uint32_t*)ptr_iqarena(&arena, handle));
+   }
+   TEST(0 == pthread_join(thr, 0));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueue1h(&queue));
+   free(elem);
+}
+
+static void test_initfreec(void)
+{
+   iqueuec_t* queue = 0;
+
+   // TEST new_iqueuec: capacity is not rounded up
+   for (uint32_t capacity = 1; capacity < 100000; capacity = 2*capacity + 1) {
+      TEST(0 == new_iqueuec(&queue, capacity));
+      TEST(0 != queue);
+      TEST(0 == queue->closed);
+      TEST(capacity == queue->capacity);
+      TEST(capacity == capacity_iqueuec(queue));
+      TEST(0 == queue->readpos);
+      TEST(0 == queue->writepos);
+      TEST(0 == queue->sizeused);
+      TEST(capacity == queue->sizefree);
+      TEST(0 == queue->waiter.waitcount);
+      TEST(0 == queue->waiter.signalcount);
+      TEST(0 == size_iqueuec(queue));
+      for (uint32_t i = 0; i < capacity; ++i) {
+         TEST(0 == queue->msg[i]);
+      }
+      // TEST delete_iqueuec
+      TEST(0 == delete_iqueuec(&queue));
+      TEST(0 == queue);
+      TEST(0 == delete_iqueuec(&queue));
+      TEST(0 == queue);
+   }
+   PASS();
+
+   // TEST new_iqueuec: fixed size is not padded
+   TEST(sizeof(iqueuec_t) == 6*sizeof(uint32_t) + sizeof(iqsignal_t));
+   PASS();
+
+   // TEST new_iqueuec: EINVAL
+   TEST(EINVAL == new_iqueuec(&queue, 0));
+   TEST(0 == queue);
+   PASS();
+}
+
+static void test_sendrecvc(void)
+{
+   iqueuec_t* queue = 0;
+   int        msg[5];
+   void*      rmsg;
+
+   // prepare
+   TEST(0 == new_iqueuec(&queue, 3));
+
+   // TEST trysend_iqueuec: EINVAL
+   TEST(EINVAL == trysend_iqueuec(queue, 0));
+   TEST(3 == queue->sizefree);
+   PASS();
+
+   // TEST tryrecv_iqueuec: EAGAIN
+   TEST(EAGAIN == tryrecv_iqueuec(queue, &rmsg));
+   TEST(0 == queue->sizeused);
+   PASS();
+
+   for (uint32_t r = 0; r < 5; ++r) {
+      // TEST trysend_iqueuec: store into queue
+      for (uint32_t i = 0; i < 3; ++i) {
+         uint32_t pos = (3*r+i) % 3;
+         TEST(0 == trysend_iqueuec(queue, &msg[i+r%3]));
+         TEST(&msg[i+r%3] == queue->msg[pos]);
+         TEST((pos+1)%3 == queue->writepos);
+         TEST(i+1 == queue->sizeused);
+         TEST(2-i == queue->sizefree);
+         TEST(i+1 == size_iqueuec(queue));
+      }
+      // TEST trysend_iqueuec: EAGAIN
+      TEST(EAGAIN == trysend_iqueuec(queue, &msg[0]));
+      TEST(0 == queue->sizefree);
+      // TEST tryrecv_iqueuec: read from queue
+      for (uint32_t i = 0; i < 3; ++i) {
+         TEST(0 == tryrecv_iqueuec(queue, &rmsg));
+         TEST(&msg[i+r%3] == rmsg);
+         TEST(0 == queue->msg[i]);
+         TEST((i+1)%3 == queue->readpos);
+         TEST(2-i == queue->sizeused);
+         TEST(i+1 == queue->sizefree);
+      }
+      TEST(EAGAIN == tryrecv_iqueuec(queue, &rmsg));
+   }
+   PASS();
+
+   // TEST send_iqueuec, recv_iqueuec: queue not full / empty
+   TEST(0 == send_iqueuec(queue, &msg[4]));
+   TEST(0 == recv_iqueuec(queue, &rmsg));
+   TEST(&msg[4] == rmsg);
+   PASS();
+
+   // TEST trysend_iqueuec, send_iqueuec, tryrecv_iqueuec, recv_iqueuec: EPIPE
+   close_iqueuec(queue);
+   TEST(EPIPE == trysend_iqueuec(queue, &msg[0]));
+   TEST(EPIPE == send_iqueuec(queue, &msg[0]));
+   TEST(EPIPE == tryrecv_iqueuec(queue, &rmsg));
+   TEST(EPIPE == recv_iqueuec(queue, &rmsg));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueuec(&queue));
+}
+
+#define NRTHREAD_C 3
+#define NRMSG_C    20000
+
+static uint8_t s_flagc[NRTHREAD_C][NRMSG_C];
+
+static void* thread_sendc(void* queue)
+{
+   static uint32_t s_tid;
+   uintptr_t tid = fetchadd_atomicu32(&s_tid, 1) % NRTHREAD_C;
+   for (uintptr_t i = 0; i < NRMSG_C; ++i) {
+      TEST(0 == send_iqueuec(queue, (void*)(1 + tid * NRMSG_C + i)));
+   }
+   return 0;
+}
+
+static void* thread_recvc(void* queue)
+{
+   void* msg;
+   int   err;
+   while (0 == (err = recv_iqueuec(queue, &msg))) {
+      uintptr_t value = (uintptr_t)msg - 1;
+      TEST(value < NRTHREAD_C * NRMSG_C);
+      __sync_fetch_and_add(&s_flagc[value / NRMSG_C][value % NRMSG_C], 1);
+   }
+   TEST(EPIPE == err);
+   return 0;
+}
+
+static void test_threadsc(void)
+{
+   iqueuec_t* queue = 0;
+   pthread_t  sthr[NRTHREAD_C];
+   pthread_t  rthr[NRTHREAD_C];
+
+   // prepare
+   memset(s_flagc, 0, sizeof(s_flagc));
+   TEST(0 == new_iqueuec(&queue, 4));
+
+   // TEST send_iqueuec, recv_iqueuec: multiple readers and writers block and wake up each other
+   for (int i = 0; i < NRTHREAD_C; ++i) {
+      TEST(0 == pthread_create(&rthr[i], 0, &thread_recvc, queue));
+      TEST(0 == pthread_create(&sthr[i], 0, &thread_sendc, queue));
+   }
+   for (int i = 0; i < NRTHREAD_C; ++i) {
+      TEST(0 == pthread_join(sthr[i], 0));
+   }
+   while (0 != size_iqueuec(queue)) {
+      sched_yield();
+   }
+   for (int t = 0; t < NRTHREAD_C; ++t) {
+      for (int i = 0; i < NRMSG_C; ++i) {
+         while (0 == __sync_fetch_and_add(&s_flagc[t][i], 0)) sched_yield();
+         TEST(1 == s_flagc[t][i]);
+      }
+   }
+   close_iqueuec(queue);
+   for (int i = 0; i < NRTHREAD_C; ++i) {
+      TEST(0 == pthread_join(rthr[i], 0));
+   }
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqueuec(&queue));
+}
+
+typedef struct mpscmsg_t {
+   uint32_t tid;
+   uint32_t nr;
+   iqnode_t node;
+} mpscmsg_t;
+
+#define mpscmsg_node(_node) ((mpscmsg_t*) ((uint8_t*)(_node) - offsetof(mpscmsg_t, node)))
+
+static void test_sendrecv_mpsc(void)
+{
+   iqmpsc_t  queue;
+   mpscmsg_t msg[10];
+   iqnode_t* node;
+
+   // TEST init_iqmpsc
+   memset(&queue, 255, sizeof(queue));
+   init_iqmpsc(&queue);
+   TEST(queue.head == &queue.stub);
+   TEST(queue.tail == &queue.stub);
+   TEST(0 == queue.stub.next);
+   TEST(0 != isempty_iqmpsc(&queue));
+   PASS();
+
+   // TEST tryrecv_iqmpsc: EAGAIN
+   TEST(EAGAIN == tryrecv_iqmpsc(&queue, &node));
+   TEST(0 != isempty_iqmpsc(&queue));
+   PASS();
+
+   // TEST send_iqmpsc, tryrecv_iqmpsc: FIFO order
+   for (int r = 0; r < 3; ++r) {
+      for (uint32_t i = 0; i < 10; ++i) {
+         msg[i].nr = i;
+         memset(&msg[i].node, 255, sizeof(msg[i].node));
+         send_iqmpsc(&queue, &msg[i].node);
+         TEST(0 == msg[i].node.next);
+         TEST(queue.tail == &msg[i].node);
+         TEST(0 == isempty_iqmpsc(&queue));
+      }
+      for (uint32_t i = 0; i < 10; ++i) {
+         node = 0;
+         TEST(0 == tryrecv_iqmpsc(&queue, &node));
+         TEST(node == &msg[i].node);
+         TEST(i == mpscmsg_node(node)->nr);
+      }
+      // stub is re-inserted after last node is removed
+      TEST(queue.head == &queue.stub);
+      TEST(queue.tail == &queue.stub);
+      TEST(0 != isempty_iqmpsc(&queue));
+      TEST(EAGAIN == tryrecv_iqmpsc(&queue, &node));
+   }
+   PASS();
+
+   // TEST send_iqmpsc, tryrecv_iqmpsc: alternating
+   for (uint32_t i = 0; i < 10; ++i) {
+      send_iqmpsc(&queue, &msg[i].node);
+      TEST(0 == tryrecv_iqmpsc(&queue, &node));
+      TEST(node == &msg[i].node);
+      TEST(EAGAIN == tryrecv_iqmpsc(&queue, &node));
+   }
+   PASS();
+
+   // TEST tryrecv_iqmpsc: writer has exchanged tail but not linked its node
+   send_iqmpsc(&queue, &msg[0].node);
+   msg[1].node.next = 0;
+   queue.tail = &msg[1].node;
+   TEST(EAGAIN == tryrecv_iqmpsc(&queue, &node));
+   TEST(EAGAIN == tryrecv_iqmpsc(&queue, &node));
+   TEST(0 == isempty_iqmpsc(&queue));
+   msg[0].node.next = &msg[1].node;
+   TEST(0 == tryrecv_iqmpsc(&queue, &node));
+   TEST(node == &msg[0].node);
+   TEST(0 == tryrecv_iqmpsc(&queue, &node));
+   TEST(node == &msg[1].node);
+   TEST(0 != isempty_iqmpsc(&queue));
+   PASS();
+}
+
+#define NRTHREAD_MPSC 3
+#define NRMSG_MPSC    20000
+
+static mpscmsg_t s_mpscmsg[NRTHREAD_MPSC][NRMSG_MPSC];
+
+static void* thread_send_mpsc(void* queue)
+{
+   static uint32_t s_tid;
+   uint32_t tid = fetchadd_atomicu32(&s_tid, 1) % NRTHREAD_MPSC;
+   for (uint32_t i = 0; i < NRMSG_MPSC; ++i) {
+      s_mpscmsg[tid][i].tid = tid;
+      s_mpscmsg[tid][i].nr  = i;
+      send_iqmpsc(queue, &s_mpscmsg[tid][i].node);
+   }
+   return 0;
+}
+
+static void test_threads_mpsc(void)
+{
+   iqmpsc_t  queue;
+   pthread_t thr[NRTHREAD_MPSC];
+   uint32_t  nextnr[NRTHREAD_MPSC] = { 0 };
+   iqnode_t* node;
+
+   // prepare
+   init_iqmpsc(&queue);
+
+   // TEST send_iqmpsc, tryrecv_iqmpsc: multiple writers, messages of one writer in FIFO order
+   for (int i = 0; i < NRTHREAD_MPSC; ++i) {
+      TEST(0 == pthread_create(&thr[i], 0, &thread_send_mpsc, &queue));
+   }
+   for (int n = 0; n < NRTHREAD_MPSC * NRMSG_MPSC; ++n) {
+      while (tryrecv_iqmpsc(&queue, &node)) sched_yield();
+      mpscmsg_t* msg = mpscmsg_node(node);
+      TEST(msg->tid < NRTHREAD_MPSC);
+      TEST(msg->nr == nextnr[msg->tid]);
+      ++ nextnr[msg->tid];
+   }
+   for (int i = 0; i < NRTHREAD_MPSC; ++i) {
+      TEST(0 == pthread_join(thr[i], 0));
+      TEST(NRMSG_MPSC == nextnr[i]);
+   }
+   TEST(EAGAIN == tryrecv_iqmpsc(&queue, &node));
+   TEST(0 != isempty_iqmpsc(&queue));
+   PASS();
+}
+
+static void test_initfree_turn(void)
+{
+   iqturn_t* queue = 0;
+
+   // TEST new_iqturn: capacity rounded up to power of two
+   for (uint32_t capacity = 1; capacity <= 1024; capacity = 2*capacity + 1) {
+      TEST(0 == new_iqturn(&queue, capacity));
+      TEST(0 != queue);
+      TEST(0 == (uintptr_t)queue % SIZE_CACHELINE);
+      TEST(0 == queue->closed);
+      TEST(capacity <= queue->capacity && queue->capacity < 2*capacity);
+      TEST(0 == (queue->capacity & (queue->capacity-1)));
+      TEST(queue->capacity == capacity_iqturn(queue));
+      TEST(0 == queue->readpos);
+      TEST(0 == queue->writepos);
+      TEST(0 == queue->nrwaiting);
+      for (uint32_t i = 0; i < queue->capacity; ++i) {
+         TEST(0 == queue->slot[i].turn);
+         TEST(0 == queue->slot[i].waiters);
+         TEST(0 == queue->slot[i].msg);
+      }
+      TEST(0 == size_iqturn(queue));
+      TEST(0 == delete_iqturn(&queue));
+      TEST(0 == queue);
+      TEST(0 == delete_iqturn(&queue));
+      TEST(0 == queue);
+   }
+   PASS();
+
+   // TEST new_iqturn: EINVAL
+   TEST(EINVAL == new_iqturn(&queue, 0));
+   TEST(EINVAL == new_iqturn(&queue, (uint32_t)-1));
+   TEST(0 == queue);
+   PASS();
+}
+
+static void test_sendrecv_turn(void)
+{
+   iqturn_t* queue = 0;
+   int   msg[8];
+   void* rmsg;
+
+   // prepare
+   TEST(0 == new_iqturn(&queue, 8));
+
+   // TEST trysend_iqturn, tryrecv_iqturn: several rounds
+   for (uint32_t r = 0; r < 5; ++r) {
+      TEST(EAGAIN == tryrecv_iqturn(queue, &rmsg));
+      for (int i = 0; i < 8; ++i) {
+         TEST(0 == trysend_iqturn(queue, &msg[i]));
+         TEST(2*r+1 == queue->slot[i].turn);
+         TEST((uint32_t)i+1 == size_iqturn(queue));
+      }
+      TEST(EAGAIN == trysend_iqturn(queue, &msg[0]));
+      for (int i = 0; i < 8; ++i) {
+         TEST(0 == tryrecv_iqturn(queue, &rmsg));
+         TEST(rmsg == &msg[i]);
+         TEST(2*r+2 == queue->slot[i].turn);
+         TEST(7-(uint32_t)i == size_iqturn(queue));
+      }
+   }
+   TEST(40 == queue->readpos);
+   TEST(40 == queue->writepos);
+   PASS();
+
+   // TEST send_iqturn, recv_iqturn: do not block if slot is ready
+   for (int i = 0; i < 8; ++i) {
+      TEST(0 == send_iqturn(queue, &msg[i]));
+   }
+   for (int i = 0; i < 8; ++i) {
+      TEST(0 == recv_iqturn(queue, &rmsg));
+      TEST(rmsg == &msg[i]);
+   }
+   PASS();
+
+   // TEST trysend_iqturn, send_iqturn: EINVAL
+   TEST(EINVAL == trysend_iqturn(queue, 0));
+   TEST(EINVAL == send_iqturn(queue, 0));
+   PASS();
+
+   // TEST close_iqturn: EPIPE
+   close_iqturn(queue);
+   TEST(1 == queue->closed);
+   TEST(EPIPE == trysend_iqturn(queue, &msg[0]));
+   TEST(EPIPE == send_iqturn(queue, &msg[0]));
+   TEST(EPIPE == tryrecv_iqturn(queue, &rmsg));
+   TEST(EPIPE == recv_iqturn(queue, &rmsg));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqturn(&queue));
+}
+
+#define NRTHREAD_TURN 3
+#define NRMSG_TURN    20000
+
+static uint8_t s_flagturn[NRTHREAD_TURN][NRMSG_TURN];
+
+static void* thread_send_turn(void* queue)
+{
+   static uint32_t s_tid;
+   uintptr_t tid = fetchadd_atomicu32(&s_tid, 1) % NRTHREAD_TURN;
+   for (uintptr_t i = 0; i < NRMSG_TURN; ++i) {
+      TEST(0 == send_iqturn(queue, (void*)(1 + tid * NRMSG_TURN + i)));
+   }
+   return 0;
+}
+
+static void* thread_recv_turn(void* queue)
+{
+   void* msg;
+   int   err;
+   while (0 == (err = recv_iqturn(queue, &msg))) {
+      uintptr_t value = (uintptr_t)msg - 1;
+      TEST(value < NRTHREAD_TURN * NRMSG_TURN);
+      __sync_fetch_and_add(&s_flagturn[value / NRMSG_TURN][value % NRMSG_TURN], 1);
+   }
+   TEST(EPIPE == err);
+   return 0;
+}
+
+static void test_threads_turn(void)
+{
+   iqturn_t* queue = 0;
+   pthread_t sthr[NRTHREAD_TURN];
+   pthread_t rthr[NRTHREAD_TURN];
+   int       msg;
+
+   // prepare
+   memset(s_flagturn, 0, sizeof(s_flagturn));
+   TEST(0 == new_iqturn(&queue, 4));
+
+   // TEST recv_iqturn: reader sleeps on the slot of its claimed position
+   TEST(0 == pthread_create(&rthr[0], 0, &thread_recv_turn, queue));
+   while (0 == load_atomicu32(&queue->slot[0].waiters)) sched_yield();
+   TEST(1 == queue->readpos);
+   TEST(0 == queue->slot[1].waiters);
+   // message is claimed by waiting reader
+   TEST(0 == size_iqturn(queue));
+   // sender of position 0 wakes the reader
+   TEST(0 == trysend_iqturn(queue, (void*)(uintptr_t)1));
+   while (0 == __sync_fetch_and_add(&s_flagturn[0][0], 0)) sched_yield();
+   TEST(1 == s_flagturn[0][0]);
+   s_flagturn[0][0] = 0;
+   PASS();
+
+   // TEST tryrecv_iqturn: EAGAIN if next message claimed by waiting reader
+   while (0 == load_atomicu32(&queue->slot[1].waiters)) sched_yield();
+   TEST(EAGAIN == tryrecv_iqturn(queue, (void**)&msg));
+   PASS();
+
+   // TEST send_iqturn, recv_iqturn: multiple readers and writers sleep and wake up each other
+   for (int i = 1; i < NRTHREAD_TURN; ++i) {
+      TEST(0 == pthread_create(&rthr[i], 0, &thread_recv_turn, queue));
+   }
+   for (int i = 0; i < NRTHREAD_TURN; ++i) {
+      TEST(0 == pthread_create(&sthr[i], 0, &thread_send_turn, queue));
+   }
+   for (int i = 0; i < NRTHREAD_TURN; ++i) {
+      TEST(0 == pthread_join(sthr[i], 0));
+   }
+   for (int t = 0; t < NRTHREAD_TURN; ++t) {
+      for (int i = 0; i < NRMSG_TURN; ++i) {
+         while (0 == __sync_fetch_and_add(&s_flagturn[t][i], 0)) sched_yield();
+         TEST(1 == s_flagturn[t][i]);
+      }
+   }
+   PASS();
+
+   // TEST close_iqturn: wakes up sleeping readers
+   for (int r = 0; r < NRTHREAD_TURN; ++r) {
+      while (0 == load_atomicu32(&queue->slot[(queue->writepos+(unsigned)r) & 3].waiters)) sched_yield();
+   }
+   close_iqturn(queue);
+   for (int i = 0; i < NRTHREAD_TURN; ++i) {
+      TEST(0 == pthread_join(rthr[i], 0));
+   }
+   for (uint32_t i = 0; i < queue->capacity; ++i) {
+      TEST(0 == queue->slot[i].waiters);
+   }
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqturn(&queue));
+}
+
+static void* thread_recvepipe_turn(void* queue)
+{
+   void* msg;
+   TEST(EPIPE == recv_iqturn(queue, &msg));
+   return 0;
+}
+
+static void* thread_sendepipe_turn(void* queue)
+{
+   TEST(EPIPE == send_iqturn(queue, &s_flagturn));
+   return 0;
+}
+
+static void test_close_turn(void)
+{
+   iqturn_t* queue = 0;
+   iqturn_t* fullqueue = 0;
+   pthread_t rthr[NRTHREAD_TURN];
+   pthread_t sthr[NRTHREAD_TURN];
+
+   // TEST delete_iqturn: blocked readers and writers return before the queue is freed
+   // (build with make asan to detect an access of a freed queue)
+   for (int r = 0; r < 100; ++r) {
+      TEST(0 == new_iqturn(&queue, 4));
+      TEST(0 == new_iqturn(&fullqueue, 4));
+      for (int i = 0; i < 4; ++i) {
+         TEST(0 == trysend_iqturn(fullqueue, &s_flagturn));
+      }
+      for (int i = 0; i < NRTHREAD_TURN; ++i) {
+         TEST(0 == pthread_create(&rthr[i], 0, &thread_recvepipe_turn, queue));
+         TEST(0 == pthread_create(&sthr[i], 0, &thread_sendepipe_turn, fullqueue));
+      }
+      // threads are counted but not necessarily asleep
+      while (NRTHREAD_TURN != load_atomicu32(&queue->nrwaiting)) sched_yield();
+      while (NRTHREAD_TURN != load_atomicu32(&fullqueue->nrwaiting)) sched_yield();
+      TEST(0 == delete_iqturn(&queue));
+      TEST(0 == delete_iqturn(&fullqueue));
+      for (int i = 0; i < NRTHREAD_TURN; ++i) {
+         TEST(0 == pthread_join(rthr[i], 0));
+         TEST(0 == pthread_join(sthr[i], 0));
+      }
+   }
+   PASS();
+}
+
+static void test_initfree_numa(void)
+{
+   iqnuma_t* queue = 0;
+
+   // TEST new_iqnuma: one sub-queue per node
+   for (uint32_t nrnode = 1; nrnode <= 5; ++nrnode) {
+      TEST(0 == new_iqnuma(&queue, nrnode, 300));
+      TEST(0 != queue);
+      TEST(0 == (uintptr_t)queue % SIZE_CACHELINE);
+      TEST(0 == queue->closed);
+      TEST(nrnode == queue->nrnode);
+      for (uint32_t i = 0; i < nrnode; ++i) {
+         TEST(0 != queue->node[i]);
+         TEST(512 == capacity_iqueue(queue->node[i]));
+      }
+      TEST(nrnode * 512 == capacity_iqnuma(queue));
+      TEST(0 == size_iqnuma(queue));
+      TEST(node_iqnuma(queue) < nrnode);
+      TEST(0 == delete_iqnuma(&queue));
+      TEST(0 == queue);
+      TEST(0 == delete_iqnuma(&queue));
+      TEST(0 == queue);
+   }
+   PASS();
+
+   // TEST new_iqnuma: number of nodes read from sysfs
+   TEST(0 == new_iqnuma(&queue, 0, 256));
+   TEST(1 <= queue->nrnode);
+   TEST(node_iqnuma(queue) < queue->nrnode);
+   TEST(0 == delete_iqnuma(&queue));
+   PASS();
+
+   // TEST new_iqnuma: EINVAL
+   TEST(EINVAL == new_iqnuma(&queue, 1025, 256));
+   TEST(EINVAL == new_iqnuma(&queue, 2, (iqpos_t)-1));
+   TEST(0 == queue);
+   PASS();
+}
+
+static void test_sendrecv_numa(void)
+{
+   iqnuma_t* queue = 0;
+   int       msg[4];
+   void*     rmsg;
+
+   // prepare
+   TEST(0 == new_iqnuma(&queue, 4, 256));
+   uint32_t local = node_iqnuma(queue);
+   uint32_t other = (local + 2) % 4;
+
+   // TEST trysend_iqnuma: stores into local sub-queue
+   TEST(0 == trysend_iqnuma(queue, &msg[0]));
+   TEST(1 == size_iqueue(queue->node[local]));
+   TEST(1 == size_iqnuma(queue));
+   PASS();
+
+   // TEST tryrecv_iqnuma: local sub-queue first, then steals from other nodes
+   TEST(0 == trysend_iqueue(queue->node[other], &msg[1]));
+   TEST(0 == tryrecv_iqnuma(queue, &rmsg));
+   TEST(&msg[0] == rmsg);
+   TEST(0 == tryrecv_iqnuma(queue, &rmsg));
+   TEST(&msg[1] == rmsg);
+   TEST(EAGAIN == tryrecv_iqnuma(queue, &rmsg));
+   TEST(0 == size_iqnuma(queue));
+   PASS();
+
+   // TEST trysend_iqnuma: uses other sub-queue if local one is full
+   for (int i = 0; i < 256; ++i) {
+      TEST(0 == trysend_iqnuma(queue, &msg[2]));
+   }
+   TEST(256 == size_iqueue(queue->node[local]));
+   TEST(0 == trysend_iqnuma(queue, &msg[3]));
+   TEST(256 == size_iqueue(queue->node[local]));
+   TEST(1 == size_iqueue(queue->node[(local+1) % 4]));
+   for (int i = 256; i < 4*256-1; ++i) {
+      TEST(0 == trysend_iqnuma(queue, &msg[3]));
+   }
+   TEST(EAGAIN == trysend_iqnuma(queue, &msg[3]));
+   TEST(4*256 == size_iqnuma(queue));
+   for (int i = 0; i < 4*256; ++i) {
+      TEST(0 == tryrecv_iqnuma(queue, &rmsg));
+      TEST((i < 256 ? &msg[2] : &msg[3]) == rmsg);
+   }
+   TEST(EAGAIN == tryrecv_iqnuma(queue, &rmsg));
+   PASS();
+
+   // TEST close_iqnuma: EPIPE
+   TEST(0 == trysend_iqnuma(queue, &msg[0]));
+   close_iqnuma(queue);
+   TEST(0 != queue->closed);
+   for (uint32_t i = 0; i < 4; ++i) {
+      TEST(0 != queue->node[i]->closed);
+   }
+   TEST(EPIPE == trysend_iqnuma(queue, &msg[0]));
+   TEST(EPIPE == send_iqnuma(queue, &msg[0]));
+   TEST(EPIPE == tryrecv_iqnuma(queue, &rmsg));
+   TEST(EPIPE == recv_iqnuma(queue, &rmsg));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqnuma(&queue));
+}
+
+#define NRTHREAD_NUMA 3
+#define NRMSG_NUMA    20000
+
+static uint8_t s_flagnuma[NRTHREAD_NUMA][NRMSG_NUMA];
+
+static void* thread_send_numa(void* queue)
+{
+   static uint32_t s_tid;
+   uintptr_t tid = fetchadd_atomicu32(&s_tid, 1) % NRTHREAD_NUMA;
+   for (uintptr_t i = 0; i < NRMSG_NUMA; ++i) {
+      TEST(0 == send_iqnuma(queue, (void*)(1 + tid * NRMSG_NUMA + i)));
+   }
+   return 0;
+}
+
+static void* thread_recv_numa(void* queue)
+{
+   void* msg;
+   int   err;
+   while (0 == (err = recv_iqnuma(queue, &msg))) {
+      uintptr_t value = (uintptr_t)msg - 1;
+      TEST(value < NRTHREAD_NUMA * NRMSG_NUMA);
+      __sync_fetch_and_add(&s_flagnuma[value / NRMSG_NUMA][value % NRMSG_NUMA], 1);
+   }
+   TEST(EPIPE == err);
+   return 0;
+}
+
+static void test_threads_numa(void)
+{
+   iqnuma_t* queue = 0;
+   pthread_t sthr[NRTHREAD_NUMA];
+   pthread_t rthr[NRTHREAD_NUMA];
+
+   // prepare
+   memset(s_flagnuma, 0, sizeof(s_flagnuma));
+   TEST(0 == new_iqnuma(&queue, 2, 256));
+
+   // TEST send_iqnuma, recv_iqnuma: readers and writers sleep and wake up each other
+   for (int i = 0; i < NRTHREAD_NUMA; ++i) {
+      TEST(0 == pthread_create(&rthr[i], 0, &thread_recv_numa, queue));
+   }
+   for (int i = 0; i < NRTHREAD_NUMA; ++i) {
+      TEST(0 == pthread_create(&sthr[i], 0, &thread_send_numa, queue));
+   }
+   for (int i = 0; i < NRTHREAD_NUMA; ++i) {
+      TEST(0 == pthread_join(sthr[i], 0));
+   }
+   for (int t = 0; t < NRTHREAD_NUMA; ++t) {
+      for (int i = 0; i < NRMSG_NUMA; ++i) {
+         while (0 == __sync_fetch_and_add(&s_flagnuma[t][i], 0)) sched_yield();
+         TEST(1 == s_flagnuma[t][i]);
+      }
+   }
+   PASS();
+
+   // TEST close_iqnuma: wakes up sleeping readers
+   close_iqnuma(queue);
+   for (int i = 0; i < NRTHREAD_NUMA; ++i) {
+      TEST(0 == pthread_join(rthr[i], 0));
+   }
+   TEST(0 == queue->reader.waitcount);
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqnuma(&queue));
+}
+
+static void test_initfree_scq(void)
+{
+   iqscq_t* queue = 0;
+
+   // TEST new_iqscq: capacity rounded up to power of two
+   for (uint32_t capacity = 1; capacity <= 1024; capacity = 2*capacity + 1) {
+      TEST(0 == new_iqscq(&queue, capacity));
+      TEST(0 != queue);
+      TEST(0 == (uintptr_t)queue % SIZE_CACHELINE);
+      TEST(0 == queue->closed);
+      TEST(capacity <= queue->capacity && queue->capacity < 2*capacity);
+      TEST(0 == (queue->capacity & (queue->capacity-1)));
+      TEST(queue->capacity == capacity_iqscq(queue));
+      TEST(2*queue->capacity == (1u << queue->order));
+      TEST(queue->aq.entry == (uint64_t*)&queue->msg[queue->capacity]);
+      TEST(queue->fq.entry == queue->aq.entry + 2*queue->capacity);
+      // aq empty
+      TEST(0 == queue->aq.head);
+      TEST(0 == queue->aq.tail);
+      TEST(-1 == queue->aq.threshold);
+      // fq full
+      TEST(0 == queue->fq.head);
+      TEST(queue->capacity == queue->fq.tail);
+      TEST(3*(int64_t)queue->capacity-1 == queue->fq.threshold);
+      for (uint32_t i = 0; i < 2*queue->capacity; ++i) {
+         TEST((uint64_t)-1 == queue->aq.entry[i]);
+      }
+      for (uint32_t i = 0; i < queue->capacity; ++i) {
+         TEST(0 == queue->msg[i]);
+      }
+      TEST(0 == size_iqscq(queue));
+      TEST(0 == delete_iqscq(&queue));
+      TEST(0 == queue);
+      TEST(0 == delete_iqscq(&queue));
+      TEST(0 == queue);
+   }
+   PASS();
+
+   // TEST new_iqscq: EINVAL
+   TEST(EINVAL == new_iqscq(&queue, 0));
+   TEST(EINVAL == new_iqscq(&queue, (1u << 30) + 1));
+   TEST(0 == queue);
+   PASS();
+}
+
+static void test_sendrecv_scq(void)
+{
+   iqscq_t* queue = 0;
+   int      msg[16];
+   void*    rmsg;
+
+   // prepare
+   TEST(0 == new_iqscq(&queue, 16));
+
+   // TEST trysend_iqscq: EINVAL
+   TEST(EINVAL == trysend_iqscq(queue, 0));
+   PASS();
+
+   // TEST trysend_iqscq, tryrecv_iqscq: FIFO over many cycles of the rings
+   for (int r = 0; r < 100; ++r) {
+      for (int i = 0; i < 16; ++i) {
+         TEST(0 == trysend_iqscq(queue, &msg[i]));
+         TEST((uint32_t)i+1 == size_iqscq(queue));
+      }
+      TEST(EAGAIN == trysend_iqscq(queue, &msg[0]));
+      TEST(16 == size_iqscq(queue));
+      for (int i = 0; i < 16; ++i) {
+         TEST(0 == tryrecv_iqscq(queue, &rmsg));
+         TEST(&msg[i] == rmsg);
+      }
+      TEST(EAGAIN == tryrecv_iqscq(queue, &rmsg));
+      TEST(EAGAIN == tryrecv_iqscq(queue, &rmsg));
+      TEST(0 == size_iqscq(queue));
+      // interleaved
+      for (int i = 0; i < 1+r%16; ++i) {
+         TEST(0 == trysend_iqscq(queue, &msg[i]));
+      }
+      for (int i = 0; i < 1+r%16; ++i) {
+         TEST(0 == tryrecv_iqscq(queue, &rmsg));
+         TEST(&msg[i] == rmsg);
+      }
+   }
+   PASS();
+
+   // TEST tryrecv_iqscq: failed receive does not lose a later message
+   TEST(EAGAIN == tryrecv_iqscq(queue, &rmsg));
+   TEST(queue->aq.tail == queue->aq.head);
+   TEST(0 == trysend_iqscq(queue, &msg[1]));
+   TEST(0 == tryrecv_iqscq(queue, &rmsg));
+   TEST(&msg[1] == rmsg);
+   PASS();
+
+   // TEST close_iqscq: EPIPE
+   TEST(0 == trysend_iqscq(queue, &msg[0]));
+   close_iqscq(queue);
+   TEST(0 != queue->closed);
+   TEST(EPIPE == trysend_iqscq(queue, &msg[0]));
+   TEST(EPIPE == send_iqscq(queue, &msg[0]));
+   TEST(EPIPE == tryrecv_iqscq(queue, &rmsg));
+   TEST(EPIPE == recv_iqscq(queue, &rmsg));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqscq(&queue));
+}
+
+#define NRTHREAD_SCQ 3
+#define NRMSG_SCQ    20000
+
+static uint8_t s_flagscq[NRTHREAD_SCQ][NRMSG_SCQ];
+
+static void* thread_send_scq(void* queue)
+{
+   static uint32_t s_tid;
+   uintptr_t tid = fetchadd_atomicu32(&s_tid, 1) % NRTHREAD_SCQ;
+   for (uintptr_t i = 0; i < NRMSG_SCQ; ++i) {
+      TEST(0 == send_iqscq(queue, (void*)(1 + tid * NRMSG_SCQ + i)));
+   }
+   return 0;
+}
+
+static void* thread_recv_scq(void* queue)
+{
+   void* msg;
+   int   err;
+   uintptr_t last[NRTHREAD_SCQ] = { 0 };
+   while (0 == (err = recv_iqscq(queue, &msg))) {
+      uintptr_t value = (uintptr_t)msg - 1;
+      TEST(value < NRTHREAD_SCQ * NRMSG_SCQ);
+      // messages of a single sender are received in order
+      TEST(last[value / NRMSG_SCQ] <= value % NRMSG_SCQ + 1);
+      last[value / NRMSG_SCQ] = value % NRMSG_SCQ + 1;
+      __sync_fetch_and_add(&s_flagscq[value / NRMSG_SCQ][value % NRMSG_SCQ], 1);
+   }
+   TEST(EPIPE == err);
+   return 0;
+}
+
+static void test_threads_scq(void)
+{
+   iqscq_t*  queue = 0;
+   pthread_t sthr[NRTHREAD_SCQ];
+   pthread_t rthr[NRTHREAD_SCQ];
+
+   // prepare
+   memset(s_flagscq, 0, sizeof(s_flagscq));
+   TEST(0 == new_iqscq(&queue, 4));
+
+   // TEST send_iqscq, recv_iqscq: readers and writers sleep and wake up each other
+   for (int i = 0; i < NRTHREAD_SCQ; ++i) {
+      TEST(0 == pthread_create(&rthr[i], 0, &thread_recv_scq, queue));
+   }
+   for (int i = 0; i < NRTHREAD_SCQ; ++i) {
+      TEST(0 == pthread_create(&sthr[i], 0, &thread_send_scq, queue));
+   }
+   for (int i = 0; i < NRTHREAD_SCQ; ++i) {
+      TEST(0 == pthread_join(sthr[i], 0));
+   }
+   for (int t = 0; t < NRTHREAD_SCQ; ++t) {
+      for (int i = 0; i < NRMSG_SCQ; ++i) {
+         while (0 == __sync_fetch_and_add(&s_flagscq[t][i], 0)) sched_yield();
+         TEST(1 == s_flagscq[t][i]);
+      }
+   }
+   PASS();
+
+   // TEST close_iqscq: wakes up sleeping readers
+   close_iqscq(queue);
+   for (int i = 0; i < NRTHREAD_SCQ; ++i) {
+      TEST(0 == pthread_join(rthr[i], 0));
+   }
+   TEST(0 == queue->reader.waitcount);
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqscq(&queue));
+}
+
+static void test_initfree_wf(void)
+{
+   iqwf_t* queue = 0;
+
+   // TEST new_iqwf: capacity rounded up to power of two
+   for (uint32_t capacity = 1; capacity <= 1024; capacity = 2*capacity + 1) {
+      for (uint32_t nrthread = 1; nrthread <= 64; nrthread *= 4) {
+         TEST(0 == new_iqwf(&queue, capacity, nrthread));
+         TEST(0 != queue);
+         TEST(0 == (uintptr_t)queue % SIZE_CACHELINE);
+         TEST(0 == queue->closed);
+         TEST(capacity <= queue->capacity && queue->capacity < 2*capacity);
+         TEST(0 == (queue->capacity & (queue->capacity-1)));
+         TEST(queue->capacity == capacity_iqwf(queue));
+         TEST(nrthread == queue->nrthread);
+         TEST(0 == queue->recordsize % SIZE_CACHELINE);
+         TEST(queue->recordsize >= sizeof(iqwfstate_t) + (nrthread + queue->capacity) * sizeof(void*));
+         TEST(0 == (uintptr_t)queue->records % SIZE_CACHELINE);
+         TEST((uint8_t*)&queue->thread[nrthread] <= queue->records);
+         TEST((uint8_t*)queue->result == queue->records + (2*nrthread+1) * queue->recordsize);
+         TEST(2*nrthread == queue->state);
+         TEST(0 == queue->toggles);
+         TEST(0 == size_iqwf(queue));
+         TEST(0 == delete_iqwf(&queue));
+         TEST(0 == queue);
+         TEST(0 == delete_iqwf(&queue));
+         TEST(0 == queue);
+      }
+   }
+   PASS();
+
+   // TEST new_iqwf: EINVAL
+   TEST(EINVAL == new_iqwf(&queue, 0, 1));
+   TEST(EINVAL == new_iqwf(&queue, 65537, 1));
+   TEST(EINVAL == new_iqwf(&queue, 1, 0));
+   TEST(EINVAL == new_iqwf(&queue, 1, 65));
+   TEST(0 == queue);
+   PASS();
 }
 
-void* thread_recvrange1(void* queue)
+static void test_sendrecv_wf(void)
 {
-   void* imsg;
+   iqwf_t* queue = 0;
+   int     msg[8];
+   void*   rmsg;
 
-   for (;;) {
-      for (int i = 0; ; ++i) {
-         int err = s_threadtry ? tryrecv_iqueue1(queue, &imsg) : recv_iqueue1(queue, &imsg);
-         if (err == EPIPE) return 0;
-         if (err == 0) break;
-         TEST(err == EAGAIN);
-         sched_yield();
-         if (i == 1000000) {
-            printf("Receiver starvation\n");
-            exit(1);
-         }
+   // prepare
+   TEST(0 == new_iqwf(&queue, 8, 2));
+
+   // TEST trysend_iqwf, tryrecv_iqwf: EINVAL
+   TEST(EINVAL == trysend_iqwf(queue, 0, 0));
+   TEST(EINVAL == trysend_iqwf(queue, 2, &msg[0]));
+   TEST(EINVAL == trysend_iqwf(queue, 64, &msg[0]));
+   TEST(EINVAL == tryrecv_iqwf(queue, 2, &rmsg));
+   TEST(EINVAL == tryrecv_iqwf(queue, (uint32_t)-1, &rmsg));
+   TEST(0 == queue->toggles);
+   TEST(0 == size_iqwf(queue));
+   PASS();
+
+   // TEST trysend_iqwf, tryrecv_iqwf: FIFO between different thread ids
+   for (int r = 0; r < 10; ++r) {
+      for (int i = 0; i < 8; ++i) {
+         TEST(0 == trysend_iqwf(queue, (uint32_t)i % 2, &msg[i]));
+         TEST((uint32_t)i+1 == size_iqwf(queue));
+      }
+      TEST(EAGAIN == trysend_iqwf(queue, 0, &msg[0]));
+      TEST(EAGAIN == trysend_iqwf(queue, 1, &msg[0]));
+      for (int i = 0; i < 8; ++i) {
+         TEST(0 == tryrecv_iqwf(queue, (uint32_t)(i+r) % 2, &rmsg));
+         TEST(&msg[i] == rmsg);
       }
+      TEST(EAGAIN == tryrecv_iqwf(queue, 0, &rmsg));
+      TEST(EAGAIN == tryrecv_iqwf(queue, 1, &rmsg));
+      TEST(0 == size_iqwf(queue));
+   }
+   PASS();
 
-      struct range_t* rmsg = (struct range_t*) imsg;
-      TEST(rmsg->tid < MAXTHREAD);
-      TEST(rmsg->nr  < MAXRANGE);
-      s_flag[rmsg->tid][rmsg->nr] = (uint8_t) (s_flag[rmsg->tid][rmsg->nr] + 1);
-      // message processed
-      cmpxchg_atomicu32(&rmsg->nr, rmsg->nr, MAXRANGE);
+   // TEST trysend_iqwf: every operation toggles the bit of its thread
+   uint64_t toggles = queue->toggles;
+   TEST(0 == trysend_iqwf(queue, 1, &msg[0]));
+   TEST((toggles ^ 2) == queue->toggles);
+   TEST(queue->toggles == WF_STATE(queue)->applied);
+   TEST(0 == tryrecv_iqwf(queue, 0, &rmsg));
+   TEST((toggles ^ 3) == queue->toggles);
+   TEST(queue->toggles == WF_STATE(queue)->applied);
+   PASS();
+
+   // TEST trysend_iqwf: results of an installed record are published before it is reused
+   uint64_t state = queue->state;
+   TEST(0 == trysend_iqwf(queue, 1, &msg[1]));
+   TEST(2 == (queue->state & 0xff) || 3 == (queue->state & 0xff));
+   uint64_t installed = queue->state;
+   TEST(0 == trysend_iqwf(queue, 1, &msg[2]));
+   TEST(installed != queue->state);
+   TEST(queue->thread[1].published < installed);
+   TEST(0 == tryrecv_iqwf(queue, 1, &rmsg));
+   TEST(&msg[1] == rmsg);
+   TEST(installed == queue->thread[1].published);
+   TEST(&msg[1] == queue->result[1*2 + 1]);
+   TEST((state >> 8) < (installed >> 8));
+   PASS();
+
+   // TEST close_iqwf: EPIPE
+   close_iqwf(queue);
+   TEST(0 != queue->closed);
+   TEST(EPIPE == trysend_iqwf(queue, 0, &msg[0]));
+   TEST(EPIPE == tryrecv_iqwf(queue, 1, &rmsg));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqwf(&queue));
+}
+
+#define NRTHREAD_WF 3
+#define NRMSG_WF    20000
+
+static uint8_t s_flagwf[NRTHREAD_WF][NRMSG_WF];
+
+static void* thread_send_wf(void* queue)
+{
+   static uint32_t s_tid;
+   uint32_t tid = fetchadd_atomicu32(&s_tid, 1) % NRTHREAD_WF;
+   for (uintptr_t i = 0; i < NRMSG_WF; ++i) {
+      while (0 != trysend_iqwf(queue, tid, (void*)(1 + tid * NRMSG_WF + i))) sched_yield();
    }
+   return 0;
+}
 
+static void* thread_recv_wf(void* queue)
+{
+   static uint32_t s_tid;
+   uint32_t tid = NRTHREAD_WF + fetchadd_atomicu32(&s_tid, 1) % NRTHREAD_WF;
+   void* msg;
+   int   err;
+   while (EPIPE != (err = tryrecv_iqwf(queue, tid, &msg))) {
+      if (err) {
+         sched_yield();
+         continue;
+      }
+      uintptr_t value = (uintptr_t)msg - 1;
+      TEST(value < NRTHREAD_WF * NRMSG_WF);
+      __sync_fetch_and_add(&s_flagwf[value / NRMSG_WF][value % NRMSG_WF], 1);
+   }
    return 0;
 }
 
-void test_single_sendrecv1(void)
+static void test_threads_wf(void)
 {
-   iqueue1_t* queue = 0;
-   pthread_t rthr;
-   pthread_t sthr;
+   iqwf_t*   queue = 0;
+   pthread_t sthr[NRTHREAD_WF];
+   pthread_t rthr[NRTHREAD_WF];
 
-   for (int usetry = 0; usetry <= 1; ++usetry) {
-      memset(s_flag, 0, sizeof(s_flag));
-      // start threads
-      s_threadid  = 0;
-      s_threadtry = usetry;
-      TEST(0 == init_iqsignal(&s_threadsignal));
-      TEST(0 == new_iqueue1(&queue, QUEUESIZE));
-      TEST(0 == pthread_create(&sthr, 0, &thread_sendrange1, queue));
-      TEST(0 == pthread_create(&rthr, 0, &thread_recvrange1, queue));
-      for (int r = 0; r < MAXRANGE; ++r) {
-         int x = 0;
-         while (__sync_fetch_and_add(&s_flag[0][r], 0) == 0) {
-            sched_yield();
-            ++x;
-            if (x == 1000000) {
-               // DEBUG:
-               printf("usetry:%d rwait:%d wwait:%d wready:%d rpos:%d wpos:%d\n", usetry, queue->reader.waitcount, queue->writer.waitcount, s_threadsignal.waitcount, queue->readpos, queue->writepos);
-               x = 0;
-            }
+   // prepare
+   memset(s_flagwf, 0, sizeof(s_flagwf));
+   TEST(0 == new_iqwf(&queue, 4, 2*NRTHREAD_WF));
+
+   // TEST trysend_iqwf, tryrecv_iqwf: every message is received exactly once
+   for (int i = 0; i < NRTHREAD_WF; ++i) {
+      TEST(0 == pthread_create(&rthr[i], 0, &thread_recv_wf, queue));
+   }
+   for (int i = 0; i < NRTHREAD_WF; ++i) {
+      TEST(0 == pthread_create(&sthr[i], 0, &thread_send_wf, queue));
+   }
+   for (int i = 0; i < NRTHREAD_WF; ++i) {
+      TEST(0 == pthread_join(sthr[i], 0));
+   }
+   for (int t = 0; t < NRTHREAD_WF; ++t) {
+      for (int i = 0; i < NRMSG_WF; ++i) {
+         while (0 == __sync_fetch_and_add(&s_flagwf[t][i], 0)) sched_yield();
+         TEST(1 == s_flagwf[t][i]);
+      }
+   }
+   close_iqwf(queue);
+   for (int i = 0; i < NRTHREAD_WF; ++i) {
+      TEST(0 == pthread_join(rthr[i], 0));
+   }
+   TEST(0 == size_iqwf(queue));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqwf(&queue));
+}
+
+static void test_initfree_fc(void)
+{
+   iqfc_t* queue = 0;
+
+   // TEST iqfcslot_t: every slot fills whole cache lines
+   TEST(0 == sizeof(iqfcslot_t) % SIZE_CACHELINE);
+   TEST(0 == offsetof(iqfc_t, slot) % SIZE_CACHELINE);
+   PASS();
+
+   // TEST new_iqfc: capacity rounded up to power of two
+   for (uint32_t capacity = 1; capacity <= 1024; capacity = 2*capacity + 1) {
+      for (uint32_t nrthread = 1; nrthread <= 1024; nrthread *= 8) {
+         TEST(0 == new_iqfc(&queue, capacity, nrthread));
+         TEST(0 != queue);
+         TEST(0 == (uintptr_t)queue % SIZE_CACHELINE);
+         TEST(0 == queue->closed);
+         TEST(capacity <= queue->capacity && queue->capacity < 2*capacity);
+         TEST(0 == (queue->capacity & (queue->capacity-1)));
+         TEST(queue->capacity == capacity_iqfc(queue));
+         TEST(nrthread == queue->nrthread);
+         TEST(0 == queue->lock);
+         TEST(queue->msg == (void**)&queue->slot[nrthread]);
+         for (uint32_t i = 0; i < nrthread; ++i) {
+            TEST(0 == queue->slot[i].pending);
          }
-         // == DEBUG: PRINT PROGRESS (change 0 into 1) ==
-         if (0 && 0 == r % 1000) {
-            printf("%d: %d\n", 0, r);
+         for (uint32_t i = 0; i < queue->capacity; ++i) {
+            TEST(0 == queue->msg[i]);
          }
+         TEST(0 == size_iqfc(queue));
+         TEST(0 == delete_iqfc(&queue));
+         TEST(0 == queue);
+         TEST(0 == delete_iqfc(&queue));
+         TEST(0 == queue);
       }
-      close_iqueue1(queue);
-      // stop threads
-      TEST(0 == pthread_join(rthr, 0));
-      signal_iqsignal(&s_threadsignal);
-      TEST(0 == pthread_join(sthr, 0));
-      TEST(0 == delete_iqueue1(&queue));
-      TEST(0 == free_iqsignal(&s_threadsignal));
-      for (int r = 0; r < MAXRANGE; ++r) {
-         TEST(s_flag[0][r] == 1);
+   }
+   PASS();
+
+   // TEST new_iqfc: EINVAL
+   TEST(EINVAL == new_iqfc(&queue, 0, 1));
+   TEST(EINVAL == new_iqfc(&queue, (1u << 30) + 1, 1));
+   TEST(EINVAL == new_iqfc(&queue, 1, 0));
+   TEST(EINVAL == new_iqfc(&queue, 1, 1025));
+   TEST(0 == queue);
+   PASS();
+}
+
+static void test_sendrecv_fc(void)
+{
+   iqfc_t* queue = 0;
+   int     msg[8];
+   void*   rmsg;
+
+   // prepare
+   TEST(0 == new_iqfc(&queue, 8, 3));
+
+   // TEST trysend_iqfc, tryrecv_iqfc: EINVAL
+   TEST(EINVAL == trysend_iqfc(queue, 0, 0));
+   TEST(EINVAL == trysend_iqfc(queue, 3, &msg[0]));
+   TEST(EINVAL == tryrecv_iqfc(queue, 3, &rmsg));
+   TEST(EINVAL == tryrecv_iqfc(queue, (uint32_t)-1, &rmsg));
+   TEST(0 == size_iqfc(queue));
+   PASS();
+
+   // TEST trysend_iqfc, tryrecv_iqfc: FIFO between different thread ids
+   for (int r = 0; r < 10; ++r) {
+      for (int i = 0; i < 8; ++i) {
+         TEST(0 == trysend_iqfc(queue, (uint32_t)i % 3, &msg[i]));
+         TEST((uint32_t)i+1 == size_iqfc(queue));
       }
-      PASS();
+      TEST(EAGAIN == trysend_iqfc(queue, 0, &msg[0]));
+      TEST(EAGAIN == trysend_iqfc(queue, 2, &msg[0]));
+      for (int i = 0; i < 8; ++i) {
+         TEST(0 == tryrecv_iqfc(queue, (uint32_t)(i+r) % 3, &rmsg));
+         TEST(&msg[i] == rmsg);
+      }
+      TEST(EAGAIN == tryrecv_iqfc(queue, 0, &rmsg));
+      TEST(EAGAIN == tryrecv_iqfc(queue, 1, &rmsg));
+      TEST(0 == size_iqfc(queue));
+   }
+   PASS();
+
+   // TEST tryrecv_iqfc: combiner applies published requests of other threads
+   queue->slot[0].msg = &msg[1];
+   queue->slot[0].pending = 1;
+   queue->slot[1].msg = &msg[2];
+   queue->slot[1].pending = 1;
+   TEST(0 == tryrecv_iqfc(queue, 2, &rmsg));
+   TEST(&msg[1] == rmsg);
+   TEST(0 == queue->slot[0].pending);
+   TEST(0 == queue->slot[1].pending);
+   TEST(&msg[2] == queue->slot[1].ret);
+   TEST(0 == queue->lock);
+   TEST(1 == size_iqfc(queue));
+   TEST(0 == tryrecv_iqfc(queue, 0, &rmsg));
+   TEST(&msg[2] == rmsg);
+   PASS();
+
+   // TEST close_iqfc: EPIPE
+   close_iqfc(queue);
+   TEST(0 != queue->closed);
+   TEST(EPIPE == trysend_iqfc(queue, 0, &msg[0]));
+   TEST(EPIPE == tryrecv_iqfc(queue, 1, &rmsg));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqfc(&queue));
+}
+
+#define NRTHREAD_FC 3
+#define NRMSG_FC    20000
+
+static uint8_t s_flagfc[NRTHREAD_FC][NRMSG_FC];
+
+static void* thread_send_fc(void* queue)
+{
+   static uint32_t s_tid;
+   uint32_t tid = fetchadd_atomicu32(&s_tid, 1) % NRTHREAD_FC;
+   for (uintptr_t i = 0; i < NRMSG_FC; ++i) {
+      while (0 != trysend_iqfc(queue, tid, (void*)(1 + tid * NRMSG_FC + i))) sched_yield();
+   }
+   return 0;
+}
+
+static void* thread_recv_fc(void* queue)
+{
+   static uint32_t s_tid;
+   uint32_t tid = NRTHREAD_FC + fetchadd_atomicu32(&s_tid, 1) % NRTHREAD_FC;
+   void* msg;
+   int   err;
+   while (EPIPE != (err = tryrecv_iqfc(queue, tid, &msg))) {
+      if (err) {
+         sched_yield();
+         continue;
+      }
+      uintptr_t value = (uintptr_t)msg - 1;
+      TEST(value < NRTHREAD_FC * NRMSG_FC);
+      __sync_fetch_and_add(&s_flagfc[value / NRMSG_FC][value % NRMSG_FC], 1);
+   }
+   return 0;
+}
+
+static void test_threads_fc(void)
+{
+   iqfc_t*   queue = 0;
+   pthread_t sthr[NRTHREAD_FC];
+   pthread_t rthr[NRTHREAD_FC];
+
+   // prepare
+   memset(s_flagfc, 0, sizeof(s_flagfc));
+   TEST(0 == new_iqfc(&queue, 4, 2*NRTHREAD_FC));
+
+   // TEST trysend_iqfc, tryrecv_iqfc: every message is received exactly once
+   for (int i = 0; i < NRTHREAD_FC; ++i) {
+      TEST(0 == pthread_create(&rthr[i], 0, &thread_recv_fc, queue));
+   }
+   for (int i = 0; i < NRTHREAD_FC; ++i) {
+      TEST(0 == pthread_create(&sthr[i], 0, &thread_send_fc, queue));
+   }
+   for (int i = 0; i < NRTHREAD_FC; ++i) {
+      TEST(0 == pthread_join(sthr[i], 0));
+   }
+   for (int t = 0; t < NRTHREAD_FC; ++t) {
+      for (int i = 0; i < NRMSG_FC; ++i) {
+         while (0 == __sync_fetch_and_add(&s_flagfc[t][i], 0)) sched_yield();
+         TEST(1 == s_flagfc[t][i]);
+      }
+   }
+   close_iqfc(queue);
+   for (int i = 0; i < NRTHREAD_FC; ++i) {
+      TEST(0 == pthread_join(rthr[i], 0));
+   }
+   TEST(0 == size_iqfc(queue));
+   TEST(0 == queue->lock);
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqfc(&queue));
+}
+
+static void test_initfree_line(void)
+{
+   iqline_t* queue = 0;
+
+   // TEST new_iqline: capacity rounded up to power of two and at least one cache line
+   for (uint32_t capacity = 1; capacity <= 1024; capacity = 2*capacity + 1) {
+      TEST(0 == new_iqline(&queue, capacity));
+      TEST(0 != queue);
+      TEST(0 == (uintptr_t)queue % SIZE_CACHELINE);
+      TEST(0 == (uintptr_t)queue->msg % SIZE_CACHELINE);
+      TEST(0 == queue->closed);
+      TEST(capacity <= queue->capacity);
+      TEST(IQLINE_NRSLOT <= queue->capacity);
+      TEST(queue->capacity < 2*capacity || queue->capacity == IQLINE_NRSLOT);
+      TEST(0 == (queue->capacity & (queue->capacity-1)));
+      TEST(queue->capacity == capacity_iqline(queue));
+      TEST(0 == queue->readpos);
+      TEST(0 == queue->writepos);
+      TEST(0 == queue->nextpos);
+      for (uint32_t i = 0; i < queue->capacity; ++i) {
+         TEST(0 == queue->msg[i]);
+      }
+      TEST(0 == size_iqline(queue));
+      TEST(0 == delete_iqline(&queue));
+      TEST(0 == queue);
+      TEST(0 == delete_iqline(&queue));
+      TEST(0 == queue);
+   }
+   PASS();
+
+   // TEST new_iqline: EINVAL
+   TEST(EINVAL == new_iqline(&queue, 0));
+   TEST(EINVAL == new_iqline(&queue, (1u << 30) + 1));
+   TEST(0 == queue);
+   PASS();
+}
+
+static void test_sendrecv_line(void)
+{
+   iqline_t* queue = 0;
+   int       msg[4*IQLINE_NRSLOT];
+   void*     rmsg[4*IQLINE_NRSLOT];
+   size_t    nrrecv;
+
+   // prepare
+   TEST(0 == new_iqline(&queue, 2*IQLINE_NRSLOT));
+
+   // TEST trysend_iqline: EINVAL
+   TEST(EINVAL == trysend_iqline(queue, 0));
+   PASS();
+
+   // TEST trysend_iqline: messages are published line by line
+   for (uint32_t r = 0; r < 10; ++r) {
+      uint32_t start = queue->writepos;
+      for (uint32_t i = 0; i < IQLINE_NRSLOT; ++i) {
+         TEST(0 == size_iqline(queue));
+         TEST(EAGAIN == tryrecv_iqline(queue, &rmsg[0]));
+         TEST(0 == trysend_iqline(queue, &msg[i]));
+         TEST(start+i+1 == queue->nextpos);
+      }
+      TEST(start+IQLINE_NRSLOT == queue->writepos);
+      TEST(IQLINE_NRSLOT == size_iqline(queue));
+      for (uint32_t i = 0; i < IQLINE_NRSLOT; ++i) {
+         TEST(0 == tryrecv_iqline(queue, &rmsg[0]));
+         TEST(&msg[i] == rmsg[0]);
+         TEST(start+i+1 == queue->readpos);
+      }
+      TEST(EAGAIN == tryrecv_iqline(queue, &rmsg[0]));
+   }
+   PASS();
+
+   // TEST flush_iqline: publishes partially filled line
+   TEST(0 == trysend_iqline(queue, &msg[0]));
+   TEST(0 == trysend_iqline(queue, &msg[1]));
+   TEST(EAGAIN == tryrecv_iqline(queue, &rmsg[0]));
+   flush_iqline(queue);
+   TEST(queue->nextpos == queue->writepos);
+   TEST(2 == size_iqline(queue));
+   TEST(0 == tryrecvn_iqline(queue, rmsg, 4*IQLINE_NRSLOT, &nrrecv));
+   TEST(2 == nrrecv);
+   TEST(&msg[0] == rmsg[0]);
+   TEST(&msg[1] == rmsg[1]);
+   TEST(EAGAIN == tryrecvn_iqline(queue, rmsg, 4*IQLINE_NRSLOT, &nrrecv));
+   flush_iqline(queue);
+   TEST(EAGAIN == tryrecv_iqline(queue, &rmsg[0]));
+   PASS();
+
+   // TEST trysend_iqline: full queue publishes all messages (flush on idle)
+   for (uint32_t i = 0; i < 2*IQLINE_NRSLOT; ++i) {
+      TEST(0 == trysend_iqline(queue, &msg[i]));
+   }
+   TEST(queue->nextpos != queue->writepos);
+   TEST(EAGAIN == trysend_iqline(queue, &msg[0]));
+   TEST(queue->nextpos == queue->writepos);
+   TEST(2*IQLINE_NRSLOT == size_iqline(queue));
+   PASS();
+
+   // TEST tryrecvn_iqline: receives at most nrmsg messages in FIFO order with wrap around
+   TEST(0 == tryrecvn_iqline(queue, rmsg, 3, &nrrecv));
+   TEST(3 == nrrecv);
+   for (uint32_t i = 0; i < 3; ++i) {
+      TEST(0 == trysend_iqline(queue, &msg[i]));
+   }
+   flush_iqline(queue);
+   TEST(0 == tryrecvn_iqline(queue, rmsg, 4*IQLINE_NRSLOT, &nrrecv));
+   TEST(2*IQLINE_NRSLOT == nrrecv);
+   for (uint32_t i = 0; i < 2*IQLINE_NRSLOT; ++i) {
+      TEST(&msg[(i+3) % (2*IQLINE_NRSLOT)] == rmsg[i]);
+   }
+   TEST(0 == size_iqline(queue));
+   PASS();
+
+   // TEST close_iqline: EPIPE
+   close_iqline(queue);
+   TEST(0 != queue->closed);
+   TEST(EPIPE == trysend_iqline(queue, &msg[0]));
+   TEST(EPIPE == send_iqline(queue, &msg[0]));
+   TEST(EPIPE == tryrecv_iqline(queue, &rmsg[0]));
+   TEST(EPIPE == recv_iqline(queue, &rmsg[0]));
+   TEST(EPIPE == tryrecvn_iqline(queue, rmsg, 1, &nrrecv));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqline(&queue));
+}
+
+#define NRMSG_LINE 100000
+
+static void* thread_recv_line(void* queue)
+{
+   void* msg;
+   TEST(EPIPE == recv_iqline(queue, &msg));
+   return 0;
+}
+
+static void* thread_send_line(void* queue)
+{
+   for (uintptr_t i = 1; i <= NRMSG_LINE; ++i) {
+      TEST(0 == send_iqline(queue, (void*)i));
+      if (0 == i % 1000) flush_iqline(queue);
+   }
+   flush_iqline(queue);
+   return 0;
+}
+
+static void test_threads_line(void)
+{
+   iqline_t* queue = 0;
+   pthread_t thr;
+   void*     msg;
+
+   // prepare
+   TEST(0 == new_iqline(&queue, 2*IQLINE_NRSLOT));
+
+   // TEST send_iqline, recv_iqline: FIFO order and blocking on full/empty queue
+   TEST(0 == pthread_create(&thr, 0, &thread_send_line, queue));
+   for (uintptr_t i = 1; i <= NRMSG_LINE; ++i) {
+      TEST(0 == recv_iqline(queue, &msg));
+      TEST(i == (uintptr_t)msg);
    }
+   TEST(0 == pthread_join(thr, 0));
+   TEST(0 == size_iqline(queue));
+   TEST(0 == queue->reader.waitcount);
+   TEST(0 == queue->writer.waitcount);
+   PASS();
+
+   // TEST close_iqline: wakes up waiting reader
+   TEST(0 == pthread_create(&thr, 0, &thread_recv_line, queue));
+   while (0 == cmpxchg_atomicsize(&queue->reader.waitcount, 0, 0)) sched_yield();
+   close_iqline(queue);
+   TEST(0 == pthread_join(thr, 0));
+   PASS();
+
+   // unprepare
+   TEST(0 == delete_iqline(&queue));
 }
 
 int main(void)
@@ -1438,6 +5134,7 @@ int main(void)
 
       test_initfree();
       test_query();
+      test_positions();
       test_trysend_single();
       test_send_single();
       test_tryrecv_single();
@@ -1445,12 +5142,101 @@ int main(void)
       test_close();
       test_iqsignal();
       test_multi_sendrecv();
+      test_wakeup();
+      test_recvn();
+      test_timed();
+      test_reset();
+      test_sendn();
+      test_buffer();
+      test_capture();
+      test_registry();
+      test_profile();
 
       // iqueue1_t
 
       test_initfree1();
       test_query1();
       test_single_sendrecv1();
+      test_batch1();
+      test_splice1();
+      test_timed1();
+      test_cancel();
+      test_reset1();
+      test_pool();
+      test_static();
+
+      // iqtriple_t
+
+      test_initfree_triple();
+      test_publishread_triple();
+      test_threads_triple();
+
+      // iqconflate_t
+
+      test_initfree_conflate();
+      test_sendrecv_conflate();
+      test_threads_conflate();
+
+      // iqlossy_t
+
+      test_initfree_lossy();
+      test_sendrecv_lossy();
+      test_threads_lossy();
+
+      // iqueue1h_t
+
+      test_arena();
+      test_initfree1h();
+      test_sendrecv1h();
+      test_threads1h();
+
+      // iqueuec_t
+
+      test_initfreec();
+      test_sendrecvc();
+      test_threadsc();
+
+      // iqmpsc_t
+
+      test_sendrecv_mpsc();
+      test_threads_mpsc();
+
+      // iqturn_t
+
+      test_initfree_turn();
+      test_sendrecv_turn();
+      test_threads_turn();
+      test_close_turn();
+
+      // iqnuma_t
+
+      test_initfree_numa();
+      test_sendrecv_numa();
+      test_threads_numa();
+
+      // iqscq_t
+
+      test_initfree_scq();
+      test_sendrecv_scq();
+      test_threads_scq();
+
+      // iqwf_t
+
+      test_initfree_wf();
+      test_sendrecv_wf();
+      test_threads_wf();
+
+      // iqfc_t
+
+      test_initfree_fc();
+      test_sendrecv_fc();
+      test_threads_fc();
+
+      // iqline_t
+
+      test_initfree_line();
+      test_sendrecv_line();
+      test_threads_line();
 
       TEST(0 == allocated_bytes(&nrofbytes2));
       if (nrofbytes == nrofbytes2) break;